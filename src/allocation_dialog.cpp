@@ -10,7 +10,7 @@ AllocationDialog::AllocationDialog(QWidget *parent)
     : QDialog(parent) {
     methodChoiceLabel = new QLabel("Choose method");
     methodChoiceComboBox = new QComboBox();
-    QStringList methodChoiceItems = QStringList() << "" << LOCATION_ALLOCATION_MEHTOD_NAME << PAGE_RANK_MEHTOD_NAME << K_MEANS_MEHTOD_NAME << RANDOM_METHOD_NAME;
+    QStringList methodChoiceItems = QStringList() << "" << LOCATION_ALLOCATION_MEHTOD_NAME << PAGE_RANK_MEHTOD_NAME << K_MEANS_MEHTOD_NAME << RANDOM_METHOD_NAME << EXACT_MCLP_METHOD_NAME;
     methodChoiceComboBox->addItems(methodChoiceItems);
     // two overloads for QComboBox::currentIndexChanged, need to cast the right method
     // @see https://bugreports.qt.io/browse/QTBUG-30926
@@ -24,7 +24,7 @@ AllocationDialog::AllocationDialog(QWidget *parent)
             showDeadline = false;
             showDel = false;
         }
-        if(method == LOCATION_ALLOCATION_MEHTOD_NAME || method == PAGE_RANK_MEHTOD_NAME) {
+        if(method == LOCATION_ALLOCATION_MEHTOD_NAME || method == PAGE_RANK_MEHTOD_NAME || method == EXACT_MCLP_METHOD_NAME) {
             nbStorageExtension->setVisible(true);
             deadlineExtension->setVisible(true);
             delExtension->setVisible(true);
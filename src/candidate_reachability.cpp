@@ -0,0 +1,83 @@
+#include "candidate_reachability.h"
+
+#include <cmath>
+
+#include "geometries.h"
+#include "geometry_index.h"
+#include "coverage_matrix.h"
+
+CandidateReachability::CandidateReachability(CoverageMatrix* coverageMatrix,
+                                             const QSet<Geometry*>& candidates,
+                                             double distance,
+                                             double travelTime,
+                                             DistanceStat ds,
+                                             TravelTimeStat ts,
+                                             double ttPercentile):
+        _coverageMatrix(coverageMatrix),
+        _candidates(candidates),
+        _distance(distance),
+        _travelTime(travelTime),
+        _ds(ds),
+        _ts(ts),
+        _ttPercentile(ttPercentile) {
+
+    if(_ds != NoneDStat && _distance > 0.0)
+        _index = new GeometryIndex(candidates, _distance, RTreeIndexType);
+}
+
+CandidateReachability::~CandidateReachability() {
+    delete _index;
+}
+
+void CandidateReachability::getGeometriesWithin(QSet<Geometry*>* geomWithin,
+                                                const QSet<Geometry*>& geoms,
+                                                Geometry* geom) {
+    if(_ds == NoneDStat && _ts == NoneTTStat)
+        return;
+
+    for(Geometry* g : getReachable(geom)) {
+        if(geoms.contains(g))
+            geomWithin->insert(g);
+    }
+}
+
+const QVector<Geometry*>& CandidateReachability::getReachable(Geometry* geom) {
+    auto it = _reachable.find(geom);
+    if(it != _reachable.end())
+        return it.value();
+
+    QVector<Geometry*> reachable;
+
+    // candidates whose center is within the distance of the center of geom
+    bool withDistance = _index != nullptr;
+    if(withDistance) {
+        QVector<GeometryIndex::Neighbor> neighbors;
+        QPointF center = geom->getCenter();
+        _index->getGeometriesWithin(center, _distance, &neighbors);
+        for(const GeometryIndex::Neighbor& n : neighbors) {
+            if(n.geom != geom)
+                reachable.append(n.geom);
+        }
+    }
+
+    // candidates with a link reaching geom within the travel time (not already within the distance)
+    if(_ts != NoneTTStat) {
+        int geomId = _coverageMatrix->getId(geom);
+        if(geomId >= 0) {
+            for(int idx = _coverageMatrix->colBegin(geomId); idx < _coverageMatrix->colEnd(geomId); ++idx) {
+                int link = _coverageMatrix->transposedLink(idx);
+                Geometry* g = _coverageMatrix->getGeometry(_coverageMatrix->getRow(link));
+                if(g == geom || !_candidates.contains(g))
+                    continue;
+                if(withDistance && std::islessequal(g->distance(geom), _distance))
+                    continue;
+
+                double tt = _coverageMatrix->getTravelTime(link, _ts, _ttPercentile);
+                if(std::islessequal(tt, _travelTime))
+                    reachable.append(g);
+            }
+        }
+    }
+
+    return _reachable.insert(geom, reachable).value();
+}
@@ -0,0 +1,50 @@
+#ifndef LOCALL_CANDIDATE_REACHABILITY_H
+#define LOCALL_CANDIDATE_REACHABILITY_H
+
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+#include "constants.h"
+
+// forward class declarations
+class Geometry;
+class GeometryIndex;
+class CoverageMatrix;
+
+/* Candidates within a distance and/or a travel time of each candidate, used to remove the
+ * candidates in the vicinity of an allocated facility. The candidates within the distance come
+ * from a spatial index and those within the travel time from the links of the coverage matrix,
+ * so a lookup only goes through the neighbours of the candidate instead of all the candidates.
+ * The list of a candidate is built the first time it is picked, then kept for the run. */
+class CandidateReachability {
+public:
+    CandidateReachability(CoverageMatrix* coverageMatrix,
+                          const QSet<Geometry*>& candidates,
+                          double distance,
+                          double travelTime,
+                          DistanceStat ds,
+                          TravelTimeStat ts,
+                          double ttPercentile = 0.5);
+    ~CandidateReachability();
+
+    /* Adds the geometries from "geoms" (a subset of the candidates) that are within the distance
+     * and/or the travel time of "geom" to "geomWithin", "geom" itself excluded */
+    void getGeometriesWithin(QSet<Geometry*>* geomWithin, const QSet<Geometry*>& geoms, Geometry* geom);
+
+private:
+    CoverageMatrix* _coverageMatrix;
+    GeometryIndex* _index = nullptr;   // index of the candidates (only with a distance)
+    QSet<Geometry*> _candidates;
+    double _distance;
+    double _travelTime;
+    DistanceStat _ds;
+    TravelTimeStat _ts;
+    double _ttPercentile;   // percentile of the travel times (with PctTTStat)
+
+    QHash<Geometry*, QVector<Geometry*>> _reachable;   // <candidate, candidates within reach>
+
+    const QVector<Geometry*>& getReachable(Geometry* geom);
+};
+
+#endif //LOCALL_CANDIDATE_REACHABILITY_H
@@ -1,6 +1,16 @@
 #include "compute_allocation.h"
 
+#include <algorithm>
+#include <QtConcurrent>
+#include <QtMath>
+
 #include "spatial_stats.h"
+#include "coverage_matrix.h"
+#include "candidate_reachability.h"
+#include "mclp_solver.h"
+#include "page_rank.h"
+#include "kmeans.h"
+#include "trace.h"
 
 bool ComputeAllocation::processAllocationMethod(Loader* loader,
                                                 AllocationParams* params,
@@ -23,7 +33,7 @@ bool ComputeAllocation::processAllocationMethod(Loader* loader,
     dStat << "distance" << distance << "allStorageNodes" << computeAllStorageNodes;
 
 
-    if(method == LOCATION_ALLOCATION_MEHTOD_NAME || method == PAGE_RANK_MEHTOD_NAME) {
+    if(method == LOCATION_ALLOCATION_MEHTOD_NAME || method == PAGE_RANK_MEHTOD_NAME || method == EXACT_MCLP_METHOD_NAME) {
         double maxTravelTime, maxDist;
         if(ttStat != NoneTTStat)
             maxTravelTime = travelTime;
@@ -41,15 +51,17 @@ bool ComputeAllocation::processAllocationMethod(Loader* loader,
             /* Location allocation */
             runLocationAllocation(loader, params, allocation);
 
+        } else if(method == EXACT_MCLP_METHOD_NAME) {
+            /* Exact maximal covering location problem */
+            runExactAllocation(loader, params, allocation);
+
         } else if(method == PAGE_RANK_MEHTOD_NAME) {
             /* Page Rank */
-            //            runPageRank(loader, nbFacilities,ttStat,travelTime,dStat,distance,allocation);
-            return false;
+            runPageRank(loader, params, allocation);
         }
     } else if(method == K_MEANS_MEHTOD_NAME) {
         /* k-means */
-        //        runKMeans(loader, nbFacilities,allocation);
-        return false;
+        return runKMeans(loader, params, allocation);
     } else if(method == RANDOM_METHOD_NAME) {
         /* Random */
         runRandomAllocation(loader, nbFacilities, allocation);
@@ -57,61 +69,6 @@ bool ComputeAllocation::processAllocationMethod(Loader* loader,
     return true;
 }
 
-void ComputeAllocation::geomWithin(QSet<Geometry*>* geomWithin,
-                                   const QSet<Geometry*>& geoms,
-                                   Geometry* geom,
-                                   double distance,
-                                   double travelTime,
-                                   DistanceStat ds,
-                                   TravelTimeStat ts) {
-
-    if(ds == NoneDStat && ts == NoneTTStat)
-        return;
-
-//    QRectF cell1(cell.x()*_geometriesize, cell.y()*+_geometriesize, _geometriesize, _geometriesize);
-    foreach(Geometry* g, geoms) {
-        if(g == geom)
-            continue; // skip the ogrGeometry itself
-
-        bool distance_flag = false;
-        bool travelTime_flag = false;
-        double dist;
-        double tt;
-
-        if(ds != NoneDStat && distance > 0.0) {
-            dist = g->distance(geom);
-            if(std::islessequal(dist,distance)) {
-                distance_flag = true;
-            }
-        }
-        if(ts != NoneTTStat || travelTime > 0.0) {
-            GeometryMatrixValue* val;
-            _spatialStats->getValue(&val, g, geom);
-            if(val) {
-                if(ts == AvgTTStat) {
-                    tt = val->travelTimeDist.getAverage();
-                }
-
-                else if(ts == MedTTStat) {
-                    tt = val->travelTimeDist.getMedian();
-                }
-
-                if(std::islessequal(tt,travelTime)) {
-                    travelTime_flag = true;
-                }
-            }
-        }
-
-        if((ds != NoneDStat && distance_flag) || (ts != NoneTTStat && travelTime_flag)) {
-//            qDebug() << "or / add" << geom << g->toString()
-//                     << "distance" << ds << dist << distance
-//                     << "travelTime" << ts << tt << travelTime;
-            geomWithin->insert(g);
-        }
-    }
-}
-
-
 void ComputeAllocation::runLocationAllocation(Loader* loader,
                                               AllocationParams* params,
                                               QHash<Geometry*, Allocation*>* allocation) {
@@ -130,39 +87,36 @@ void ComputeAllocation::runLocationAllocation(Loader* loader,
     double         travelTime      = params->travelTime;
     double         distance        = params->distance;
     QString        allStorageNodes = params->computeAllStorageNodes;
+    int            nbThreads       = params->nbThreads;
 
     bool exportAllocation = !allStorageNodes.isEmpty();
     /* if allStorageNodes is not an empty string, we export the allocation at each iteration of the allocation
      * id X Y rank weight number_deleted number_allocated */
 
-    qDebug() << "runLocationAllocation" << nbFacilities << deadline << ttStat << travelTime << dStat << distance << allStorageNodes << exportAllocation;
+    qDebug() << "runLocationAllocation" << nbFacilities << deadline << ttStat << travelTime << dStat << distance << allStorageNodes << exportAllocation << nbThreads;
 
-    QSet<Geometry*> demandsToCover;
     QSet<Geometry*> allDemands;
     QSet<Geometry*> candidatesToAllocate;
     QSet<Geometry*> allCandidates;
+    getCandidatesAndDemands(&allCandidates, &allDemands);
 
-    QSet<Geometry*> circlesGeometries;
-    QSet<Geometry*> cellsGeometries;
+    candidatesToAllocate = allCandidates;
+    int prevAllocated = 0;
 
-    // get circle ogrGeometry types if there are some
-    QHash<Geometry*, GeometryValue*> geometries;
-    _spatialStats->getGeometries(&geometries);
-    for(auto it = geometries.begin(); it != geometries.end(); ++it) {
-        Geometry* geom = it.key();
-        if(geom->getGeometryType() == CellGeometryType) cellsGeometries.insert(geom);
-        else if(geom->getGeometryType() == CircleGeometryType) circlesGeometries.insert(geom);
-    }
+    // coverage weights of the candidates over the demands to cover, kept up to date
+    // as demands are covered by (or released from) the allocated facilities
+    CoverageMatrix* coverageMatrix = _spatialStats->getCoverageMatrix();
+    CoverageEngine coverageEngine(coverageMatrix, allCandidates, allDemands, deadline);
+    const QSet<Geometry*>& demandsToCover = coverageEngine.getDemandsToCover();
 
-    if(circlesGeometries.size() > 0)
-        allCandidates = circlesGeometries;
-    else
-        allCandidates = cellsGeometries;
-    allDemands = cellsGeometries;
+    // candidates within the distance and/or the travel time of each candidate (to remove them)
+    CandidateReachability reachability(coverageMatrix, allCandidates, distance, travelTime, dStat, ttStat,
+                                       params->ttPercentile);
 
-    candidatesToAllocate = allCandidates;
-    demandsToCover = allDemands;
-    int prevAllocated = 0;
+    // thread pool to score the candidates
+    QThreadPool pool;
+    if(nbThreads > 0)
+        pool.setMaxThreadCount(nbThreads);
 
     // iterate for each storage node to allocate
     for(int i = 0; (!exportAllocation && i < nbFacilities && !demandsToCover.isEmpty()) || (exportAllocation && !demandsToCover.isEmpty()); ++i) {
@@ -171,110 +125,85 @@ void ComputeAllocation::runLocationAllocation(Loader* loader,
 
 //        qDebug() << "allocating demands for storage node" << i;
 
-        QList<Allocation> topCandidates;
+        QList<Geometry*> allocated = allocation->keys(); // previously allocated storage nodes
 
-        // find the candidate that covers the most demands
-        double maxCoverageWeights = 0.0; // to normalize the coverage weights (demand weights)
-        double maxBackendWeights  = 0.0; // to normalize the backend weights
-        double maxIncomingWeights = 0.0; // to normalize the incoming weights (connectivity weight)
-        foreach(Geometry* k, candidatesToAllocate) {
-            double incomingWeight = 0.0;
+        // score the candidates in parallel, in the order of their geometry id
+        QList<Geometry*> candidates = sortById(candidatesToAllocate, coverageMatrix);
+        QVector<CandidateScore> scores = scoreCandidates(&pool, candidates, [&](Geometry* k) {
             GeometryValue* geomVal;
             _spatialStats->getValue(&geomVal, k);
-            incomingWeight = geomVal->avgIncomingScore;
-            if(incomingWeight > maxIncomingWeights)
-                maxIncomingWeights = incomingWeight;
+            double incomingWeight = geomVal->avgIncomingScore;
 
+            // compute the backend weight for the previously allocated storage nodes
             double backendWeight = 0.0;
-            for(Geometry* c : allocation->keys()) {
+            for(Geometry* c : allocated) {
                 backendWeight += computeBackendWeight(c,k);
             }
-            if(backendWeight > maxBackendWeights) {
-                maxBackendWeights = backendWeight;
-            }
-
-            double coverage = 0.0;
-            QHash<Geometry*, double> demandsCovered; // <demand, weight of the demand>
-            for(Geometry* l : demandsToCover) {
-                coverage += computeCoverageWeight(l, k, deadline, &demandsCovered);
-            }
-            if(coverage > maxCoverageWeights) {
-                maxCoverageWeights = coverage;
-            }
-        }
 
-        foreach(Geometry* k, candidatesToAllocate) {
-//            qDebug() << "\tcandidate" << k;
-            double incomingWeight = 0.0;
-            GeometryValue* geomVal;
-            _spatialStats->getValue(&geomVal, k);
-            incomingWeight = geomVal->avgIncomingScore;
+            // Compute the covering score for the candidate
+            double coverage = coverageEngine.getCoverage(k);
 
-            // compute the backend weight for the previously allocated storage nodes
-            double backendWeight = 0.0;
-            int nbBackendLinks = 0;
-            QHash<Geometry*, double> backendCovered;
-            for(Geometry* c : allocation->keys()) {
-                double w = computeBackendWeight(c,k);
-                backendWeight += w;
-                backendCovered.insert(c, w);
-                if(w > 0.0)
-                    nbBackendLinks++;
-//                qDebug() << "\t\t" << "candidate" << k->toString() << backendWeight << w;
-            }
+            return CandidateScore(k, coverage, backendWeight, incomingWeight);
+        });
 
-            // Compute the covering score for the candidate
-            double coverage = 0.0;
-            QHash<Geometry*, double> demandsCovered; // <demand, weight of the demand>
-            for(Geometry* l : demandsToCover) {
-                coverage += computeCoverageWeight(l, k, deadline, &demandsCovered);
-            }
+        // find the candidate that covers the most demands
+        double maxCoverageWeights = 0.0; // to normalize the coverage weights (demand weights)
+        double maxBackendWeights  = 0.0; // to normalize the backend weights
+        double maxIncomingWeights = 0.0; // to normalize the incoming weights (connectivity weight)
+        for(const CandidateScore& s : scores) {
+            if(s.incomingWeight > maxIncomingWeights)
+                maxIncomingWeights = s.incomingWeight;
+            if(s.backendWeight > maxBackendWeights)
+                maxBackendWeights = s.backendWeight;
+            if(s.coverage > maxCoverageWeights)
+                maxCoverageWeights = s.coverage;
+        }
 
+        // get the best candidate (the one with the greater total weight)
+        // -> the scores are ordered by geometry id, so ties go to the lowest id
+        CandidateScore bestScore;
+        double bestWeight = -1.0;
+        double bestBackendWeight = 0.0, bestIncomingWeight = 0.0;
+        for(const CandidateScore& s : scores) {
             // update the candidate list
-            double normalizedBackendWeight  = maxBackendWeights > 0.0  ? backendWeight/maxBackendWeights   : 0.0;
-            double normalizedCoverageWeight = maxCoverageWeights > 0.0 ? coverage/maxCoverageWeights       : 0.0;
-            double normalizedIncomingWeight = maxIncomingWeights > 0.0 ? incomingWeight/maxIncomingWeights : 0.0;
-//            qDebug() << "\tcandidate" << k->toString()
-//                     << "| Backend:"    << normalizedBackendWeight  << backendWeight  << maxBackendWeights
-//                     << "| Coverage:"   << normalizedCoverageWeight << coverage       << maxCoverageWeights
-//                     << "| Incoming"    << normalizedIncomingWeight << incomingWeight << maxIncomingWeights;
-
+            double normalizedBackendWeight  = maxBackendWeights > 0.0  ? s.backendWeight/maxBackendWeights   : 0.0;
+            double normalizedCoverageWeight = maxCoverageWeights > 0.0 ? s.coverage/maxCoverageWeights       : 0.0;
+            double normalizedIncomingWeight = maxIncomingWeights > 0.0 ? s.incomingWeight/maxIncomingWeights : 0.0;
 
             if(normalizedCoverageWeight > 0 && (i==0 || normalizedBackendWeight > 0.0)) {
-                // add the candidate to the top candidates
-                Allocation a(k,normalizedCoverageWeight,normalizedBackendWeight,normalizedIncomingWeight,-1,demandsCovered,backendCovered);
-                topCandidates.append(a);
+                if(normalizedCoverageWeight > bestWeight) {
+                    bestWeight = normalizedCoverageWeight;
+                    bestBackendWeight = normalizedBackendWeight;
+                    bestIncomingWeight = normalizedIncomingWeight;
+                    bestScore = s;
+                }
             }
-//            updateTopCandidates(&topCandidates,k,normalizedCoverageWeight,normalizedBackendWeight,normalizedIncomingWeight,demandsCovered, backendCovered);
         }
 
         Allocation bestCandidate;
         // reduce the set of the population to cover
-        if(!topCandidates.isEmpty()) {
-
-            // get the best candidate (the one with the greater total weight)
-            double bestWeight = -1.0;
-            for(Allocation c : topCandidates) {
-                double w = c.weight; // c.getWeight();
-//                qDebug() << "\t" << QString("(Allocation %1)").arg(QString::number(i)) << "candidate" << w << c.weight<< c.backendWeight << c.incomingWeight << bestWeight;
-                if(w > bestWeight) {
-                    bestWeight = w;
-                    bestCandidate = c;
-                }
+        if(bestScore.geom) {
+            // only build the demands and backends of the candidate that is picked
+            QHash<Geometry*, double> demandsCovered; // <demand, weight of the demand>
+            coverageEngine.getDemandsCovered(&demandsCovered, bestScore.geom);
+            QHash<Geometry*, double> backendCovered;
+            for(Geometry* c : allocated) {
+                backendCovered.insert(c, computeBackendWeight(c,bestScore.geom));
             }
+            bestCandidate = Allocation(bestScore.geom, bestWeight, bestBackendWeight, bestIncomingWeight, -1,
+                                       demandsCovered, backendCovered);
 
             candidatesToAllocate.remove(bestCandidate.geom); // remove the selected cell
-            demandsToCover.remove(bestCandidate.geom); // remove the ogrGeometry from the demands to cover
+            coverageEngine.coverDemands(QSet<Geometry*>() << bestCandidate.geom); // remove the ogrGeometry from the demands to cover
 
             // remove the candidate cells in the vicinity of the selected cell
             QSet<Geometry*> candidatesToRemove;
-            geomWithin(&candidatesToRemove, candidatesToAllocate, bestCandidate.geom,
-                       distance, travelTime, dStat, ttStat);
+            reachability.getGeometriesWithin(&candidatesToRemove, candidatesToAllocate, bestCandidate.geom);
             candidatesToAllocate.subtract(candidatesToRemove);
 
 //            qDebug() << "\tAllocation" << i << bestCandidate.geom->toString() << candidatesToRemove.size() << bestCandidate.backendWeight << bestCandidate.weight;
 
-            demandsToCover.subtract(bestCandidate.demands.keys().toSet());
+            coverageEngine.coverDemands(bestCandidate.demands.keys().toSet());
 
             // add the allocation
             Allocation* alloc = new Allocation(bestCandidate.geom, bestCandidate.weight, bestCandidate.backendWeight, bestCandidate.incomingWeight,
@@ -302,128 +231,95 @@ void ComputeAllocation::runLocationAllocation(Loader* loader,
             double prevWeight = alloc->weight; // previous total weight
             QSet<Geometry*> prevDeletedCandidates = alloc->deletedCandidates;
 
-            // find the top new best candidates that could replace the current allocated candidate
-            QList<Allocation> newTopCandidates;
-
-            // find the candidate that covers the most demands
-            double newMaxCoverageWeights = 0.0; // to normalize the coverage weights (demand weights)
-            double newMaxBackendWeights  = 0.0; // to normalize the backend weights
-            double newMaxIncomingWeights = 0.0; // to normalize the incoming weights
-            for(Geometry* k1 : allCandidates - allocation->keys().toSet()) {
-                GeometryValue* geomVal;
-                _spatialStats->getValue(&geomVal, k);
-                double incomingWeight = geomVal->avgIncomingScore;
-                if(incomingWeight > newMaxIncomingWeights)
-                    newMaxIncomingWeights = incomingWeight;
-
-                double backendWeight = 0.0;
-                for(Geometry* c : allocation->keys()) {
-                    if(c == k) continue;
-                    double w = computeBackendWeight(c,k1);
-                    backendWeight += w;
-                }
-                if(backendWeight > newMaxBackendWeights) {
-                    newMaxBackendWeights = backendWeight;
-                }
-
-                double coverage = 0.0;
-                QHash<Geometry*, double> demandsCovered; // <demand, weight of the demand>
-                for(Geometry* l : demandsToCover + prevDemandsCovered) {
-                    coverage += computeCoverageWeight(l, k1, deadline, &demandsCovered);
-                }
-                if(coverage > newMaxCoverageWeights) {
-                    newMaxCoverageWeights = coverage;
-                }
-            }
-
-            for(Geometry* k1 : allCandidates - allocation->keys().toSet()) {
-                if(k1 == bestCandidate.geom)
-                    continue;
-
+            // score the free sites that could replace the current allocated candidate
+            QSet<Geometry*> freeSites = allCandidates - allocation->keys().toSet();
+            freeSites.remove(bestCandidate.geom);
+            QList<Geometry*> substitutes = sortById(freeSites, coverageMatrix);
+            QList<Geometry*> others = allocation->keys();
+            others.removeOne(k);
+            QVector<CandidateScore> newScores = scoreCandidates(&pool, substitutes, [&](Geometry* k1) {
                 GeometryValue* geomVal;
                 _spatialStats->getValue(&geomVal, k1);
                 double incomingWeight = geomVal->avgIncomingScore;
 
-                QHash<Geometry*, double> demandsCovered; // <demand, weight of the demand>
-                QHash<Geometry*, double> backendCovered; // <facility, weight of the facility>
+                // compute the backend weight for the other allocated storage nodes
                 double backendWeight = 0.0;
-                int nbBackendLinks = 0;
-                // compute the backend weight for the previously allocated storage nodes
-                for(Geometry* c : allocation->keys()) {
-                    if(c == k) continue;
-                    double w = computeBackendWeight(c,k1);
-                    backendWeight += w;
-                    backendCovered.insert(c,w);
-                    if(w > 0.0)
-                        nbBackendLinks++;
+                for(Geometry* c : others) {
+                    backendWeight += computeBackendWeight(c,k1);
                 }
 
-                double coverage = 0.0;
                 // all demands to cover + those covered by the current candidate
-                for(Geometry* l : demandsToCover + prevDemandsCovered) {
-                    coverage += computeCoverageWeight(l, k1, deadline, &demandsCovered);
-                }
+                double coverage = coverageEngine.getCoverage(k1, prevDemandsCovered);
 
-                // update the candidate list
-                double newNormalizedBackendWeight  = newMaxBackendWeights > 0.0  ? backendWeight/newMaxBackendWeights   : 0.0;
-                double newNormalizedCoverageWeight = newMaxCoverageWeights > 0.0 ? coverage/newMaxCoverageWeights       : 0.0;
-                double newNormalizedIncomingWeight = newMaxIncomingWeights > 0.0 ? incomingWeight/newMaxIncomingWeights : 0.0;
+                return CandidateScore(k1, coverage, backendWeight, incomingWeight);
+            });
 
-//                qDebug() << "\t\tcandidate" << k->toString()
-//                << "| Backend:"    << newNormalizedBackendWeight  << backendWeight  << newMaxBackendWeights
-//                << "| Coverage:"   << newNormalizedCoverageWeight << coverage       << newMaxCoverageWeights
-//                << "| Incoming"    << newNormalizedIncomingWeight << incomingWeight << newMaxIncomingWeights;
-
-                if(newNormalizedCoverageWeight > 0 && newNormalizedBackendWeight > 0.0) {
-                    // add the candidate to the top candidates
-                    Allocation a(k1,newNormalizedCoverageWeight,newNormalizedBackendWeight,newNormalizedIncomingWeight,-1,demandsCovered,backendCovered);
-                    newTopCandidates.append(a);
-                }
-
-//                updateTopCandidates(&newTopCandidates,k1,
-//                                    newNormalizedCoverageWeight,
-//                                    newNormalizedBackendWeight,
-//                                    normalizedIncomingWeight,
-//                                    demandsCovered, backendCovered);
+            // find the candidate that covers the most demands
+            double newMaxCoverageWeights = 0.0; // to normalize the coverage weights (demand weights)
+            double newMaxBackendWeights  = 0.0; // to normalize the backend weights
+            double newMaxIncomingWeights = 0.0; // to normalize the incoming weights
+            GeometryValue* allocVal;
+            _spatialStats->getValue(&allocVal, k);
+            for(const CandidateScore& s : newScores) {
+                if(allocVal->avgIncomingScore > newMaxIncomingWeights)
+                    newMaxIncomingWeights = allocVal->avgIncomingScore;
+                if(s.backendWeight > newMaxBackendWeights)
+                    newMaxBackendWeights = s.backendWeight;
+                if(s.coverage > newMaxCoverageWeights)
+                    newMaxCoverageWeights = s.coverage;
             }
 
             // get the best candidate
-            Allocation newBestCandidate;
+            CandidateScore newBestScore;
             double newBestWeight = 0.0;
-            for(Allocation c : newTopCandidates) {
-                double w = c.weight; //c.getWeight();
-                if(w > newBestWeight) {
-                    newBestWeight = w;
-                    newBestCandidate = c;
+            double newBestBackendWeight = 0.0, newBestIncomingWeight = 0.0;
+            for(const CandidateScore& s : newScores) {
+                double newNormalizedBackendWeight  = newMaxBackendWeights > 0.0  ? s.backendWeight/newMaxBackendWeights   : 0.0;
+                double newNormalizedCoverageWeight = newMaxCoverageWeights > 0.0 ? s.coverage/newMaxCoverageWeights       : 0.0;
+                double newNormalizedIncomingWeight = newMaxIncomingWeights > 0.0 ? s.incomingWeight/newMaxIncomingWeights : 0.0;
+
+                if(newNormalizedCoverageWeight > 0 && newNormalizedBackendWeight > 0.0) {
+                    if(newNormalizedCoverageWeight > newBestWeight) {
+                        newBestWeight = newNormalizedCoverageWeight;
+                        newBestBackendWeight = newNormalizedBackendWeight;
+                        newBestIncomingWeight = newNormalizedIncomingWeight;
+                        newBestScore = s;
+                    }
                 }
             }
 
             if(prevWeight < newBestWeight) {
                 // change the candidate's current allocation
-//                qDebug() << "changed candidate / old" << prevWeight << "new" << newBestCandidate.weight;
+//                qDebug() << "changed candidate / old" << prevWeight << "new" << newBestWeight;
+
+                QHash<Geometry*, double> demandsCovered; // <demand, weight of the demand>
+                coverageEngine.getDemandsCovered(&demandsCovered, newBestScore.geom, prevDemandsCovered);
+                QHash<Geometry*, double> backendCovered; // <facility, weight of the facility>
+                for(Geometry* c : others) {
+                    backendCovered.insert(c, computeBackendWeight(c,newBestScore.geom));
+                }
 
                 // delete the current allocation
                 allocation->remove(k);
 
-//                qDebug() << "delete " << k->toString() << newBestCandidate.geom->toString() << prevWeight << newBestCandidate.weight;
+//                qDebug() << "delete " << k->toString() << newBestScore.geom->toString() << prevWeight << newBestWeight;
                 QSet<Geometry*> candidatesToRemove;
-                geomWithin(&candidatesToRemove,
-                           candidatesToAllocate + prevDeletedCandidates,
-                           newBestCandidate.geom,
-                           distance, travelTime, dStat, ttStat);
+                reachability.getGeometriesWithin(&candidatesToRemove,
+                                                 candidatesToAllocate + prevDeletedCandidates,
+                                                 newBestScore.geom);
 
-                Allocation* a = new Allocation(newBestCandidate.geom, newBestCandidate.weight, newBestCandidate.backendWeight, newBestCandidate.incomingWeight,
-                                               -1, newBestCandidate.demands, newBestCandidate.backends, candidatesToRemove);
-                allocation->insert(newBestCandidate.geom, a);
+                Allocation* a = new Allocation(newBestScore.geom, newBestWeight, newBestBackendWeight, newBestIncomingWeight,
+                                               -1, demandsCovered, backendCovered, candidatesToRemove);
+                allocation->insert(newBestScore.geom, a);
 
                 // update the candidates and the demands that are deleted and allocated
                 candidatesToAllocate.subtract(candidatesToRemove);
                 candidatesToAllocate.unite(prevDeletedCandidates);
-                candidatesToAllocate.remove(newBestCandidate.geom);
+                candidatesToAllocate.remove(newBestScore.geom);
                 candidatesToAllocate.insert(k);
 
-                demandsToCover.unite(prevDemandsCovered);
-                demandsToCover.subtract(newBestCandidate.demands.keys().toSet());
+                coverageEngine.releaseDemands(prevDemandsCovered);
+                coverageEngine.coverDemands(demandsCovered.keys().toSet());
 
                 // TODO Change the new candidate's rank
             }
@@ -466,43 +362,348 @@ void ComputeAllocation::runLocationAllocation(Loader* loader,
     loader->loadProgressChanged(1.0, "Done");
 }
 
-double ComputeAllocation::computeBackendWeight(Geometry* c, Geometry* k) {
+void ComputeAllocation::runExactAllocation(Loader* loader,
+                                           AllocationParams* params,
+                                           QHash<Geometry*, Allocation*>* allocation) {
 
-    GeometryMatrixValue* val;
-    _spatialStats->getValue(&val,k,c);
-    double weight = 0.0;
-    if(val) {
-        double visitCount = val->visits.size();
-        if(visitCount > 1) {
-            weight += val->avgScore;
+    loader->loadProgressChanged((qreal) 0.0, "Initialization");
+
+    int    nbFacilities = params->nbFacilities;
+    double timeBudget   = params->timeBudget;
+
+    qDebug() << "runExactAllocation" << nbFacilities << params->deadline << params->ttStat << params->travelTime
+             << params->dStat << params->distance << timeBudget;
+
+    QSet<Geometry*> allCandidates;
+    QSet<Geometry*> allDemands;
+    getCandidatesAndDemands(&allCandidates, &allDemands);
+
+    // same coverage as the location allocation: the demands within the deadline of each candidate
+    CoverageMatrix* coverageMatrix = _spatialStats->getCoverageMatrix();
+    CoverageEngine coverageEngine(coverageMatrix, allCandidates, allDemands, params->deadline);
+
+    // candidates in the order of their geometry id, the demands in the order they are reached
+    QList<Geometry*> candidates = sortById(allCandidates, coverageMatrix);
+    QHash<int, int> demandIds; // <coverage matrix id, demand id>
+    QVector<Geometry*> demands;
+    QVector<int> offsets, candidateDemands;
+    QVector<double> weights;
+    offsets.append(0);
+    for(Geometry* k : candidates) {
+        int kId = coverageMatrix->getId(k);
+        if(kId >= 0) {
+            for(int idx = coverageEngine.candidateBegin(kId); idx < coverageEngine.candidateEnd(kId); ++idx) {
+                int lId = coverageEngine.getCandidateDemand(idx);
+                if(!demandIds.contains(lId)) {
+                    demandIds.insert(lId, demands.size());
+                    demands.append(coverageMatrix->getGeometry(lId));
+                }
+                candidateDemands.append(demandIds.value(lId));
+                weights.append(coverageEngine.getCandidateWeight(idx));
+            }
+        }
+        offsets.append(candidateDemands.size());
+    }
+    MCLPSolver solver(demands.size(), offsets, candidateDemands, weights);
+
+    // the candidates within the distance and/or the travel time of each other are not allocated together
+    loader->loadProgressChanged((qreal) 0.1, "Candidates within reach");
+    CandidateReachability reachability(coverageMatrix, allCandidates, params->distance, params->travelTime,
+                                       params->dStat, params->ttStat, params->ttPercentile);
+    QHash<Geometry*, int> candidateIds;
+    for(int i = 0; i < candidates.size(); ++i) {
+        candidateIds.insert(candidates.at(i), i);
+    }
+    QVector<QSet<Geometry*>> candidatesWithin(candidates.size());
+    for(int i = 0; i < candidates.size(); ++i) {
+        reachability.getGeometriesWithin(&candidatesWithin[i], allCandidates, candidates.at(i));
+        for(Geometry* c : candidatesWithin.at(i)) {
+            solver.addConflict(i, candidateIds.value(c));
         }
     }
 
-    _spatialStats->getValue(&val,c,k);
-    if(val) {
-        double visitCount = val->visits.size();
-        if(visitCount > 1) {
-            weight += val->avgScore;
+    loader->loadProgressChanged((qreal) 0.2, "Branch-and-bound");
+    bool optimal = solver.solve(nbFacilities, timeBudget);
+    params->objective     = solver.getObjective();
+    params->upperBound    = solver.getUpperBound();
+    params->optimalityGap = solver.getGap();
+
+    qDebug() << "exact allocation" << (optimal ? "optimal" : "time budget reached") << "objective" << solver.getObjective()
+             << "upper bound" << solver.getUpperBound() << "gap" << solver.getGap() << "nodes" << solver.getNbNodes();
+
+    // each demand is assigned to the allocated candidate with the largest weight (ties to the lowest id)
+    QVector<int> solution = solver.getSolution();
+    std::sort(solution.begin(), solution.end());
+    QVector<double> bestWeights(demands.size(), 0.0);
+    QVector<int> assigned(demands.size(), -1);
+    for(int k : solution) {
+        for(int idx = offsets.at(k); idx < offsets.at(k+1); ++idx) {
+            int l = candidateDemands.at(idx);
+            if(weights.at(idx) > bestWeights.at(l)) {
+                bestWeights[l] = weights.at(idx);
+                assigned[l] = k;
+            }
+        }
+    }
+    QHash<int, QHash<Geometry*, double>> demandsCovered; // <candidate id, <demand, weight of the demand>>
+    QHash<int, double> coverage;
+    for(int l = 0; l < demands.size(); ++l) {
+        if(assigned.at(l) >= 0) {
+            demandsCovered[assigned.at(l)].insert(demands.at(l), bestWeights.at(l));
+            coverage[assigned.at(l)] += bestWeights.at(l);
         }
     }
 
-    return weight;
+    // the facilities are ranked by decreasing covered weight
+    std::stable_sort(solution.begin(), solution.end(), [&coverage](int a, int b) {
+        return coverage.value(a) > coverage.value(b);
+    });
+    for(int i = 0; i < solution.size(); ++i) {
+        int k = solution.at(i);
+        Geometry* geom = candidates.at(k);
+        Allocation* alloc = new Allocation(geom, coverage.value(k), 0.0, 0.0, i, demandsCovered.value(k),
+                                           QHash<Geometry*, double>(), candidatesWithin.at(k));
+        allocation->insert(geom, alloc);
+    }
+
+    loader->loadProgressChanged(1.0, "Done");
 }
 
-double ComputeAllocation::computeCoverageWeight(Geometry* l, Geometry* k, double deadline, QHash<Geometry*, double>* demandsCovered) {
-    double weight = 0.0;
-    GeometryMatrixValue* val;
-    _spatialStats->getValue(&val,l,k);
-    if(val) {
-        double medTravelTime = val->travelTimeDist.getMedian();
-        if(medTravelTime <= deadline) {
-            double visitCount = val->visits.size();
-            if(visitCount > 1) {
-                double score = val->avgScore;
-                weight += score; // weight of the demand
-                demandsCovered->insert(l, score);
+void ComputeAllocation::runPageRank(Loader* loader,
+                                    AllocationParams* params,
+                                    QHash<Geometry*, Allocation*>* allocation,
+                                    double alpha, int maxIterations, double tolerance) {
+
+    loader->loadProgressChanged((qreal) 0.0, "Initialization");
+
+    int nbFacilities = params->nbFacilities;
+    int nbThreads    = params->nbThreads;
+
+    qDebug() << "runPageRank" << nbFacilities << params->ttStat << params->travelTime << params->dStat
+             << params->distance << nbThreads;
+
+    QSet<Geometry*> allCandidates;
+    QSet<Geometry*> allDemands;
+    getCandidatesAndDemands(&allCandidates, &allDemands);
+
+    // transition graph between the candidates, built once (the allocated and the removed
+    // candidates are masked)
+    CoverageMatrix* coverageMatrix = _spatialStats->getCoverageMatrix();
+    QList<Geometry*> candidates = sortById(allCandidates, coverageMatrix);
+    QHash<Geometry*, int> candidateIds;
+    for(int i = 0; i < candidates.size(); ++i) {
+        candidateIds.insert(candidates.at(i), i);
+    }
+    QThreadPool pool;
+    if(nbThreads > 0)
+        pool.setMaxThreadCount(nbThreads);
+    PageRank pageRank(coverageMatrix, candidates, &pool);
+
+    // candidates within the distance and/or the travel time of each candidate (to remove them)
+    CandidateReachability reachability(coverageMatrix, allCandidates, params->distance, params->travelTime,
+                                       params->dStat, params->ttStat, params->ttPercentile);
+
+    QSet<Geometry*> candidatesToAllocate = allCandidates;
+    QVector<double> ranks; // warm start from the ranks of the previous iteration
+    for(int i = 0; i < nbFacilities && !candidatesToAllocate.isEmpty(); ++i) {
+        loader->loadProgressChanged((qreal) i / (qreal) nbFacilities, "Allocate for facility " + QString::number(i));
+
+        // run pagerank with the current set of candidates (the last iterate is used if it does not
+        // converge, as usual for the power iteration)
+        double residual;
+        if(!pageRank.compute(&ranks, alpha, maxIterations, tolerance, &residual)) {
+            qDebug() << "PageRank did not converge in" << maxIterations << "iterations, residual" << residual;
+        }
+
+        // select the candidate with the highest rank (ties go to the lowest id)
+        int best = -1;
+        for(int k = 0; k < candidates.size(); ++k) {
+            if(!pageRank.isRemoved(k) && (best < 0 || ranks.at(k) > ranks.at(best)))
+                best = k;
+        }
+        Geometry* geom = candidates.at(best);
+        candidatesToAllocate.remove(geom);
+        pageRank.removeNode(best);
+
+        // remove the candidates in the vicinity of the selected candidate
+        QSet<Geometry*> candidatesToRemove;
+        reachability.getGeometriesWithin(&candidatesToRemove, candidatesToAllocate, geom);
+        candidatesToAllocate.subtract(candidatesToRemove);
+        for(Geometry* c : candidatesToRemove) {
+            pageRank.removeNode(candidateIds.value(c));
+        }
+
+        Allocation* alloc = new Allocation(geom, ranks.at(best), 0.0, 0.0, i, QHash<Geometry*, double>(),
+                                           QHash<Geometry*, double>(), candidatesToRemove);
+        allocation->insert(geom, alloc);
+    }
+
+    loader->loadProgressChanged(1.0, "Done");
+}
+
+bool ComputeAllocation::runKMeans(Loader* loader,
+                                  AllocationParams* params,
+                                  QHash<Geometry*, Allocation*>* allocation) {
+
+    loader->loadProgressChanged((qreal) 0.0, "Initialization");
+
+    int nbFacilities = params->nbFacilities;
+    int nbThreads    = params->nbThreads;
+
+    // projected positions of the trace within the time window of the spatial stats
+    Trace* trace = _spatialStats->getTrace();
+    if(!trace)
+        return false;
+    long long start = _spatialStats->getStartTime(), end = _spatialStats->getEndTime();
+    TraceStore* store = trace->getTraceStore();
+    QVector<double> xs, ys;
+    xs.reserve(store->getNbPositions());
+    ys.reserve(store->getNbPositions());
+    for(int id = 0; id < store->getNbNodes(); ++id) {
+        const NodeColumns& positions = store->getNode(id);
+        int first = (start == -1) ? 0 : positions.lowerBound(start);
+        int last = (end == -1) ? positions.size() : positions.upperBound(end);
+        for(int j = first; j < last; ++j) {
+            xs.append(positions.xs.at(j));
+            ys.append(positions.ys.at(j));
+        }
+    }
+
+    qDebug() << "runKMeans" << nbFacilities << nbThreads << xs.size() << "points";
+
+    loader->loadProgressChanged((qreal) 0.2, "Mini-batch k-means");
+    QThreadPool pool;
+    if(nbThreads > 0)
+        pool.setMaxThreadCount(nbThreads);
+    KMeans kmeans(xs, ys, &pool);
+    if(!kmeans.compute(nbFacilities))
+        return false;
+
+    qDebug() << "k-means" << kmeans.getNbCentroids() << "centroids after" << kmeans.getNbIterations()
+             << "iterations, inertia" << kmeans.getInertia();
+
+    // each centroid is allocated to the closest candidate (by their center) that is not allocated yet,
+    // from the largest cluster (the equidistant candidates go to the lowest id)
+    loader->loadProgressChanged((qreal) 0.9, "Closest candidates");
+    QSet<Geometry*> allCandidates;
+    QSet<Geometry*> allDemands;
+    getCandidatesAndDemands(&allCandidates, &allDemands);
+    CoverageMatrix* coverageMatrix = _spatialStats->getCoverageMatrix();
+    QList<Geometry*> candidates = sortById(allCandidates, coverageMatrix);
+    if(candidates.isEmpty())
+        return false;
+    GeometryIndex candidateIndex(candidates, _spatialStats->getCellSize(), RTreeIndexType);
+
+    QVector<int> centroids(kmeans.getNbCentroids());
+    for(int c = 0; c < centroids.size(); ++c) {
+        centroids[c] = c;
+    }
+    std::stable_sort(centroids.begin(), centroids.end(), [&kmeans](int a, int b) {
+        return kmeans.getSize(a) > kmeans.getSize(b);
+    });
+    QVector<GeometryIndex::Neighbor> neighbors;
+    for(int c : centroids) {
+        if(allocation->size() == candidates.size()) {
+            qWarning() << "runKMeans" << centroids.size() << "clusters for" << candidates.size() << "candidates,"
+                       << centroids.size() - allocation->size() << "clusters not allocated";
+            break;
+        }
+
+        // at most allocation->size() candidates are closer than the closest one not allocated
+        QPointF centroid(kmeans.getCentroidX(c), kmeans.getCentroidY(c));
+        candidateIndex.getNearestGeometries(centroid, allocation->size() + 1, &neighbors);
+        Geometry* closest = nullptr;
+        double minDist = 0.0;
+        for(const GeometryIndex::Neighbor& n : neighbors) {
+            if(!allocation->contains(n.geom)) {
+                closest = n.geom;
+                minDist = n.distance;
+                break;
             }
         }
+        candidateIndex.getGeometriesWithin(centroid, minDist, &neighbors);
+        for(const GeometryIndex::Neighbor& n : neighbors) {
+            if(n.distance == minDist && !allocation->contains(n.geom)
+               && coverageMatrix->getId(n.geom) < coverageMatrix->getId(closest))
+                closest = n.geom;
+        }
+
+        int rank = allocation->size();
+        allocation->insert(closest, new Allocation(closest, kmeans.getSize(c), 0.0, 0.0, rank));
+    }
+
+    loader->loadProgressChanged(1.0, "Done");
+
+    return true;
+}
+
+void ComputeAllocation::getCandidatesAndDemands(QSet<Geometry*>* candidates, QSet<Geometry*>* demands) {
+    QSet<Geometry*> circlesGeometries;
+    QSet<Geometry*> cellsGeometries;
+
+    // get circle ogrGeometry types if there are some
+    QHash<Geometry*, GeometryValue*> geometries;
+    _spatialStats->getGeometries(&geometries);
+    for(auto it = geometries.begin(); it != geometries.end(); ++it) {
+        Geometry* geom = it.key();
+        if(geom->getGeometryType() == CellGeometryType) cellsGeometries.insert(geom);
+        else if(geom->getGeometryType() == CircleGeometryType) circlesGeometries.insert(geom);
+    }
+
+    if(circlesGeometries.size() > 0)
+        *candidates = circlesGeometries;
+    else
+        *candidates = cellsGeometries;
+    *demands = cellsGeometries;
+}
+
+QList<Geometry*> ComputeAllocation::sortById(const QSet<Geometry*>& geoms, CoverageMatrix* coverageMatrix) {
+    QList<Geometry*> sorted = geoms.toList();
+    std::sort(sorted.begin(), sorted.end(), [coverageMatrix](Geometry* a, Geometry* b) {
+        return coverageMatrix->getId(a) < coverageMatrix->getId(b);
+    });
+    return sorted;
+}
+
+QVector<CandidateScore> ComputeAllocation::scoreCandidates(QThreadPool* pool,
+                                                           const QList<Geometry*>& candidates,
+                                                           std::function<CandidateScore(Geometry*)> score) {
+    QVector<CandidateScore> scores(candidates.size());
+    CandidateScore* data = scores.data(); // each task writes its own range of the scores
+
+    // split the candidates in contiguous chunks (a few per thread to balance the load)
+    int nbChunks = qMax(1, qMin(candidates.size(), 4 * pool->maxThreadCount()));
+    int chunkSize = qCeil((double) candidates.size() / nbChunks);
+    QList<QFuture<void>> futures;
+    for(int begin = 0; begin < candidates.size(); begin += chunkSize) {
+        int end = qMin(begin + chunkSize, candidates.size());
+        futures.append(QtConcurrent::run(pool, [&candidates, &score, data, begin, end]() {
+            for(int i = begin; i < end; ++i) {
+                data[i] = score(candidates.at(i));
+            }
+        }));
+    }
+    for(QFuture<void>& future : futures) {
+        future.waitForFinished();
+    }
+
+    return scores;
+}
+
+double ComputeAllocation::computeBackendWeight(Geometry* c, Geometry* k) {
+    CoverageMatrix* coverageMatrix = _spatialStats->getCoverageMatrix();
+    int cId = coverageMatrix->getId(c);
+    int kId = coverageMatrix->getId(k);
+
+    double weight = 0.0;
+    int link = coverageMatrix->find(kId, cId);
+    if(link >= 0 && coverageMatrix->getVisitCount(link) > 1) {
+        weight += coverageMatrix->getAvgScore(link);
+    }
+
+    link = coverageMatrix->find(cId, kId);
+    if(link >= 0 && coverageMatrix->getVisitCount(link) > 1) {
+        weight += coverageMatrix->getAvgScore(link);
     }
 
     return weight;
@@ -577,119 +778,6 @@ bool ComputeAllocation::runRandomAllocation(Loader* loader, int nbFacilities, QH
 }
 
 
-/*
- * PageRank function
- */
-/*
-bool ComputeAllocation::pageRank(QHash<QPoint, double> &x, QSet<QPoint> cells, double alpha, int maxIterations, double tolerance)
-{
-    int N = cells.size();
-    QHash<QPoint, double> xlast, danglingWeights, p;
-    for(auto n : cells) {
-        double v = 1.0/N;
-        x.insert(n, v);
-        danglingWeights.insert(n, v);
-        p.insert(n, v);
-    }
-
-    QSet<QPoint> danglingNodes = QSet<QPoint>(cells);
-    for(auto it = _geometryMatrix.begin(); it != _geometryMatrix.end(); ++it) {
-        // remove the nodes that have out-edges
-        if(it.value()->size() > 0)
-            danglingNodes.remove(it.key());
-    }
-
-    for(int i = 0; i < maxIterations; ++i) {
-        xlast = x;
-        xlast.detach(); // deep copy
-
-        for(auto it = x.begin(); it != x.end(); ++it) {
-            x[it.key()] = 0.0;
-        }
-
-        double dangleSum = 0.0;
-        for(QPoint node : danglingNodes) {
-            dangleSum += xlast[node];
-        }
-        dangleSum *= alpha;
-
-        for(auto it = x.begin(); it != x.end(); ++it) {
-            QPoint n = it.key(); // node
-            if(!_geometryMatrix.contains(n)) continue;
-            auto neighbors = _geometryMatrix.value(n);
-            double nbNeighbors = (double) neighbors->size(); // number of outbound links of n
-            for(auto jt = neighbors->begin(); jt != neighbors->end(); ++jt) {
-                QPoint nbr = jt.key(); // neighbor
-                auto val = jt.value(); // value for edge n -> nbr
-                double weight = val->medScore;
-//                double median = val->interVisitDurationDist.getMedian();
-//                double weight = median > 0 ? ((double) val->visits.size()) / median : ((double) val->visits.size());
-                double edgeWeight = nbNeighbors > 0 ? weight / nbNeighbors : 0.0;
-//                double before = x[nbr];
-                x[nbr] += alpha * xlast[n] * edgeWeight;
-//                qDebug() << "\t\t edge" << n << "->" << nbr << "/" << edgeWeight << xlast[n] << before << x[nbr] << nbNeighbors;
-            }
-            x[n] += dangleSum * danglingWeights[n] + (1.0 - alpha) * p[n];
-//            qDebug() << "\t node" << n << "/" << x[n] << dangleSum << danglingWeights[n] << p[n];
-        }
-
-        double err = 0.0;
-        for(auto n : x.keys()) {
-            err += qAbs(x[n] - xlast[n]);
-        }
-        qDebug() << "iteration" << (i+1) << x.size() << err;
-        if(err < N*tolerance)
-            return true;
-    }
-
-    // did not converge
-    return false;
-}
-
-
-void ComputeAllocation::runPageRank(int nbFacilities, double deadline, double delFactor, TravelTimeStat ttStat, double travelTime, DistanceStat dStat, double distance, QHash<QPoint, Allocation*>& allocation) {
-    // initialize the candidates
-    QSet<QPoint> candidatesToAllocate(_geometries.keys().toSet());
-
-    for(int i = 0; i < nbFacilities; ++i) {
-        // run pagerank with the current set of candidate cells
-        QHash<QPoint, double> x; // result array
-        bool pageRankRet = pageRank(x, candidatesToAllocate);
-
-        if(!pageRankRet) {
-            qDebug() << "PageRank did not converge";
-            break;
-        }
-
-        // Select the cell with the highest page rank
-        // sort the "x" QHash by value
-        QList<double> vals = x.values();
-        QList<QPoint> sortedCells; //to fill with the cells
-        qSort(vals);
-        for(double val : vals) {
-            QList<QPoint> keys = x.keys(val);
-            for(QPoint cell : keys) {
-                sortedCells.append(cell);
-            }
-        }
-        QPoint cell = sortedCells.last(); // cell with highest score
-        candidatesToAllocate.remove(cell); // remove the cell from the set of cells to allocate
-
-        // remove cells around the selected cell
-        QSet<QPoint> cellsToDelete;
-        geomWithin(cellsToDelete,candidatesToAllocate,cell,maxDist,maxTravelTime,op,ts);
-        candidatesToAllocate.subtract(cellsToDelete); // remove the cells in the vicinity of the selected cell
-
-        qDebug() << "\tcell" << cell << cellsToDelete.size() << "score" << x[cell];
-
-        // add the cell to the allocated cells
-        QHash<QPoint, double> demandsAllocated;
-        Allocation* alloc = new Allocation(cell, x[cell], demandsAllocated, cellsToDelete, _geometriesize);
-        allocation.insert(cell, alloc);
-    }
-}
-*/
-
 /*
  * Compute the PageRank allocation
  */
@@ -1,7 +1,11 @@
 #ifndef COMPUTEALLOCATION_H
 #define COMPUTEALLOCATION_H
 
+#include <functional>
+#include <QThreadPool>
+
 #include "utils.h"
+#include "coverage_engine.h"
 
 // forward declarations
 class SpatialStats;
@@ -11,9 +15,11 @@ class Loader;
 // structure for the allocation parameters
 struct AllocationParams {
     AllocationParams(long long deadline, int nbFacilities, double delFactor, TravelTimeStat ttStat,
-                     DistanceStat dStat, double travelTime, double distance, const QString& method):
+                     DistanceStat dStat, double travelTime, double distance, const QString& method, int nbThreads = -1,
+                     double ttPercentile = 0.5):
             deadline(deadline), nbFacilities(nbFacilities), delFactor(delFactor), ttStat(ttStat),
-            dStat(dStat), travelTime(travelTime), distance(distance), method(method) { }
+            dStat(dStat), travelTime(travelTime), distance(distance), method(method), nbThreads(nbThreads),
+            ttPercentile(ttPercentile) { }
     AllocationParams() { }
 
     long long      deadline;
@@ -25,6 +31,25 @@ struct AllocationParams {
     double         distance;
     QString        method;
     QString        computeAllStorageNodes;
+    int            nbThreads = -1; // threads to score the candidates (-1 for the ideal thread count)
+    double         ttPercentile = 0.5; // percentile of the travel times (with PctTTStat)
+    double         timeBudget = DEFAULT_MCLP_TIME_BUDGET; // time budget (s) of the exact MCLP solver
+
+    // results of the exact MCLP solver
+    double         objective = 0.0;      // demand weight covered by the allocation
+    double         upperBound = 0.0;     // bound on the demand weight covered by an optimal allocation
+    double         optimalityGap = -1.0; // (upperBound - objective) / upperBound, 0 if the allocation is optimal
+};
+
+// structure for the (raw) scores of a candidate during an allocation step
+struct CandidateScore {
+    CandidateScore(Geometry* geom = nullptr, double coverage = 0.0, double backendWeight = 0.0, double incomingWeight = 0.0):
+            geom(geom), coverage(coverage), backendWeight(backendWeight), incomingWeight(incomingWeight) { }
+
+    Geometry* geom;
+    double    coverage;
+    double    backendWeight;
+    double    incomingWeight;
 };
 
 class ComputeAllocation {
@@ -32,26 +57,36 @@ public:
     ComputeAllocation(SpatialStats* spatialStats):
             _spatialStats(spatialStats) { }
 
+    SpatialStats* getSpatialStats() { return _spatialStats; }
+
     bool processAllocationMethod(Loader* loader, AllocationParams* params, QHash<Geometry*, Allocation *>* allocation);
     void runLocationAllocation(Loader* loader, AllocationParams* params, QHash<Geometry*, Allocation*>* allocation);
     bool runRandomAllocation(Loader* loader, int nbFacilities, QHash<Geometry*, Allocation *>* allocation);
-//    void runPageRank(Loader* loader, int nbFacility, TravelTimeStat ttStat, double travelTime, DistanceStat dStat, double distance, QHash<Geometry*, Allocation*>& allocation);
-//    void runKMeans(Loader* loader, int nbFacilities, QHash<Geometry*, Allocation*>& allocation);
+    /* Optimal allocation of the maximal covering location problem (within the time budget of the parameters) */
+    void runExactAllocation(Loader* loader, AllocationParams* params, QHash<Geometry*, Allocation*>* allocation);
+    /* Allocates the candidates with the highest PageRank, the PageRank is computed again on the remaining
+     * candidates after each allocation (from its last iterate if it does not converge) */
+    void runPageRank(Loader* loader, AllocationParams* params, QHash<Geometry*, Allocation*>* allocation,
+                     double alpha = 0.85, int maxIterations = 100, double tolerance = 1.0e-6);
+    /* Allocates the candidates closest to the k-means centroids of the trace points (within the time
+     * window of the spatial stats), one distinct candidate per centroid from the largest cluster.
+     * Returns false if there is no trace point */
+    bool runKMeans(Loader* loader, AllocationParams* params, QHash<Geometry*, Allocation*>* allocation);
 
 private:
     SpatialStats* _spatialStats;
 
-    /* Returns the cells from "cells" that are within distance "distance" and/or travel time "travelTime" of "cell" in "cellsWithinDistance", depending on "op" */
-    void geomWithin(QSet<Geometry*>* cellsWithin, const QSet<Geometry*>& cells, Geometry* cell, double distance = -1.0, double travelTime = -1.0, DistanceStat ds = AutoDStat, TravelTimeStat ts = MedTTStat);
-
     // private methods for the location allocation computation
+    /* Candidates (the circles if any, the cells otherwise) and demands (the cells) of the allocation */
+    void getCandidatesAndDemands(QSet<Geometry*>* candidates, QSet<Geometry*>* demands);
     double computeBackendWeight(Geometry* c, Geometry* k);
-    double computeCoverageWeight(Geometry* l, Geometry* k, double deadline, QHash<Geometry*, double>* demandsCovered);
+    /* Returns the geometries ordered by their coverage matrix id, so that the ties are broken by geometry id */
+    QList<Geometry*> sortById(const QSet<Geometry*>& geoms, CoverageMatrix* coverageMatrix);
+    /* Scores the candidates on the threads of "pool", the scores are returned in the order of "candidates" */
+    QVector<CandidateScore> scoreCandidates(QThreadPool* pool, const QList<Geometry*>& candidates,
+                                            std::function<CandidateScore(Geometry*)> score);
     void updateTopCandidates(QList<Allocation>* c, Geometry* k,double coverage, double backendWeight, double incomingWeight,
                              QHash<Geometry*, double> const &demandsCovered, QHash<Geometry *, double> const &backendCovered);
-
-    /* Compute the page rank for the given set of cells */
-//    bool pageRank(QHash<Geometry*, double>& x, QSet<Geometry*> cells, double alpha = 0.85, int maxIterations = 100, double tolerance = 1.0e-6);
 };
 
 #endif // COMPUTEALLOCATION_H
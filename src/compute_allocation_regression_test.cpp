@@ -0,0 +1,291 @@
+#include "compute_allocation.h"
+#include "coverage_matrix.h"
+#include "spatial_stats.h"
+#include "geometry_index.h"
+#include "loader.h"
+#include "trace.h"
+
+
+/* To compile this file and execute the main below, add this file to the CMakeList and remove the main.cpp
+ * Usage: ./LocAll [trace] [points file]
+ *  -> without a trace, a synthetic random-walk trace is generated around San Francisco (UTM 10N)
+ *  -> the points file (e.g. ../sf-muni-stops.csv) gives circle candidates, otherwise the cells are used */
+
+/* Reference (brute force) greedy adding with substitution: every (candidate, demand) pair
+ * is rescored at each step, as the allocation did before the incremental coverage engine.
+ * The candidates are scanned in the order of their coverage matrix id, as in the allocation,
+ * so both break the ties with the lowest id */
+class ReferenceAllocation {
+public:
+    ReferenceAllocation(SpatialStats* spatialStats): _spatialStats(spatialStats) { }
+
+    void run(AllocationParams* params, QHash<Geometry*, Allocation*>* allocation) {
+        long long deadline = params->deadline;
+        QSet<Geometry*> cells, circles;
+        QHash<Geometry*, GeometryValue*> geometries;
+        _spatialStats->getGeometries(&geometries);
+        for(auto it = geometries.begin(); it != geometries.end(); ++it) {
+            if(it.key()->getGeometryType() == CellGeometryType) cells.insert(it.key());
+            else if(it.key()->getGeometryType() == CircleGeometryType) circles.insert(it.key());
+        }
+        QSet<Geometry*> allCandidates = circles.isEmpty() ? cells : circles;
+        QSet<Geometry*> candidatesToAllocate = allCandidates;
+        QSet<Geometry*> demandsToCover = cells;
+        int prevAllocated = 0;
+
+        for(int i = 0; i < params->nbFacilities && !demandsToCover.isEmpty(); ++i) {
+            QList<Allocation> topCandidates;
+            double maxCoverage = 0.0, maxBackend = 0.0, maxIncoming = 0.0;
+            QList<Geometry*> candidates = sortById(candidatesToAllocate);
+            for(Geometry* k : candidates) {
+                GeometryValue* geomVal;
+                _spatialStats->getValue(&geomVal, k);
+                maxIncoming = qMax(maxIncoming, (double) geomVal->avgIncomingScore);
+                double backendWeight = 0.0;
+                for(Geometry* c : allocation->keys()) backendWeight += backend(c,k);
+                maxBackend = qMax(maxBackend, backendWeight);
+                double coverage = 0.0;
+                QHash<Geometry*, double> demandsCovered;
+                for(Geometry* l : demandsToCover) coverage += cover(l,k,deadline,&demandsCovered);
+                maxCoverage = qMax(maxCoverage, coverage);
+            }
+            for(Geometry* k : candidates) {
+                GeometryValue* geomVal;
+                _spatialStats->getValue(&geomVal, k);
+                double incomingWeight = geomVal->avgIncomingScore;
+                double backendWeight = 0.0;
+                QHash<Geometry*, double> backendCovered;
+                for(Geometry* c : allocation->keys()) {
+                    double w = backend(c,k);
+                    backendWeight += w;
+                    backendCovered.insert(c, w);
+                }
+                double coverage = 0.0;
+                QHash<Geometry*, double> demandsCovered;
+                for(Geometry* l : demandsToCover) coverage += cover(l,k,deadline,&demandsCovered);
+                double nb = maxBackend > 0.0  ? backendWeight/maxBackend   : 0.0;
+                double nc = maxCoverage > 0.0 ? coverage/maxCoverage       : 0.0;
+                double ni = maxIncoming > 0.0 ? incomingWeight/maxIncoming : 0.0;
+                if(nc > 0 && (i==0 || nb > 0.0))
+                    topCandidates.append(Allocation(k,nc,nb,ni,-1,demandsCovered,backendCovered));
+            }
+
+            Allocation best;
+            if(!topCandidates.isEmpty()) {
+                double bestWeight = -1.0;
+                for(Allocation c : topCandidates) {
+                    if(c.weight > bestWeight) { bestWeight = c.weight; best = c; }
+                }
+                candidatesToAllocate.remove(best.geom);
+                demandsToCover.remove(best.geom);
+                QSet<Geometry*> candidatesToRemove;
+                within(&candidatesToRemove, candidatesToAllocate, best.geom, params);
+                candidatesToAllocate.subtract(candidatesToRemove);
+                demandsToCover.subtract(best.demands.keys().toSet());
+                allocation->insert(best.geom, new Allocation(best.geom, best.weight, best.backendWeight, best.incomingWeight,
+                                                             i, best.demands, best.backends, candidatesToRemove));
+            }
+
+            for(Geometry* k : allocation->keys()) {
+                if(k == best.geom) continue;
+                Allocation* alloc = allocation->value(k);
+                QSet<Geometry*> prevDemandsCovered = alloc->demands.keys().toSet();
+                QSet<Geometry*> prevDeletedCandidates = alloc->deletedCandidates;
+                QList<Allocation> newTopCandidates;
+                double newMaxCoverage = 0.0, newMaxBackend = 0.0, newMaxIncoming = 0.0;
+                QList<Geometry*> substitutes = sortById(allCandidates - allocation->keys().toSet());
+                for(Geometry* k1 : substitutes) {
+                    GeometryValue* geomVal;
+                    _spatialStats->getValue(&geomVal, k);
+                    newMaxIncoming = qMax(newMaxIncoming, (double) geomVal->avgIncomingScore);
+                    double backendWeight = 0.0;
+                    for(Geometry* c : allocation->keys()) if(c != k) backendWeight += backend(c,k1);
+                    newMaxBackend = qMax(newMaxBackend, backendWeight);
+                    double coverage = 0.0;
+                    QHash<Geometry*, double> demandsCovered;
+                    for(Geometry* l : demandsToCover + prevDemandsCovered) coverage += cover(l,k1,deadline,&demandsCovered);
+                    newMaxCoverage = qMax(newMaxCoverage, coverage);
+                }
+                for(Geometry* k1 : substitutes) {
+                    GeometryValue* geomVal;
+                    _spatialStats->getValue(&geomVal, k1);
+                    double incomingWeight = geomVal->avgIncomingScore;
+                    QHash<Geometry*, double> demandsCovered, backendCovered;
+                    double backendWeight = 0.0;
+                    for(Geometry* c : allocation->keys()) {
+                        if(c == k) continue;
+                        double w = backend(c,k1);
+                        backendWeight += w;
+                        backendCovered.insert(c,w);
+                    }
+                    double coverage = 0.0;
+                    for(Geometry* l : demandsToCover + prevDemandsCovered) coverage += cover(l,k1,deadline,&demandsCovered);
+                    double nb = newMaxBackend > 0.0  ? backendWeight/newMaxBackend   : 0.0;
+                    double nc = newMaxCoverage > 0.0 ? coverage/newMaxCoverage       : 0.0;
+                    double ni = newMaxIncoming > 0.0 ? incomingWeight/newMaxIncoming : 0.0;
+                    if(nc > 0 && nb > 0.0)
+                        newTopCandidates.append(Allocation(k1,nc,nb,ni,-1,demandsCovered,backendCovered));
+                }
+                Allocation newBest;
+                double newBestWeight = 0.0;
+                for(Allocation c : newTopCandidates) {
+                    if(c.weight > newBestWeight) { newBestWeight = c.weight; newBest = c; }
+                }
+                if(alloc->weight < newBestWeight) {
+                    allocation->remove(k);
+                    QSet<Geometry*> candidatesToRemove;
+                    within(&candidatesToRemove, candidatesToAllocate + prevDeletedCandidates, newBest.geom, params);
+                    allocation->insert(newBest.geom, new Allocation(newBest.geom, newBest.weight, newBest.backendWeight, newBest.incomingWeight,
+                                                                    -1, newBest.demands, newBest.backends, candidatesToRemove));
+                    candidatesToAllocate.subtract(candidatesToRemove);
+                    candidatesToAllocate.unite(prevDeletedCandidates);
+                    candidatesToAllocate.remove(newBest.geom);
+                    candidatesToAllocate.insert(k);
+                    demandsToCover.unite(prevDemandsCovered);
+                    demandsToCover.subtract(newBest.demands.keys().toSet());
+                }
+            }
+
+            if(prevAllocated == allocation->size())
+                break;
+            prevAllocated = allocation->size();
+        }
+    }
+
+private:
+    SpatialStats* _spatialStats;
+
+    QList<Geometry*> sortById(const QSet<Geometry*>& geoms) {
+        CoverageMatrix* coverageMatrix = _spatialStats->getCoverageMatrix();
+        QList<Geometry*> sorted = geoms.toList();
+        std::sort(sorted.begin(), sorted.end(), [coverageMatrix](Geometry* a, Geometry* b) {
+            return coverageMatrix->getId(a) < coverageMatrix->getId(b);
+        });
+        return sorted;
+    }
+
+    double backend(Geometry* c, Geometry* k) {
+        double weight = 0.0;
+        GeometryMatrixValue* val;
+        _spatialStats->getValue(&val,k,c);
+        if(val && val->visits.size() > 1) weight += val->avgScore;
+        _spatialStats->getValue(&val,c,k);
+        if(val && val->visits.size() > 1) weight += val->avgScore;
+        return weight;
+    }
+
+    double cover(Geometry* l, Geometry* k, double deadline, QHash<Geometry*, double>* demandsCovered) {
+        GeometryMatrixValue* val;
+        _spatialStats->getValue(&val,l,k);
+        if(val && val->travelTimeDist.getMedian() <= deadline && val->visits.size() > 1) {
+            demandsCovered->insert(l, val->avgScore);
+            return val->avgScore;
+        }
+        return 0.0;
+    }
+
+    void within(QSet<Geometry*>* res, const QSet<Geometry*>& geoms, Geometry* geom, AllocationParams* params) {
+        if(params->dStat == NoneDStat && params->ttStat == NoneTTStat)
+            return;
+        foreach(Geometry* g, geoms) {
+            if(g == geom) continue;
+            bool distanceFlag = false, travelTimeFlag = false;
+            if(params->dStat != NoneDStat && params->distance > 0.0)
+                distanceFlag = std::islessequal(g->distance(geom), params->distance);
+            if(params->ttStat != NoneTTStat || params->travelTime > 0.0) {
+                GeometryMatrixValue* val;
+                _spatialStats->getValue(&val, g, geom);
+                if(val) {
+                    double tt = 0.0;
+                    if(params->ttStat == AvgTTStat) tt = val->travelTimeDist.getAverage();
+                    else if(params->ttStat == MedTTStat) tt = val->travelTimeDist.getMedian();
+                    else if(params->ttStat == PctTTStat) tt = val->travelTimeDist.getPercentile(params->ttPercentile);
+                    travelTimeFlag = std::islessequal(tt, params->travelTime);
+                }
+            }
+            if((params->dStat != NoneDStat && distanceFlag) || (params->ttStat != NoneTTStat && travelTimeFlag))
+                res->insert(g);
+        }
+    }
+};
+
+void generateSyntheticTrace(Trace* trace, int nbNodes, int nbPoints) {
+    qsrand(42);
+    for(int n = 0; n < nbNodes; ++n) {
+        double x = 548000.0 + qrand() % 6000;
+        double y = 4176000.0 + qrand() % 6000;
+        long long ts = 1000;
+        for(int i = 0; i < nbPoints; ++i) {
+            trace->addPoint(QString::number(n), ts, x, y);
+            x += (qrand() % 401) - 200;
+            y += (qrand() % 401) - 200;
+            ts += 30 + qrand() % 60;
+        }
+    }
+}
+
+bool compareAllocations(const QHash<Geometry*, Allocation*>& ref, const QHash<Geometry*, Allocation*>& res) {
+    if(ref.keys().toSet() != res.keys().toSet()) {
+        qDebug() << "allocated facilities differ" << ref.size() << res.size();
+        return false;
+    }
+    for(auto it = ref.begin(); it != ref.end(); ++it) {
+        Allocation* a = it.value();
+        Allocation* b = res.value(it.key());
+        if(a->rank != b->rank
+           || !qFuzzyCompare(1.0 + a->weight, 1.0 + b->weight)
+           || !qFuzzyCompare(1.0 + a->backendWeight, 1.0 + b->backendWeight)
+           || !qFuzzyCompare(1.0 + a->incomingWeight, 1.0 + b->incomingWeight)
+           || a->demands.keys().toSet() != b->demands.keys().toSet()
+           || a->deletedCandidates != b->deletedCandidates) {
+            qDebug() << "facility" << it.key()->toString() << "differs"
+                     << a->rank << b->rank << a->weight << b->weight
+                     << a->demands.size() << b->demands.size()
+                     << a->deletedCandidates.size() << b->deletedCandidates.size();
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+
+    Loader l;
+    Trace* trace;
+    if(argc > 1) {
+        trace = new Trace(argv[1]);
+        trace->openTrace(&l);
+    } else {
+        trace = new Trace("synthetic");
+        generateSyntheticTrace(trace, 40, 400);
+    }
+
+    GeometryType pointsType = (argc > 2) ? CircleGeometryType : NoneGeometryType;
+    QString pointsFile = (argc > 2) ? QString(argv[2]) : QString();
+    GeometryIndex* geometryIndex = trace->makeGeometryIndex(10, -1, -1, 200, pointsType, pointsFile);
+    SpatialStats* spatialStats = new SpatialStats(trace, 10, -1, -1, geometryIndex);
+    spatialStats->computeStats(&l);
+
+    ComputeAllocation computeAllocation(spatialStats);
+    ReferenceAllocation referenceAllocation(spatialStats);
+
+    QList<AllocationParams> paramsList;
+    paramsList << AllocationParams(300, 10, 1.0, NoneTTStat, FixedDStat, 0.0, 500.0, LOCATION_ALLOCATION_MEHTOD_NAME)
+               << AllocationParams(600, 20, 1.0, NoneTTStat, FixedDStat, 0.0, 1000.0, LOCATION_ALLOCATION_MEHTOD_NAME)
+               << AllocationParams(600, 20, 1.0, MedTTStat, NoneDStat, 120.0, 0.0, LOCATION_ALLOCATION_MEHTOD_NAME)
+               << AllocationParams(1200, 5, 1.0, NoneTTStat, NoneDStat, 0.0, 0.0, LOCATION_ALLOCATION_MEHTOD_NAME);
+
+    int failures = 0;
+    for(AllocationParams params : paramsList) {
+        QHash<Geometry*, Allocation*> ref, res;
+        referenceAllocation.run(&params, &ref);
+        computeAllocation.runLocationAllocation(&l, &params, &res);
+        bool ok = compareAllocations(ref, res);
+        qDebug() << (ok ? "[OK]" : "[FAILED]") << "deadline" << params.deadline << "nbFacilities" << params.nbFacilities
+                 << "allocated" << res.size();
+        if(!ok) failures++;
+    }
+
+    return failures;
+}
@@ -8,6 +8,21 @@
 
 const long long MaxTime = std::numeric_limits<long long>::max();
 const int    GRID_SIZE = 2000;
+const long long DEFAULT_HORIZON = 3600; // largest deadline (s) queried to the allocation
+const long long DEFAULT_BUCKET_SIZE = 900; // time buckets (s) of the visit matrix, merged into the time windows
+const int    WINDOW_CACHE_SIZE = 8; // time windows of the spatial stats kept for the next requests
+const double NATIVE_PROJ_TOLERANCE = 0.0005; // largest deviation (m) of the native projection from PROJ
+const int    PROJ_BATCH_SIZE = 65536; // points projected at once by the loaders
+const int    DISTRIBUTION_MAX_EXACT_VALUES = 256; // distinct values counted exactly before switching to a histogram
+const int    DISTRIBUTION_HISTOGRAM_BITS = 7; // values below 2^7 are exact in the histogram, relative error below 2^-7 above
+const double DEFAULT_MCLP_TIME_BUDGET = 60.0; // time budget (s) of the exact MCLP solver
+const int    MCLP_ROOT_ITERATIONS = 300; // subgradient iterations of the Lagrangian bound at the root node
+const int    MCLP_NODE_ITERATIONS = 30; // subgradient iterations at the other nodes (warm started)
+const int    MCLP_STALL_ITERATIONS = 5; // iterations without improving the bound before halving the step
+const int    KMEANS_BATCH_SIZE = 4096; // points drawn at each mini-batch k-means iteration
+const int    KMEANS_MAX_ITERATIONS = 300; // mini-batch iterations at most
+const double KMEANS_TOLERANCE = 1.0; // largest centroid move (m) of a mini-batch at convergence
+const int    KMEANS_SEEDING_SAMPLE = 65536; // points sampled for the k-means++ seeding
 
 const QTimeZone TZ_EST("America/New_York");
 
@@ -47,6 +62,7 @@ const QString LOCATION_ALLOCATION_MEHTOD_NAME = "Location allocation";
 const QString PAGE_RANK_MEHTOD_NAME = "Page Rank";
 const QString K_MEANS_MEHTOD_NAME = "k-means";
 const QString RANDOM_METHOD_NAME = "random";
+const QString EXACT_MCLP_METHOD_NAME = "Exact MCLP";
 
 const QString RTE_DISPLAY_JOURNEY_TIME  = "Journey time";
 const QString RTE_DISPLAY_TRAFFIC_FLOW  = "Traffic flow";
@@ -94,9 +110,11 @@ const QString WAZE_SUBALERT_HAZARD_WEATHER_FREEZING_RAIN = "HAZARD_WEATHER_FREEZ
 
 /* ENUM TYPES */
 enum GeometryType   { NoneGeometryType, CircleGeometryType, CellGeometryType, CoordGeometryType, PathGeometryType, PolygonGeometryType };
+enum GeometryIndexType { GridIndexType, RTreeIndexType };
 enum WithinOperator { AndWithin, OrWithin, NoneWithin };
-enum TravelTimeStat { NoneTTStat, MedTTStat, AvgTTStat };
+enum TravelTimeStat { NoneTTStat, MedTTStat, AvgTTStat, PctTTStat };
 enum DistanceStat   { NoneDStat, AutoDStat, FixedDStat };
+enum GetisOrdWeights { InverseDistanceWeights, FixedBandWeights, KNearestWeights };
 enum RoadTrafficDataType {
     JourneyTimeRTDType,
     FlowRTDType,
@@ -0,0 +1,156 @@
+#include "coverage_engine.h"
+
+#include "coverage_matrix.h"
+
+CoverageEngine::CoverageEngine(CoverageMatrix* coverageMatrix,
+                               const QSet<Geometry*>& candidates,
+                               const QSet<Geometry*>& demands,
+                               double deadline):
+        _coverageMatrix(coverageMatrix),
+        _demandsToCover(demands) {
+
+    int n = coverageMatrix->getNbGeometries();
+    QVector<bool> isCandidate(n, false);
+    for(Geometry* k : candidates) {
+        int id = coverageMatrix->getId(k);
+        if(id >= 0) isCandidate[id] = true;
+    }
+    QVector<bool> isDemand(n, false);
+    for(Geometry* l : demands) {
+        int id = coverageMatrix->getId(l);
+        if(id >= 0) isDemand[id] = true;
+    }
+    _toCover = isDemand;
+
+    // a demand is covered by a candidate if the median travel time from the demand is within the deadline
+    auto covers = [&](int link) {
+        return coverageMatrix->getMedTravelTime(link) <= deadline
+               && coverageMatrix->getVisitCount(link) > 1;
+    };
+
+    // demands covered by each candidate (links reaching the candidate)
+    _candidateOffsets.fill(0, n+1);
+    for(int k = 0; k < n; ++k) {
+        _candidateOffsets[k] = _candidateDemands.size();
+        if(!isCandidate[k])
+            continue;
+        for(int idx = coverageMatrix->colBegin(k); idx < coverageMatrix->colEnd(k); ++idx) {
+            int link = coverageMatrix->transposedLink(idx);
+            int l = coverageMatrix->getRow(link);
+            if(isDemand[l] && covers(link)) {
+                _candidateDemands.append(l);
+                _candidateWeights.append(coverageMatrix->getAvgScore(link));
+            }
+        }
+    }
+    _candidateOffsets[n] = _candidateDemands.size();
+
+    // candidates reached by each demand (links leaving the demand)
+    _demandOffsets.fill(0, n+1);
+    for(int l = 0; l < n; ++l) {
+        _demandOffsets[l] = _demandCandidates.size();
+        if(!isDemand[l])
+            continue;
+        for(int link = coverageMatrix->rowBegin(l); link < coverageMatrix->rowEnd(l); ++link) {
+            int k = coverageMatrix->getCol(link);
+            if(isCandidate[k] && covers(link)) {
+                _demandCandidates.append(k);
+            }
+        }
+    }
+    _demandOffsets[n] = _demandCandidates.size();
+
+    // initial coverage weights, all the demands are to cover
+    _coverageSums.fill(0.0, n);
+    for(int k = 0; k < n; ++k) {
+        double coverage = 0.0;
+        for(int idx = _candidateOffsets[k]; idx < _candidateOffsets[k+1]; ++idx) {
+            coverage += _candidateWeights[idx];
+        }
+        _coverageSums[k] = coverage;
+    }
+}
+
+double CoverageEngine::getCoverage(Geometry* k) const {
+    int id = _coverageMatrix->getId(k);
+    return id >= 0 ? _coverageSums.at(id) : 0.0;
+}
+
+double CoverageEngine::getCoverage(Geometry* k, const QSet<Geometry*>& extraDemands) const {
+    if(extraDemands.isEmpty())
+        return getCoverage(k);
+
+    int id = _coverageMatrix->getId(k);
+    if(id < 0)
+        return 0.0;
+
+    double coverage = 0.0;
+    for(int idx = _candidateOffsets[id]; idx < _candidateOffsets[id+1]; ++idx) {
+        int l = _candidateDemands[idx];
+        if(_toCover[l] || extraDemands.contains(_coverageMatrix->getGeometry(l)))
+            coverage += _candidateWeights[idx];
+    }
+    return coverage;
+}
+
+void CoverageEngine::getDemandsCovered(QHash<Geometry*, double>* demandsCovered, Geometry* k,
+                                       const QSet<Geometry*>& extraDemands) const {
+    int id = _coverageMatrix->getId(k);
+    if(id < 0)
+        return;
+
+    for(int idx = _candidateOffsets[id]; idx < _candidateOffsets[id+1]; ++idx) {
+        Geometry* l = _coverageMatrix->getGeometry(_candidateDemands[idx]);
+        if(_toCover[_candidateDemands[idx]] || extraDemands.contains(l))
+            demandsCovered->insert(l, _candidateWeights[idx]);
+    }
+}
+
+void CoverageEngine::coverDemands(const QSet<Geometry*>& demands) {
+    QVector<int> changed;
+    for(Geometry* l : demands) {
+        if(!_demandsToCover.remove(l))
+            continue;
+        int id = _coverageMatrix->getId(l);
+        if(id >= 0) {
+            _toCover[id] = false;
+            changed.append(id);
+        }
+    }
+    updateCoverage(changed);
+}
+
+void CoverageEngine::releaseDemands(const QSet<Geometry*>& demands) {
+    QVector<int> changed;
+    for(Geometry* l : demands) {
+        if(_demandsToCover.contains(l))
+            continue;
+        _demandsToCover.insert(l);
+        int id = _coverageMatrix->getId(l);
+        if(id >= 0) {
+            _toCover[id] = true;
+            changed.append(id);
+        }
+    }
+    updateCoverage(changed);
+}
+
+void CoverageEngine::updateCoverage(const QVector<int>& demands) {
+    // get the candidates reached by the demands that changed
+    QSet<int> candidates;
+    for(int l : demands) {
+        for(int idx = _demandOffsets[l]; idx < _demandOffsets[l+1]; ++idx) {
+            candidates.insert(_demandCandidates[idx]);
+        }
+    }
+
+    // recompute their sum rather than subtracting, so that the weights do not drift
+    for(int k : candidates) {
+        double coverage = 0.0;
+        for(int idx = _candidateOffsets[k]; idx < _candidateOffsets[k+1]; ++idx) {
+            if(_toCover[_candidateDemands[idx]])
+                coverage += _candidateWeights[idx];
+        }
+        _coverageSums[k] = coverage;
+    }
+}
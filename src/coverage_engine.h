@@ -0,0 +1,64 @@
+#ifndef LOCALL_COVERAGE_ENGINE_H
+#define LOCALL_COVERAGE_ENGINE_H
+
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+// forward class declarations
+class Geometry;
+class CoverageMatrix;
+
+/* Keeps the coverage weight of each candidate over the demands that remain to be covered.
+ * The (demand, candidate) pairs within the deadline are extracted once from the coverage matrix,
+ * then covering or releasing demands only updates the candidates these demands can reach. */
+class CoverageEngine {
+public:
+    CoverageEngine(CoverageMatrix* coverageMatrix,
+                   const QSet<Geometry*>& candidates,
+                   const QSet<Geometry*>& demands,
+                   double deadline);
+
+    const QSet<Geometry*>& getDemandsToCover() const {
+        return _demandsToCover;
+    }
+
+    /* Coverage weight of candidate k over the demands to cover */
+    double getCoverage(Geometry* k) const;
+
+    /* Coverage weight of candidate k over the demands to cover and the "extraDemands" */
+    double getCoverage(Geometry* k, const QSet<Geometry*>& extraDemands) const;
+
+    /* Returns the demands covered by candidate k (with their weight) in "demandsCovered" */
+    void getDemandsCovered(QHash<Geometry*, double>* demandsCovered, Geometry* k,
+                           const QSet<Geometry*>& extraDemands = QSet<Geometry*>()) const;
+
+    /* Remove the demands from (resp. add the demands back to) the demands to cover */
+    void coverDemands(const QSet<Geometry*>& demands);
+    void releaseDemands(const QSet<Geometry*>& demands);
+
+    /* The demands within the deadline of the candidate of id k (coverage matrix ids) are
+     * getCandidateDemand(idx) for idx in [candidateBegin(k), candidateEnd(k)), with their weight */
+    int candidateBegin(int k) const { return _candidateOffsets.at(k); }
+    int candidateEnd(int k) const { return _candidateOffsets.at(k+1); }
+    int getCandidateDemand(int idx) const { return _candidateDemands.at(idx); }
+    double getCandidateWeight(int idx) const { return _candidateWeights.at(idx); }
+
+private:
+    CoverageMatrix* _coverageMatrix;
+
+    // <candidate id, [demand id]> and <demand id, [candidate id]> within the deadline (CSR)
+    QVector<int> _candidateOffsets;
+    QVector<int> _candidateDemands;
+    QVector<double> _candidateWeights;
+    QVector<int> _demandOffsets;
+    QVector<int> _demandCandidates;
+
+    QVector<double> _coverageSums;  // <candidate id, coverage weight>
+    QVector<bool> _toCover;         // <demand id, demand to cover>
+    QSet<Geometry*> _demandsToCover;
+
+    void updateCoverage(const QVector<int>& demands);
+};
+
+#endif //LOCALL_COVERAGE_ENGINE_H
@@ -0,0 +1,114 @@
+#include "coverage_matrix.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "spatial_stats.h"
+#include "geometry_index.h"
+
+CoverageMatrix::CoverageMatrix(SpatialStats* spatialStats) {
+    QHash<Geometry*, GeometryValue*> geometries;
+    spatialStats->getGeometries(&geometries);
+    QHash<Geometry*, QHash<Geometry*, GeometryMatrixValue*>*> geometryMatrix;
+    spatialStats->getGeometryMatrix(&geometryMatrix);
+
+    // give an integer id to every geometry of the matrix (nodes and links)
+    QSet<Geometry*> geoms = geometries.keys().toSet();
+    for(auto it = geometryMatrix.begin(); it != geometryMatrix.end(); ++it) {
+        geoms.insert(it.key());
+        for(auto jt = it.value()->begin(); jt != it.value()->end(); ++jt)
+            geoms.insert(jt.key());
+    }
+    // total order (the ids do not depend on the hash order): by center, geometry type and bounds,
+    // then by id in the geometry index (the order in which the geometries were created), e.g.
+    // for the duplicate circles
+    QHash<Geometry*, int> indexIds;
+    GeometryIndex* geometryIndex = spatialStats->getGeometryIndex();
+    for(int id = 0; geometryIndex && id < geometryIndex->size(); ++id) {
+        indexIds.insert(geometryIndex->getGeometry(id), id);
+    }
+    _geometries = geoms.toList().toVector();
+    std::sort(_geometries.begin(), _geometries.end(), [&indexIds](Geometry* a, Geometry* b) {
+        QPointF ca = a->getCenter(), cb = b->getCenter();
+        if(ca.x() != cb.x()) return ca.x() < cb.x();
+        if(ca.y() != cb.y()) return ca.y() < cb.y();
+        if(a->getGeometryType() != b->getGeometryType()) return a->getGeometryType() < b->getGeometryType();
+        QPointF ta = a->getBounds().getTopLeft(), tb = b->getBounds().getTopLeft();
+        if(ta.x() != tb.x()) return ta.x() < tb.x();
+        if(ta.y() != tb.y()) return ta.y() < tb.y();
+        QPointF ba = a->getBounds().getBottomRight(), bb = b->getBounds().getBottomRight();
+        if(ba.x() != bb.x()) return ba.x() < bb.x();
+        if(ba.y() != bb.y()) return ba.y() < bb.y();
+        return indexIds.value(a, INT_MAX) < indexIds.value(b, INT_MAX);
+    });
+    int n = _geometries.size();
+    _ids.reserve(n);
+    for(int i = 0; i < n; ++i) {
+        _ids.insert(_geometries.at(i), i);
+    }
+
+    // fill the rows (ordered by column)
+    _rowOffsets.fill(0, n+1);
+    QVector<int> colCounts(n, 0);
+    for(int row = 0; row < n; ++row) {
+        _rowOffsets[row] = _cols.size();
+        QHash<Geometry*, GeometryMatrixValue*>* values = geometryMatrix.value(_geometries.at(row), nullptr);
+        if(!values)
+            continue;
+
+        QList<QPair<int, GeometryMatrixValue*>> links;
+        for(auto it = values->begin(); it != values->end(); ++it) {
+            links.append(qMakePair(_ids.value(it.key()), it.value()));
+        }
+        std::sort(links.begin(), links.end(), [](const QPair<int, GeometryMatrixValue*>& a,
+                                                 const QPair<int, GeometryMatrixValue*>& b) {
+            return a.first < b.first;
+        });
+
+        for(const QPair<int, GeometryMatrixValue*>& p : links) {
+            GeometryMatrixValue* val = p.second;
+            _rows.append(row);
+            _cols.append(p.first);
+            _medTravelTimes.append(val->travelTimeDist.getMedian());
+            _avgTravelTimes.append(val->travelTimeDist.getAverage());
+            _travelTimeDists.append(&val->travelTimeDist);
+            _avgScores.append(val->avgScore);
+            _medScores.append(val->medScore);
+            _visitCounts.append(val->visits.size());
+            colCounts[p.first]++;
+        }
+    }
+    _rowOffsets[n] = _cols.size();
+
+    // transposed index, links ordered by column then by row
+    _colOffsets.fill(0, n+1);
+    for(int col = 0; col < n; ++col) {
+        _colOffsets[col+1] = _colOffsets[col] + colCounts[col];
+    }
+    _transposed.resize(_cols.size());
+    QVector<int> fill = _colOffsets;
+    for(int link = 0; link < _cols.size(); ++link) {
+        _transposed[fill[_cols[link]]++] = link;
+    }
+}
+
+int CoverageMatrix::find(int row, int col) const {
+    if(row < 0 || col < 0)
+        return -1;
+
+    auto begin = _cols.constBegin() + _rowOffsets.at(row);
+    auto end   = _cols.constBegin() + _rowOffsets.at(row+1);
+    auto it = std::lower_bound(begin, end, col);
+    if(it != end && *it == col)
+        return (int) (it - _cols.constBegin());
+    return -1;
+}
+
+double CoverageMatrix::getTravelTime(int link, TravelTimeStat stat, double percentile) const {
+    switch(stat) {
+        case MedTTStat: return _medTravelTimes.at(link);
+        case AvgTTStat: return _avgTravelTimes.at(link);
+        case PctTTStat: return _travelTimeDists.at(link)->getPercentile(percentile);
+        default:        return 0.0;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef LOCALL_COVERAGE_MATRIX_H
+#define LOCALL_COVERAGE_MATRIX_H
+
+#include <QHash>
+#include <QVector>
+
+#include "constants.h"
+
+// forward class declarations
+class Geometry;
+class SpatialStats;
+class Distribution;
+
+/* Compact (CSR) copy of the visit matrix used by the allocation methods.
+ * Geometries get integer ids (ordered by their center, then by their creation order for the
+ * geometries at the same place, so ids are stable across runs),
+ * and each (geom1, geom2) link stores its travel times, score and visit count once,
+ * so that the allocation loop scans contiguous arrays instead of nested hashes. */
+class CoverageMatrix {
+public:
+    CoverageMatrix(SpatialStats* spatialStats);
+
+    int getNbGeometries() const { return _geometries.size(); }
+    int getNbLinks() const { return _cols.size(); }
+
+    int getId(Geometry* geom) const { return _ids.value(geom, -1); }
+    Geometry* getGeometry(int id) const { return _geometries.at(id); }
+
+    /* Links leaving geometry "row" are in [rowBegin(row), rowEnd(row)), ordered by column */
+    int rowBegin(int row) const { return _rowOffsets.at(row); }
+    int rowEnd(int row) const { return _rowOffsets.at(row+1); }
+
+    /* Links reaching geometry "col" are _transposed[colBegin(col)..colEnd(col)) (link indexes) */
+    int colBegin(int col) const { return _colOffsets.at(col); }
+    int colEnd(int col) const { return _colOffsets.at(col+1); }
+    int transposedLink(int idx) const { return _transposed.at(idx); }
+
+    /* Returns the link index of (row, col), or -1 if the geometries are not linked */
+    int find(int row, int col) const;
+
+    int getRow(int link) const { return _rows.at(link); }
+    int getCol(int link) const { return _cols.at(link); }
+    double getMedTravelTime(int link) const { return _medTravelTimes.at(link); }
+    double getAvgTravelTime(int link) const { return _avgTravelTimes.at(link); }
+    /* Travel time of the link for the statistic "stat" ("percentile" in [0,1] with PctTTStat) */
+    double getTravelTime(int link, TravelTimeStat stat, double percentile = 0.5) const;
+    double getAvgScore(int link) const { return _avgScores.at(link); }
+    double getMedScore(int link) const { return _medScores.at(link); }
+    int getVisitCount(int link) const { return _visitCounts.at(link); }
+
+private:
+    QVector<Geometry*> _geometries;     // <id, geometry>
+    QHash<Geometry*, int> _ids;         // <geometry, id>
+
+    QVector<int> _rowOffsets;           // CSR row offsets (size nbGeometries+1)
+    QVector<int> _rows;                 // row of each link
+    QVector<int> _cols;                 // column of each link
+    QVector<double> _medTravelTimes;
+    QVector<double> _avgTravelTimes;
+    QVector<const Distribution*> _travelTimeDists; // distribution of the travel times (other percentiles)
+    QVector<double> _avgScores;
+    QVector<double> _medScores;
+    QVector<int> _visitCounts;
+
+    QVector<int> _colOffsets;           // transposed offsets (size nbGeometries+1)
+    QVector<int> _transposed;           // link indexes ordered by column, then row
+};
+
+#endif //LOCALL_COVERAGE_MATRIX_H
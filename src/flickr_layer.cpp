@@ -40,6 +40,9 @@ bool FlickrTrace::openTrace(Loader* loader) {
     if(!file->open(QFile::ReadOnly | QFile::Text))
         return false;
 
+    QStringList nodes;
+    QVector<long long> timestamps;
+    QVector<double> xs, ys;
     while(!file->atEnd()) {
         QString line = QString(file->readLine()).split(QRegExp("[\r\n]"), QString::SkipEmptyParts).at(0);
         QStringList fields = line.split(" ");
@@ -50,14 +53,20 @@ bool FlickrTrace::openTrace(Loader* loader) {
 //        qDebug() << "(" << node << "," << ts << "," << lat << "," << lon << ")";
         if(ts <= 0)
             continue;
-        // convert the points to the local projection
-        double x, y;
-        ProjFactory::getInstance().transformCoordinates(lat, lon, &x, &y);
-//        qDebug() << "adding node" << node << "(" << x << "," << y << "," << ts << ")";
-        addPoint(node, ts, x, y);
+        nodes.append(node);
+        timestamps.append(ts);
+        xs.append(lon);
+        ys.append(lat);
         loader->loadProgressChanged(1.0 - file->bytesAvailable() / (qreal) file->size(), "");
     }
 
+    // convert the points to the local projection
+    ProjFactory::getInstance().transformCoordinates(xs.size(), xs.data(), ys.data());
+    for(int i = 0; i < nodes.size(); ++i) {
+//        qDebug() << "adding node" << nodes.at(i) << "(" << xs.at(i) << "," << ys.at(i) << "," << timestamps.at(i) << ")";
+        addPoint(nodes.at(i), timestamps.at(i), xs.at(i), ys.at(i));
+    }
+
     qDebug() << "[DONE] loading file";
     loader->loadProgressChanged((qreal) 1.0, "Done");
 
@@ -153,12 +162,17 @@ void FlickrLayer::addBarMenuItems() {
                 QList<QPointF>* points = new QList<QPointF>();
                 OGRPolygon* poly = (OGRPolygon*) poGeometry;
                 OGRPoint pt;
+                QVector<QPointF> ring; // (lon, lat) of the exterior ring
                 for(int i = 0; i < poly->getExteriorRing()->getNumPoints(); ++i) {
                     poly->getExteriorRing()->getPoint(i, &pt);
-                    double x,y;
-                    ProjFactory::getInstance().transformCoordinates(pt.getY(),pt.getX(), &x,&y);
-                    qDebug() << x << y;
-                    points->append(QPointF(x,-1*y));
+                    ring.append(QPointF(pt.getX(), pt.getY()));
+                }
+                // the coordinates of the points are interleaved doubles (stride of 2)
+                if(!ring.isEmpty())
+                    ProjFactory::getInstance().transformCoordinates(ring.size(), &ring[0].rx(), &ring[0].ry(), 2);
+                for(const QPointF& p : ring) {
+                    qDebug() << p.x() << p.y();
+                    points->append(QPointF(p.x(),-1*p.y()));
                 }
                 polygons.append(points);
             }
@@ -18,10 +18,6 @@ public:
             Trace(filename) { }
 
     virtual bool openTrace(Loader* loader);
-
-private:
-    QHash<QString, QMap<long long, QPointF>*> _nodes;
-
 };
 
 class FlickrLayer : public TraceLayer {
@@ -111,9 +111,9 @@ public:
         return std::islessequal(distance,_radius);
     }
     QString toString() { return "Circle center ("+QString::number(_center.x())+","+QString::number(_center.y())+") radius" + QString::number(_radius); }
+    double getRadius() { return _radius; }
 
 private:
-    QPointF _center;
     double _radius;
 };
 
@@ -1,19 +1,49 @@
 #include "geometry_index.h"
 #include "geometries.h"
 
+#include <algorithm>
+#include <limits>
+
 inline uint qHash(const QPointF &key) {
     return qHash(key.x()) ^ qHash(key.y());
 }
 
-GeometryIndex::GeometryIndex(const QSet<Geometry*>& geometries, double cellSize) {
+GeometryIndex::GeometryIndex(const QList<Geometry*>& geometries, double cellSize, GeometryIndexType indexType) {
     // save the cell size
     if(cellSize == -1.0) _cellSize = 100; // default cell size
     else _cellSize = cellSize;
 
-    qDebug() << "geometry index / number of geometries" << geometries.size();
+    qDebug() << "geometry index / number of geometries" << geometries.size() << "type" << indexType;
 
-    // populate the Geometry set with the given geometries
-    for(Geometry* geom : geometries) {
+    // the geometries are referred to by their id in the kernels
+    _kernels = GeometryKernels(geometries);
+
+    if(indexType == RTreeIndexType) {
+        // pack the bounds of the geometries in the R-tree
+        QVector<RTree::Entry> entries;
+        entries.reserve(_kernels.size());
+        for(int id = 0; id < _kernels.size(); ++id) {
+            Geometry* geom      = _kernels.getGeometry(id);
+            QPointF topLeft     = geom->getBounds().getTopLeft();
+            QPointF bottomRight = geom->getBounds().getBottomRight();
+            entries.append({ { topLeft.x(), bottomRight.x(), topLeft.y(), bottomRight.y() }, geom, id });
+        }
+        _rtree = new RTree(entries);
+        return;
+    }
+
+    // point queries in a flat array when all the geometries are cells of the grid
+    _dense = makeDenseGrid(geometries);
+    if(!_dense) {
+        _denseCells.clear();
+        _denseGrid.clear();
+        _denseWidth = _denseHeight = 0;
+    }
+    qDebug() << "geometry index / dense grid" << _dense << _denseWidth << _denseHeight;
+
+    // populate the grid with the ids of the geometries (in increasing order)
+    for(int id = 0; id < _kernels.size(); ++id) {
+        Geometry* geom        = _kernels.getGeometry(id);
         QPointF topLeft       = geom->getBounds().getTopLeft();
         QPointF bottomRight   = geom->getBounds().getBottomRight();
         QPoint topLeftIdx     = getGridCellAt(topLeft);
@@ -26,14 +56,101 @@ GeometryIndex::GeometryIndex(const QSet<Geometry*>& geometries, double cellSize)
             for(int j = topLeftIdx.y(); j <= bottomRightIdx.y(); ++j) {
                 QPoint cellIdx(i,j);
                 if(!_geometryGrid.contains(cellIdx))
-                    _geometryGrid.insert(cellIdx, new QSet<Geometry*>());
-                _geometryGrid.value(cellIdx)->insert(geom);
+                    _geometryGrid.insert(cellIdx, new QVector<int>());
+                _geometryGrid.value(cellIdx)->append(id);
             }
         }
     }
+
+    // extent of the grid (bounds the ring expansion of the nearest queries)
+    for(auto it = _geometryGrid.begin(); it != _geometryGrid.end(); ++it) {
+        QPoint idx = it.key();
+        if(it == _geometryGrid.begin())
+            _minGridIdx = _maxGridIdx = idx;
+        _minGridIdx = QPoint(qMin(_minGridIdx.x(), idx.x()), qMin(_minGridIdx.y(), idx.y()));
+        _maxGridIdx = QPoint(qMax(_maxGridIdx.x(), idx.x()), qMax(_maxGridIdx.y(), idx.y()));
+    }
+}
+
+GeometryIndex::~GeometryIndex() {
+    qDeleteAll(_geometryGrid);
+    delete _rtree;
+}
+
+bool GeometryIndex::makeDenseGrid(const QList<Geometry*>& geometries) {
+    if(geometries.isEmpty())
+        return false;
+
+    // each cell must start in its own grid cell and cover at most the next grid cell in x and y
+    // (up to the bounds that end on the border of the grid cells)
+    QPoint minIdx, maxIdx;
+    QVector<QPoint> startIdx;
+    _denseCells.reserve(geometries.size());
+    for(Geometry* geom : geometries) {
+        if(geom->getGeometryType() != CellGeometryType)
+            return false;
+        QPointF topLeft       = geom->getBounds().getTopLeft();
+        QPointF bottomRight   = geom->getBounds().getBottomRight();
+        QPoint topLeftIdx     = getGridCellAt(topLeft);
+        QPoint bottomRightIdx = getGridCellAt(bottomRight);
+        int spanX = bottomRightIdx.x() - topLeftIdx.x();
+        int spanY = bottomRightIdx.y() - topLeftIdx.y();
+        if(spanX > 1 || spanY > 1 || topLeft.x() == bottomRight.x() || topLeft.y() == bottomRight.y())
+            return false;
+
+        DenseCell cell;
+        cell.geom  = geom;
+        cell.minX  = topLeft.x();
+        cell.maxX  = bottomRight.x();
+        cell.minY  = topLeft.y();
+        cell.maxY  = bottomRight.y();
+        cell.spans = (spanX ? DenseCell::SpanX : 0) | (spanY ? DenseCell::SpanY : 0);
+        _denseCells.append(cell);
+        startIdx.append(topLeftIdx);
+
+        if(startIdx.size() == 1) {
+            minIdx = maxIdx = topLeftIdx;
+        } else {
+            minIdx = QPoint(qMin(minIdx.x(), topLeftIdx.x()), qMin(minIdx.y(), topLeftIdx.y()));
+            maxIdx = QPoint(qMax(maxIdx.x(), topLeftIdx.x()), qMax(maxIdx.y(), topLeftIdx.y()));
+        }
+    }
+
+    // the grid must not be much larger than the set of cells
+    long long width  = (long long) maxIdx.x() - minIdx.x() + 1;
+    long long height = (long long) maxIdx.y() - minIdx.y() + 1;
+    if(width * height > qMax(8LL * geometries.size(), 1LL << 20))
+        return false;
+
+    _denseOrigin = minIdx;
+    _denseWidth  = (int) width;
+    _denseHeight = (int) height;
+    _denseGrid.fill(-1, _denseWidth * _denseHeight);
+    for(int id = 0; id < _denseCells.size(); ++id) {
+        QPoint idx = startIdx.at(id) - _denseOrigin;
+        int& slot = _denseGrid[idx.y() * _denseWidth + idx.x()];
+        if(slot != -1)
+            return false; // two cells start in the same grid cell
+        slot = id;
+    }
+    return true;
+}
+
+QSet<Geometry*> GeometryIndex::getGeometries() {
+    QSet<Geometry*> geometries;
+    for(int id = 0; id < _kernels.size(); ++id) {
+        geometries.insert(_kernels.getGeometry(id));
+    }
+    return geometries;
 }
 
 const QList<Geometry*>& GeometryIndex::getGrid() {
+    if(_grid.isEmpty() && _rtree) {
+        // the leaves of the R-tree
+        for(const QRectF& bounds : _rtree->getLeafBounds()) {
+            _grid.append(new Cell(bounds));
+        }
+    }
     if(_grid.isEmpty()) {
         for(auto it = _geometryGrid.begin(); it != _geometryGrid.end(); ++it) {
             Geometry* geom = new Cell(it.key().x()*_cellSize, it.key().y()*_cellSize, _cellSize);
@@ -43,47 +160,210 @@ const QList<Geometry*>& GeometryIndex::getGrid() {
     return _grid;
 }
 
-QSet<Geometry*>* GeometryIndex::getGeometriesAt(double x, double y) {
-    QSet<Geometry*>* geometries = new QSet<Geometry*>();
+void GeometryIndex::getGeometriesAt(double x, double y, GeometryBuffer* geometries) const {
+    geometries->clear();
+
+    if(_rtree) {
+        _rtree->search(x, y, [this, x, y, geometries](const RTree::Entry& entry) {
+            if(_kernels.contains(entry.id, x, y))
+                geometries->append(entry.geom);
+        });
+        return;
+    }
 
     // get the corresponding grid cell index of the point p
     QPoint cellIdx = getGridCellAt(x,y);
 
-    // get the set of Geometries at the index
-    QSet<Geometry*>* geoms = _geometryGrid.value(cellIdx);
-//    qDebug() << "point" << x << y << cellIdx << _cellSize << geoms->size() << _geometryGrid.size();
-    if(!geoms) {
-        return nullptr;
+    if(_dense) {
+        // the cells that start in the grid cell or in the previous ones and cover it
+        static const int neighbors[4][3] = {
+                { 0,  0, 0 },
+                {-1,  0, DenseCell::SpanX },
+                { 0, -1, DenseCell::SpanY },
+                {-1, -1, DenseCell::SpanX | DenseCell::SpanY } };
+        for(const auto& neighbor : neighbors) {
+            int id = getDenseCellAt(cellIdx.x() + neighbor[0], cellIdx.y() + neighbor[1]);
+            if(id == -1)
+                continue;
+            const DenseCell& cell = _denseCells.at(id);
+            if((cell.spans & neighbor[2]) != neighbor[2])
+                continue;
+            // same test as Cell::contains (bounds included)
+            if(x >= cell.minX && x <= cell.maxX && y >= cell.minY && y <= cell.maxY)
+                geometries->append(cell.geom);
+        }
+        return;
+    }
+
+    // get the ids of the geometries at the index
+    QVector<int>* ids = _geometryGrid.value(cellIdx);
+//    qDebug() << "point" << x << y << cellIdx << _cellSize << ids->size() << _geometryGrid.size();
+    if(!ids) {
+        return;
     }
 
-    // loop through the geometries to get the resulting set of geometries that contain the point p
-    for(Geometry* geom : *geoms) {
-        if(geom->contains(x,y)) {
-            geometries->insert(geom);
+    // keep the geometries that contain the point p (tested type by type)
+    _kernels.forEachContaining(ids->constData(), ids->size(), x, y, [this, geometries](int id) {
+        geometries->append(_kernels.getGeometry(id));
+    });
+}
+
+void GeometryIndex::getDenseCellsAlong(double x0, double y0, double x1, double y1, QVector<int>* cells) const {
+    cells->clear();
+    if(!_dense)
+        return;
+
+    // grid cells crossed by the segment (Amanatides and Woo, 1987), stepping in x or y toward
+    // the grid cell of the end point, whichever border of the current grid cell is crossed first
+    QPoint idx = getGridCellAt(x0, y0);
+    QPoint end = getGridCellAt(x1, y1);
+    const double inf = std::numeric_limits<double>::infinity();
+    double dx = x1 - x0, dy = y1 - y0;
+    int stepX = dx > 0 ? 1 : -1;
+    int stepY = dy > 0 ? 1 : -1;
+    double tMaxX   = dx != 0 ? ((idx.x() + (dx > 0 ? 1 : 0)) * _cellSize - x0) / dx : inf;
+    double tMaxY   = dy != 0 ? ((idx.y() + (dy > 0 ? 1 : 0)) * _cellSize - y0) / dy : inf;
+    double tDeltaX = dx != 0 ? _cellSize / qAbs(dx) : inf;
+    double tDeltaY = dy != 0 ? _cellSize / qAbs(dy) : inf;
+    int nbSteps = qAbs(end.x() - idx.x()) + qAbs(end.y() - idx.y());
+    for(int step = 0; ; ++step) {
+        // the cells that start in the grid cell or around it: the cells covering the grid cell
+        // and its neighbours (a point on the border of a grid cell may be in the next cells)
+        for(int i = idx.x() - 2; i <= idx.x() + 1; ++i) {
+            for(int j = idx.y() - 2; j <= idx.y() + 1; ++j) {
+                int id = getDenseCellAt(i, j);
+                if(id != -1)
+                    cells->append(id);
+            }
+        }
+        if(step == nbSteps)
+            break;
+        if(idx.x() != end.x() && (idx.y() == end.y() || tMaxX < tMaxY)) {
+            idx.rx() += stepX;
+            tMaxX += tDeltaX;
+        } else {
+            idx.ry() += stepY;
+            tMaxY += tDeltaY;
         }
     }
 
-    return geometries;
+    std::sort(cells->begin(), cells->end());
+    cells->erase(std::unique(cells->begin(), cells->end()), cells->end());
 }
 
-QSet<Geometry*>* GeometryIndex::getGeometriesWithin(double x, double y, double distance) {
-    QSet<Geometry*>* geometries = new QSet<Geometry*>();
+/* Orders the neighbors by distance, then by the position of their center */
+static bool closerThan(const GeometryIndex::Neighbor& a, const GeometryIndex::Neighbor& b) {
+    if(a.distance != b.distance)
+        return a.distance < b.distance;
+    QPointF ca = a.geom->getCenter(), cb = b.geom->getCenter();
+    return ca.x() < cb.x() || (ca.x() == cb.x() && ca.y() < cb.y());
+}
 
-    // get the number of cells covered by distance
-    int n = qCeil(distance / _cellSize);
+void GeometryIndex::addGridCellNeighbors(const QPoint& cellIdx, double x, double y, double distance,
+                                         QVector<Neighbor>* geometries) const {
+    QVector<int>* ids = _geometryGrid.value(cellIdx);
+    if(!ids)
+        return;
+    for(int id : *ids) {
+        Geometry* geom = _kernels.getGeometry(id);
+        QPointF center = geom->getCenter();
+        if(getGridCellAt(center) != cellIdx)
+            continue; // found in the grid cell of its center
+        double dist = euclideanDistance(x, y, center.x(), center.y());
+        if(distance < 0 || std::islessequal(dist, distance))
+            geometries->append({ geom, dist });
+    }
+}
 
-    // get the corresponding grid cell index of the point p
-    QPoint cellIdx = getGridCellAt(x,y);
+void GeometryIndex::getGeometriesWithin(double x, double y, double distance, QVector<Neighbor>* geometries) const {
+    geometries->clear();
+    if(distance < 0)
+        return;
 
-    QPoint topLeftIdx     = getGridCellAt(cellIdx - QPoint(n,n));
-    QPoint bottomRightIdx = getGridCellAt(cellIdx + QPoint(n,n));
-    for(int i = qMax(0,topLeftIdx.x()); i <= bottomRightIdx.x(); ++i) {
-        for(int j = qMax(0,topLeftIdx.y()); j <= bottomRightIdx.y(); ++j) {
-            QPoint idx(i,j);
-            if(_geometryGrid.contains(idx)) {
-                geometries->unite(*(_geometryGrid.value(idx)));
+    if(_rtree) {
+        RTree::Box box = { x - distance, x + distance, y - distance, y + distance };
+        _rtree->search(box, [x, y, distance, geometries](const RTree::Entry& entry) {
+            QPointF center = entry.geom->getCenter();
+            double dist = euclideanDistance(x, y, center.x(), center.y());
+            if(std::islessequal(dist, distance))
+                geometries->append({ entry.geom, dist });
+        });
+    } else {
+        // grid cells that hold the centers within the square around the point
+        QPoint topLeftIdx     = getGridCellAt(x - distance, y - distance);
+        QPoint bottomRightIdx = getGridCellAt(x + distance, y + distance);
+        long long nbCells = ((long long) bottomRightIdx.x() - topLeftIdx.x() + 1) * ((long long) bottomRightIdx.y() - topLeftIdx.y() + 1);
+        if(nbCells > _geometryGrid.size()) {
+            // the square is larger than the grid, go through the occupied grid cells
+            for(auto it = _geometryGrid.begin(); it != _geometryGrid.end(); ++it) {
+                QPoint idx = it.key();
+                if(idx.x() >= topLeftIdx.x() && idx.x() <= bottomRightIdx.x() &&
+                   idx.y() >= topLeftIdx.y() && idx.y() <= bottomRightIdx.y())
+                    addGridCellNeighbors(idx, x, y, distance, geometries);
+            }
+        } else {
+            for(int i = topLeftIdx.x(); i <= bottomRightIdx.x(); ++i) {
+                for(int j = topLeftIdx.y(); j <= bottomRightIdx.y(); ++j) {
+                    addGridCellNeighbors(QPoint(i,j), x, y, distance, geometries);
+                }
             }
         }
     }
-    return geometries;
-}
\ No newline at end of file
+
+    std::sort(geometries->begin(), geometries->end(), closerThan);
+}
+
+void GeometryIndex::getNearestGeometries(double x, double y, int k, QVector<Neighbor>* geometries, double maxDistance) const {
+    geometries->clear();
+    if(k <= 0)
+        return;
+
+    if(_rtree) {
+        // best-first search on the distance to the centers
+        _rtree->nearest(x, y, [x, y](const RTree::Entry& entry) {
+            QPointF center = entry.geom->getCenter();
+            return euclideanDistance(x, y, center.x(), center.y());
+        }, [k, maxDistance, geometries](const RTree::Entry& entry, double dist) {
+            if(maxDistance >= 0 && !std::islessequal(dist, maxDistance))
+                return false;
+            geometries->append({ entry.geom, dist });
+            return geometries->size() < k;
+        });
+        std::sort(geometries->begin(), geometries->end(), closerThan);
+        return;
+    }
+
+    if(_geometryGrid.isEmpty())
+        return;
+
+    // expand the search ring by ring around the grid cell of the point
+    QPoint cellIdx = getGridCellAt(x, y);
+    int maxRing = qMax(qMax(cellIdx.x() - _minGridIdx.x(), _maxGridIdx.x() - cellIdx.x()),
+                       qMax(cellIdx.y() - _minGridIdx.y(), _maxGridIdx.y() - cellIdx.y()));
+    for(int r = 0; r <= maxRing; ++r) {
+        for(int i = -r; i <= r; ++i) {
+            addGridCellNeighbors(cellIdx + QPoint(i, -r), x, y, maxDistance, geometries);
+            if(r > 0)
+                addGridCellNeighbors(cellIdx + QPoint(i, r), x, y, maxDistance, geometries);
+        }
+        for(int j = -r + 1; j <= r - 1; ++j) {
+            addGridCellNeighbors(cellIdx + QPoint(-r, j), x, y, maxDistance, geometries);
+            addGridCellNeighbors(cellIdx + QPoint(r, j), x, y, maxDistance, geometries);
+        }
+
+        // the centers beyond this ring are farther than the border of the rings scanned
+        double border = qMin(qMin(x - (cellIdx.x() - r) * _cellSize, (cellIdx.x() + r + 1) * _cellSize - x),
+                             qMin(y - (cellIdx.y() - r) * _cellSize, (cellIdx.y() + r + 1) * _cellSize - y));
+        if(maxDistance >= 0 && border > maxDistance)
+            break;
+        if(geometries->size() >= k) {
+            std::nth_element(geometries->begin(), geometries->begin() + k - 1, geometries->end(), closerThan);
+            if(geometries->at(k - 1).distance <= border)
+                break;
+        }
+    }
+
+    std::sort(geometries->begin(), geometries->end(), closerThan);
+    if(geometries->size() > k)
+        geometries->resize(k);
+}
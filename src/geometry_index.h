@@ -4,38 +4,128 @@
 #include <QPointF>
 #include <QSet>
 #include <QHash>
+#include <QVarLengthArray>
+#include <QVector>
 #include <qmath.h>
 
+#include "constants.h"
+#include "rtree.h"
+#include "geometry_kernels.h"
+
 // forward class declaration
 class Geometry;
 
 class GeometryIndex {
 public:
-    GeometryIndex(const QSet<Geometry*>& geometries, double cellSize = 100);
-    QSet<Geometry*>* getGeometriesAt(double x, double y);
-    QSet<Geometry*>* getGeometriesAt(QPointF p) {
-        return getGeometriesAt(p.x(), p.y());
+    /* Buffer of the geometries returned by a query, on the stack for up to 16 geometries */
+    typedef QVarLengthArray<Geometry*, 16> GeometryBuffer;
+
+    /* The geometries are bucketed in a grid of "cellSize" (GridIndexType), or packed in an R-tree
+     * (RTreeIndexType) for geometries of very different sizes. Their ids follow the order of the
+     * list within each geometry type (see GeometryKernels) */
+    GeometryIndex(const QList<Geometry*>& geometries, double cellSize = 100, GeometryIndexType indexType = GridIndexType);
+    GeometryIndex(const QSet<Geometry*>& geometries, double cellSize = 100, GeometryIndexType indexType = GridIndexType):
+        GeometryIndex(geometries.toList(), cellSize, indexType) { }
+    ~GeometryIndex();
+    /* Fills "geometries" (cleared first) with the geometries that contain the point (x,y) */
+    void getGeometriesAt(double x, double y, GeometryBuffer* geometries) const;
+    void getGeometriesAt(QPointF p, GeometryBuffer* geometries) const {
+        getGeometriesAt(p.x(), p.y(), geometries);
+    }
+    /* Calls visitor(Geometry*) for each geometry that contains the point (x,y) */
+    template<typename Visitor>
+    void forEachGeometryAt(double x, double y, Visitor visitor) const {
+        GeometryBuffer geometries;
+        getGeometriesAt(x, y, &geometries);
+        for(Geometry* geom : geometries) {
+            visitor(geom);
+        }
     }
     double getCellSize() {
         return _cellSize;
     }
 
-    QSet<Geometry*>* getGeometriesWithin(double x, double y, double distance);
-    QSet<Geometry*>* getGeometriesWithin(QPointF p, double distance) {
-        return getGeometriesWithin(p.x(), p.y(), distance);
+    /* Geometry found by a radius or nearest query, with the distance from its center to the point */
+    struct Neighbor {
+        Geometry* geom;
+        double distance;
+    };
+
+    /* Fills "geometries" with the geometries whose center is within "distance" of the point (x,y),
+     * sorted by distance */
+    void getGeometriesWithin(double x, double y, double distance, QVector<Neighbor>* geometries) const;
+    void getGeometriesWithin(QPointF p, double distance, QVector<Neighbor>* geometries) const {
+        getGeometriesWithin(p.x(), p.y(), distance, geometries);
+    }
+    /* Fills "geometries" with the "k" geometries whose center is the closest to the point (x,y),
+     * sorted by distance (only the geometries within "maxDistance" if it is positive) */
+    void getNearestGeometries(double x, double y, int k, QVector<Neighbor>* geometries, double maxDistance = -1) const;
+    void getNearestGeometries(QPointF p, int k, QVector<Neighbor>* geometries, double maxDistance = -1) const {
+        getNearestGeometries(p.x(), p.y(), k, geometries, maxDistance);
     }
     const QList<Geometry*>& getGrid();
+    /* Returns all the indexed geometries */
+    QSet<Geometry*> getGeometries();
+    /* Number of indexed geometries and geometry of each id (in the order of their ids) */
+    int size() const { return _kernels.size(); }
+    Geometry* getGeometry(int id) const { return _kernels.getGeometry(id); }
+
+    GeometryIndexType getIndexType() const {
+        return _rtree ? RTreeIndexType : GridIndexType;
+    }
+
+    /* True if the point queries use the dense grid (all the geometries are cells aligned on the grid) */
+    bool isDense() const {
+        return _dense;
+    }
+
+    /* Cell geometry of the dense grid, with its bounds */
+    struct DenseCell {
+        enum Span { SpanX = 1, SpanY = 2 }; // the cell also covers the next grid cell in x (resp. y)
+        Geometry* geom;
+        double minX, maxX, minY, maxY;
+        int spans;
+    };
+    const DenseCell& getDenseCell(int id) const {
+        return _denseCells.at(id);
+    }
+    /* Fills "cells" (sorted, each id once) with the ids of the cells of the dense grid that may
+     * contain a point of the segment (x0,y0)-(x1,y1), found with a traversal of the grid cells
+     * crossed by the segment. The cells only touched by the segment are included. */
+    void getDenseCellsAlong(double x0, double y0, double x1, double y1, QVector<int>* cells) const;
 
 private:
+
     double _cellSize;
-    QHash<QPoint,QSet<Geometry*>*> _geometryGrid;
+    GeometryKernels _kernels;       // containment tests of the geometries (by id)
+    QHash<QPoint,QVector<int>*> _geometryGrid; // <grid cell, ids of the geometries (sorted)>
+    QPoint _minGridIdx, _maxGridIdx; // extent of the grid cells of _geometryGrid
     QList<Geometry*> _grid;
+    RTree* _rtree = nullptr;        // replaces the grid buckets with RTreeIndexType
+
+    bool _dense = false;
+    QPoint _denseOrigin;            // index of the first grid cell of the dense grid
+    int _denseWidth  = 0;
+    int _denseHeight = 0;
+    QVector<int> _denseGrid;        // <grid cell, id of the cell geometry that starts in it> (-1 if none)
+    QVector<DenseCell> _denseCells; // <id, cell geometry>
 
     /* private functions */
-    QPoint getGridCellAt(double x, double y) {
+    /* Adds the geometries of the grid cell "cellIdx" whose center lies in the cell (each geometry is
+     * found once) and is within "distance" of the point (x,y) */
+    void addGridCellNeighbors(const QPoint& cellIdx, double x, double y, double distance, QVector<Neighbor>* geometries) const;
+    bool makeDenseGrid(const QList<Geometry*>& geometries);
+    int getDenseCellAt(int i, int j) const {
+        i -= _denseOrigin.x();
+        j -= _denseOrigin.y();
+        if(i < 0 || j < 0 || i >= _denseWidth || j >= _denseHeight)
+            return -1;
+        return _denseGrid.at(j * _denseWidth + i);
+    }
+    QPoint getGridCellAt(double x, double y) const {
         return QPoint(qFloor(x / _cellSize), qFloor(y / _cellSize));
     }
-    QPoint getGridCellAt(QPointF p) {
+    QPoint getGridCellAt(QPointF p) const {
         return getGridCellAt(p.x(), p.y());
     }
 };
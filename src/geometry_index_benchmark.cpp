@@ -0,0 +1,147 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <QDebug>
+#include <random>
+
+#include "geometry_index.h"
+#include "geometries.h"
+#include "shapefile.h"
+#include "loader.h"
+
+
+/* To compile this file and execute the main below, add this file to the CMakeList and remove the main.cpp
+ * Usage: ./LocAll <road links shapefile> [points file] [cell size] [queries]
+ *  -> the road links are buffered by 50 m (as in WazeAlertRoadTraffic::populateAlerts)
+ *  -> the points file (e.g. ../sf-muni-stops.csv, "x;y;radius") gives circles
+ *  -> compares the build time and the point, nearest and radius queries of the grid and of the
+ *     R-tree, and checks that both return the same geometries (and the same as Geometry::contains
+ *     for a sample of the point queries) */
+
+static void benchmark(const QString& name, const QSet<Geometry*>& geometries, double cellSize, int nbQueries) {
+    if(geometries.isEmpty())
+        return;
+
+    // bounds of the geometries (the queries are drawn at random within)
+    double minX = 0, maxX = 0, minY = 0, maxY = 0;
+    bool first = true;
+    for(Geometry* geom : geometries) {
+        QPointF tl = geom->getBounds().getTopLeft();
+        QPointF br = geom->getBounds().getBottomRight();
+        minX = first ? tl.x() : qMin(minX, tl.x()); maxX = first ? br.x() : qMax(maxX, br.x());
+        minY = first ? tl.y() : qMin(minY, tl.y()); maxY = first ? br.y() : qMax(maxY, br.y());
+        first = false;
+    }
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> xDist(minX, maxX), yDist(minY, maxY);
+    QVector<QPointF> queries;
+    for(int i = 0; i < nbQueries; ++i) {
+        queries.append(QPointF(xDist(gen), yDist(gen)));
+    }
+
+    QVector<QSet<Geometry*>> results[2];
+    QVector<QList<Geometry*>> nearestResults[2], withinResults[2]; // sorted by distance
+    const char* types[2] = { "grid  ", "R-tree" };
+    for(int t = 0; t < 2; ++t) {
+        QElapsedTimer timer;
+        timer.start();
+        GeometryIndex index(geometries, cellSize, t == 0 ? GridIndexType : RTreeIndexType);
+        qint64 buildTime = timer.elapsed();
+
+        long long nbResults = 0;
+        GeometryIndex::GeometryBuffer geoms;
+        timer.start();
+        for(const QPointF& p : queries) {
+            index.getGeometriesAt(p, &geoms);
+            nbResults += geoms.size();
+        }
+        qint64 queryTime = timer.elapsed();
+
+        for(const QPointF& p : queries) {
+            QSet<Geometry*> res;
+            index.forEachGeometryAt(p.x(), p.y(), [&res](Geometry* geom) { res.insert(geom); });
+            results[t].append(res);
+        }
+
+        // nearest and radius queries on a sample of the points
+        QVector<GeometryIndex::Neighbor> neighbors;
+        timer.start();
+        for(int i = 0; i < nbQueries; i += 100) {
+            QList<Geometry*> nearest, within;
+            index.getNearestGeometries(queries.at(i), 5, &neighbors);
+            for(const GeometryIndex::Neighbor& n : neighbors) nearest.append(n.geom);
+            index.getGeometriesWithin(queries.at(i), 5 * cellSize, &neighbors);
+            for(const GeometryIndex::Neighbor& n : neighbors) within.append(n.geom);
+            nearestResults[t].append(nearest);
+            withinResults[t].append(within);
+        }
+        qDebug() << name << types[t] << "nearest (k=5) and radius queries" << timer.elapsed() << "ms";
+        qDebug() << name << types[t] << "build" << buildTime << "ms, queries" << queryTime << "ms"
+                 << (queryTime > 0 ? nbQueries / (queryTime / 1000.0) : 0.0) << "queries/s," << nbResults << "results";
+    }
+
+    int mismatches = 0;
+    for(int i = 0; i < nbQueries; ++i) {
+        if(results[0].at(i) != results[1].at(i))
+            mismatches++;
+    }
+    for(int i = 0; i < nbQueries; i += 100) {
+        QSet<Geometry*> res;
+        for(Geometry* geom : geometries) {
+            if(geom->contains(queries.at(i)))
+                res.insert(geom);
+        }
+        if(res != results[0].at(i))
+            mismatches++;
+    }
+    for(int i = 0; i < nearestResults[0].size(); ++i) {
+        if(nearestResults[0].at(i) != nearestResults[1].at(i) || withinResults[0].at(i) != withinResults[1].at(i))
+            mismatches++;
+    }
+    qDebug() << (mismatches == 0 ? "[OK]" : "[FAILED]") << name << mismatches << "queries with different results";
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    if(argc < 2) {
+        qDebug() << "Usage:" << argv[0] << "<road links shapefile> [points file] [cell size] [queries]";
+        return 1;
+    }
+    double cellSize = (argc > 3) ? QString(argv[3]).toDouble() : 100;
+    int nbQueries = (argc > 4) ? QString(argv[4]).toInt() : 1000000;
+
+    // buffered road links
+    Loader loader;
+    Shapefile shapefile(argv[1]);
+    if(!shapefile.open(&loader))
+        return 1;
+    QSet<Geometry*> roadLinks;
+    QHash<int, ShapefileFeature*>* features = shapefile.getFeatures();
+    for(auto it = features->begin(); it != features->end(); ++it) {
+        OGRGeometry* geom = it.value()->ogrGeometry;
+        if(geom->getGeometryType() == wkbLineString) {
+            Geometry* buffer = OGRGeometryToGeometry(((OGRLineString*) geom)->Buffer(50));
+            if(buffer)
+                roadLinks.insert(buffer);
+        }
+    }
+    benchmark("road links", roadLinks, cellSize, nbQueries);
+
+    // circles of the points file
+    if(argc > 2) {
+        QFile file(argv[2]);
+        if(!file.open(QFile::ReadOnly | QFile::Text))
+            return 1;
+        QSet<Geometry*> circles;
+        while(!file.atEnd()) {
+            QStringList fields = QString(file.readLine()).trimmed().split(";");
+            if(fields.size() < 3)
+                continue;
+            circles.insert(new Circle(fields.at(0).toDouble(), fields.at(1).toDouble(), fields.at(2).toDouble()));
+        }
+        benchmark("points", circles, cellSize, nbQueries);
+    }
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+//
+// Point-in-geometry tests on flat arrays, partitioned by geometry type
+//
+
+#include "geometry_kernels.h"
+
+#include <limits>
+
+#include "geometries.h"
+
+static const double INF = std::numeric_limits<double>::infinity();
+
+GeometryKernels::GeometryKernels(const QList<Geometry*>& geometries) {
+    // ids grouped by type
+    QVector<Geometry*> cells, circles, polygons, others;
+    for(Geometry* geom : geometries) {
+        switch(geom->getGeometryType()) {
+            case CellGeometryType:    cells.append(geom); break;
+            case CircleGeometryType:  circles.append(geom); break;
+            case PolygonGeometryType: polygons.append(geom); break;
+            case PathGeometryType:    polygons.append(geom); break;
+            default:                  others.append(geom); break;
+        }
+    }
+
+    // cells, with the test of QRectF::contains (no point in an empty rectangle)
+    for(Geometry* geom : cells) {
+        Cell* cell = static_cast<Cell*>(geom);
+        double l = qMin(cell->left(), cell->right()), r = qMax(cell->left(), cell->right());
+        double t = qMin(cell->top(), cell->bottom()), b = qMax(cell->top(), cell->bottom());
+        if(l == r || t == b) {
+            l = t = INF;
+            r = b = -INF;
+        }
+        _cellMinX.append(l); _cellMaxX.append(r);
+        _cellMinY.append(t); _cellMaxY.append(b);
+        _geometries.append(geom);
+    }
+
+    _circlesBegin = _geometries.size();
+    for(Geometry* geom : circles) {
+        Circle* circle = static_cast<Circle*>(geom);
+        _circleX.append(circle->getCenter().x());
+        _circleY.append(circle->getCenter().y());
+        _circleRadius.append(circle->getRadius());
+        _geometries.append(geom);
+    }
+
+    // polygons, then the paths made of lines (the others are tested with Geometry::contains)
+    _polygonsBegin = _geometries.size();
+    _polygonEdges.append(0);
+    QVector<Geometry*> curves;
+    for(Geometry* geom : polygons) {
+        if(geom->getGeometryType() == PathGeometryType) {
+            if(!addPath(geom))
+                curves.append(geom);
+            continue;
+        }
+
+        // QPolygonF::containsPoint: edges between the points, closed if the last point is not the first
+        Polygon* polygon = static_cast<Polygon*>(geom);
+        double minY = INF, maxY = -INF;
+        for(int i = 0; i < polygon->size(); ++i) {
+            minY = qMin(minY, polygon->at(i).y());
+            maxY = qMax(maxY, polygon->at(i).y());
+            if(i > 0)
+                addEdge(polygon->at(i-1).x(), polygon->at(i-1).y(), polygon->at(i).x(), polygon->at(i).y());
+        }
+        if(!polygon->isEmpty() && polygon->last() != polygon->first())
+            addEdge(polygon->last().x(), polygon->last().y(), polygon->first().x(), polygon->first().y());
+
+        // no edge crosses the lines above and below the points
+        _polygonMinX.append(-INF); _polygonMaxX.append(INF);
+        _polygonMinY.append(minY); _polygonMaxY.append(maxY);
+        _polygonOddEven.append(false);
+        _polygonEdges.append(_edgeX1.size());
+        _geometries.append(geom);
+    }
+
+    _othersBegin = _geometries.size();
+    _geometries += curves;
+    _geometries += others;
+}
+
+void GeometryKernels::addEdge(double x1, double y1, double x2, double y2) {
+    // same as the intersection of the edges in QPolygonF and QPainterPath
+    if(qFuzzyCompare(y1, y2))
+        return; // horizontal edges are ignored (scan conversion rule)
+    int dir = 1;
+    if(y2 < y1) {
+        qSwap(x1, x2);
+        qSwap(y1, y2);
+        dir = -1;
+    }
+    _edgeX1.append(x1);
+    _edgeY1.append(y1);
+    _edgeY2.append(y2);
+    _edgeSlope.append((x2 - x1) / (y2 - y1));
+    _edgeDir.append(dir);
+}
+
+bool GeometryKernels::addPath(Geometry* geom) {
+    Path* path = static_cast<Path*>(geom);
+    for(int i = 0; i < path->elementCount(); ++i) {
+        if(path->elementAt(i).isCurveTo())
+            return false;
+    }
+
+    // QPainterPath::contains: each subpath is closed implicitly
+    int firstEdge = _edgeX1.size();
+    QPointF last, start;
+    for(int i = 0; i < path->elementCount(); ++i) {
+        QPainterPath::Element e = path->elementAt(i);
+        if(e.isMoveTo()) {
+            if(i > 0)
+                addEdge(last.x(), last.y(), start.x(), start.y());
+            start = last = e;
+        } else {
+            addEdge(last.x(), last.y(), e.x, e.y);
+            last = e;
+        }
+    }
+    if(last != start)
+        addEdge(last.x(), last.y(), start.x(), start.y());
+
+    // only the points in the control point rectangle (as QRectF::contains) are tested
+    QRectF rect = path->controlPointRect();
+    if(path->isEmpty() || rect.left() == rect.right() || rect.top() == rect.bottom()) {
+        _edgeX1.resize(firstEdge); _edgeY1.resize(firstEdge); _edgeY2.resize(firstEdge);
+        _edgeSlope.resize(firstEdge); _edgeDir.resize(firstEdge);
+        _polygonMinX.append(INF); _polygonMaxX.append(-INF);
+        _polygonMinY.append(INF); _polygonMaxY.append(-INF);
+    } else {
+        _polygonMinX.append(rect.left()); _polygonMaxX.append(rect.right());
+        _polygonMinY.append(rect.top());  _polygonMaxY.append(rect.bottom());
+    }
+    _polygonOddEven.append(path->fillRule() == Qt::OddEvenFill);
+    _polygonEdges.append(_edgeX1.size());
+    _geometries.append(geom);
+    return true;
+}
+
+bool GeometryKernels::otherContains(int id, double x, double y) const {
+    return _geometries.at(id)->contains(x, y);
+}
+
+void GeometryKernels::containsPoints(int id, int count, const double* xs, const double* ys, bool* inside) const {
+    if(id < _circlesBegin) {
+        double minX = _cellMinX[id], maxX = _cellMaxX[id], minY = _cellMinY[id], maxY = _cellMaxY[id];
+        for(int i = 0; i < count; ++i) {
+            inside[i] = xs[i] >= minX && xs[i] <= maxX && ys[i] >= minY && ys[i] <= maxY;
+        }
+    } else if(id < _polygonsBegin) {
+        int c = id - _circlesBegin;
+        double cx = _circleX[c], cy = _circleY[c], radius = _circleRadius[c];
+        for(int i = 0; i < count; ++i) {
+            double dx = xs[i] - cx, dy = ys[i] - cy;
+            inside[i] = std::islessequal(std::sqrt(dx * dx + dy * dy), radius);
+        }
+    } else if(id < _othersBegin) {
+        int p = id - _polygonsBegin;
+        for(int i = 0; i < count; ++i) {
+            inside[i] = polygonContains(p, xs[i], ys[i]);
+        }
+    } else {
+        for(int i = 0; i < count; ++i) {
+            inside[i] = otherContains(id, xs[i], ys[i]);
+        }
+    }
+}
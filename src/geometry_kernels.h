@@ -0,0 +1,115 @@
+//
+// Point-in-geometry tests on flat arrays, partitioned by geometry type
+//
+
+#ifndef LOCALL_GEOMETRY_KERNELS_H
+#define LOCALL_GEOMETRY_KERNELS_H
+
+#include <QVector>
+#include <QList>
+#include <cmath>
+
+// forward class declaration
+class Geometry;
+
+/* Copy of a set of geometries in per-type arrays: the cells as min/max boxes, the circles as
+ * center and radius, the polygons (and the paths made of lines) as flat lists of edges. The
+ * geometries get ids grouped by type (cells, circles, polygons, then the others) and in the order
+ * of the list within a type (the paths with curves go first among the others), so a list of
+ * ids sorted by id is tested type by type without going through the virtual Geometry::contains.
+ * Each test gives the same result as Geometry::contains (bounds included, same edge rule as
+ * QPolygonF::containsPoint and QPainterPath::contains); the other geometries (coordinates, paths
+ * with curves) fall back to Geometry::contains. */
+class GeometryKernels {
+public:
+    GeometryKernels() { }
+    explicit GeometryKernels(const QList<Geometry*>& geometries);
+
+    int size() const { return _geometries.size(); }
+    Geometry* getGeometry(int id) const { return _geometries.at(id); }
+
+    /* True if the geometry "id" contains the point (x,y) */
+    bool contains(int id, double x, double y) const {
+        if(id < _circlesBegin)
+            return cellContains(id, x, y);
+        if(id < _polygonsBegin)
+            return circleContains(id - _circlesBegin, x, y);
+        if(id < _othersBegin)
+            return polygonContains(id - _polygonsBegin, x, y);
+        return otherContains(id, x, y);
+    }
+
+    /* Calls visitor(int id) for each of the "count" geometries "ids" (sorted by id) that contains
+     * the point (x,y) (one point against many geometries) */
+    template<typename Visitor>
+    void forEachContaining(const int* ids, int count, double x, double y, Visitor visitor) const {
+        int i = 0;
+        for(; i < count && ids[i] < _circlesBegin; ++i) {
+            if(cellContains(ids[i], x, y))
+                visitor(ids[i]);
+        }
+        for(; i < count && ids[i] < _polygonsBegin; ++i) {
+            if(circleContains(ids[i] - _circlesBegin, x, y))
+                visitor(ids[i]);
+        }
+        for(; i < count && ids[i] < _othersBegin; ++i) {
+            if(polygonContains(ids[i] - _polygonsBegin, x, y))
+                visitor(ids[i]);
+        }
+        for(; i < count; ++i) {
+            if(otherContains(ids[i], x, y))
+                visitor(ids[i]);
+        }
+    }
+
+    /* Sets inside[i] to true if the geometry "id" contains the point (xs[i], ys[i]), for the
+     * "count" points (many points against one geometry) */
+    void containsPoints(int id, int count, const double* xs, const double* ys, bool* inside) const;
+
+private:
+    QVector<Geometry*> _geometries;     // <id, geometry>
+    int _circlesBegin  = 0;             // first id of each type (the cells start at 0)
+    int _polygonsBegin = 0;
+    int _othersBegin   = 0;
+
+    // cells (id), the degenerate cells have an empty box
+    QVector<double> _cellMinX, _cellMaxX, _cellMinY, _cellMaxY;
+
+    // circles (id - _circlesBegin)
+    QVector<double> _circleX, _circleY, _circleRadius;
+
+    // polygons (id - _polygonsBegin): the edges of polygon p are [_polygonEdges[p], _polygonEdges[p+1])
+    // and the points outside its box are outside the polygon
+    QVector<int> _polygonEdges;
+    QVector<double> _polygonMinX, _polygonMaxX, _polygonMinY, _polygonMaxY;
+    QVector<bool> _polygonOddEven;      // odd-even fill rule (winding otherwise)
+
+    // edges, oriented upwards (y1 < y2), the horizontal edges are not kept
+    QVector<double> _edgeX1, _edgeY1, _edgeY2, _edgeSlope;
+    QVector<int> _edgeDir;              // +1 if the edge was oriented upwards, -1 otherwise
+
+    void addEdge(double x1, double y1, double x2, double y2);
+    bool addPath(Geometry* geom);
+
+    bool cellContains(int c, double x, double y) const {
+        return x >= _cellMinX[c] && x <= _cellMaxX[c] && y >= _cellMinY[c] && y <= _cellMaxY[c];
+    }
+    bool circleContains(int c, double x, double y) const {
+        double dx = x - _circleX[c], dy = y - _circleY[c];
+        // distance compared as in Circle::contains (not squared), so the boundary is the same
+        return std::islessequal(std::sqrt(dx * dx + dy * dy), _circleRadius[c]);
+    }
+    bool polygonContains(int p, double x, double y) const {
+        if(!(x >= _polygonMinX[p] && x <= _polygonMaxX[p] && y >= _polygonMinY[p] && y <= _polygonMaxY[p]))
+            return false;
+        int winding = 0;
+        for(int e = _polygonEdges[p]; e < _polygonEdges[p+1]; ++e) {
+            double ex = _edgeX1[e] + _edgeSlope[e] * (y - _edgeY1[e]);
+            winding += (y >= _edgeY1[e] && y < _edgeY2[e] && ex <= x) ? _edgeDir[e] : 0;
+        }
+        return _polygonOddEven[p] ? (winding % 2) != 0 : winding != 0;
+    }
+    bool otherContains(int id, double x, double y) const;
+};
+
+#endif //LOCALL_GEOMETRY_KERNELS_H
@@ -0,0 +1,131 @@
+//
+// Local Getis-Ord G* statistic (hot spots) of a set of positions
+//
+
+#include "getis_ord.h"
+
+#include <QtConcurrent>
+#include <QtMath>
+#include <cmath>
+#include <limits>
+
+#include "geometries.h"
+
+// distance beyond which the inverse distance weight is zero (with some margin over 0.99)
+static const double INVERSE_DISTANCE_CUTOFF = 1.0;
+
+GetisOrd::GetisOrd(const QVector<QPointF>& positions, const QVector<double>& values,
+                   GetisOrdWeights weights, double parameter):
+        _positions(positions),
+        _values(values),
+        _weights(weights),
+        _parameter(parameter) {
+
+    QVector<RTree::Entry> entries;
+    entries.reserve(_positions.size());
+    for(int i = 0; i < _positions.size(); ++i) {
+        const QPointF& p = _positions.at(i);
+        entries.append({ { p.x(), p.x(), p.y(), p.y() }, nullptr, i });
+    }
+    _rtree = new RTree(entries);
+}
+
+GetisOrd::~GetisOrd() {
+    delete _rtree;
+}
+
+void GetisOrd::getNeighbors(int i, QVector<int>* neighbors, QVector<double>* distances) const {
+    neighbors->clear();
+    distances->clear();
+    double x = _positions.at(i).x(), y = _positions.at(i).y();
+    auto distance = [this, x, y](const RTree::Entry& entry) {
+        const QPointF& p = _positions.at(entry.id);
+        return euclideanDistance(x, y, p.x(), p.y());
+    };
+
+    if(_weights == KNearestWeights) {
+        int k = (int) _parameter;
+        if(k <= 0)
+            return;
+        _rtree->nearest(x, y, distance, [k, neighbors, distances](const RTree::Entry& entry, double dist) {
+            neighbors->append(entry.id);
+            distances->append(dist);
+            return neighbors->size() < k;
+        });
+        return;
+    }
+
+    double radius = _weights == FixedBandWeights ? _parameter : INVERSE_DISTANCE_CUTOFF;
+    RTree::Box box = { x - radius, x + radius, y - radius, y + radius };
+    _rtree->search(box, [&](const RTree::Entry& entry) {
+        double dist = distance(entry);
+        if(std::islessequal(dist, radius)) {
+            neighbors->append(entry.id);
+            distances->append(dist);
+        }
+    });
+}
+
+void GetisOrd::compute(QVector<double>* zScores, QVector<double>* pValues) const {
+    int n = _positions.size();
+    zScores->fill(std::numeric_limits<double>::quiet_NaN(), n);
+    if(pValues)
+        pValues->fill(std::numeric_limits<double>::quiet_NaN(), n);
+    if(n == 0)
+        return;
+
+    // global sums (mean and standard deviation of the values)
+    qreal sum4 = 0.0, sum5 = 0.0;
+    for(double x : _values) {
+        sum4 += x;
+        sum5 += qPow(x,2);
+    }
+    qreal mean = sum4 / n;
+    qreal S = qSqrt(sum5 / n - qPow(mean, 2));
+
+    // local sums of each position over its neighbors (itself included), the weights of the
+    // neighbors are evaluated in a batch
+    QVector<int> ids(n);
+    for(int i = 0; i < n; ++i) ids[i] = i;
+    double* z = zScores->data();
+    double* p = pValues ? pValues->data() : nullptr;
+    QtConcurrent::blockingMap(ids, [&](int i) {
+        QVector<int> neighbors;
+        QVector<double> distances;
+        getNeighbors(i, &neighbors, &distances);
+        int nbNeighbors = neighbors.size();
+        QVector<double> weights(nbNeighbors);
+        const double* d = distances.constData();
+        double* w = weights.data();
+        if(_weights == InverseDistanceWeights) {
+            for(int j = 0; j < nbNeighbors; ++j)
+                w[j] = (int) (1.0 / (0.01 + d[j]));
+        } else {
+            for(int j = 0; j < nbNeighbors; ++j)
+                w[j] = 1.0;
+        }
+
+        qreal sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+        for(int j = 0; j < nbNeighbors; ++j) {
+            sum1 += w[j] * _values.at(neighbors.at(j));
+            sum2 += w[j];
+            sum3 += w[j] * w[j];
+        }
+        double zScore = (sum1 - mean * sum2) / (S * qSqrt((n * sum3 - qPow(sum2,2)) / (n-1)));
+        z[i] = zScore;
+        if(p)
+            p[i] = pValue(zScore);
+    });
+}
+
+double GetisOrd::pValue(double zScore) {
+    return std::erfc(qAbs(zScore) / M_SQRT2);
+}
+
+QColor GetisOrd::selectColor(double zScore) {
+    if(zScore >= 3.291) return QColor("#720206");
+    else if(zScore >= 2.576) return QColor("#f33f1c");
+    else if(zScore >= 1.960) return QColor("#f37b22");
+    else if(zScore >= 1.645) return QColor("#fffe38");
+    else return QColor("#cccccc");
+}
@@ -0,0 +1,49 @@
+//
+// Local Getis-Ord G* statistic (hot spots) of a set of positions
+//
+
+#ifndef LOCALL_GETIS_ORD_H
+#define LOCALL_GETIS_ORD_H
+
+#include <QVector>
+#include <QPointF>
+#include <QColor>
+
+#include "constants.h"
+#include "rtree.h"
+
+/* Local Getis-Ord G* statistic (z-score and p-value) of each position, from a value per position
+ * (e.g. the number of visits of a cell). The mean and the standard deviation of the values are
+ * computed once, then the weighted sums of each position only go through its neighbors (from an
+ * R-tree of the positions), the positions in parallel. The spatial weights are
+ *  -> InverseDistanceWeights: (int) (1 / (0.01 + d)), with d the distance between the positions, zero
+ *     beyond a distance of 0.99 (the neighbors are within this cutoff)
+ *  -> FixedBandWeights: 1 within the distance "parameter", 0 beyond
+ *  -> KNearestWeights: 1 for the "parameter" nearest positions (the position itself included), 0 for
+ *     the others */
+class GetisOrd {
+public:
+    GetisOrd(const QVector<QPointF>& positions, const QVector<double>& values,
+             GetisOrdWeights weights = InverseDistanceWeights, double parameter = 0.0);
+    ~GetisOrd();
+
+    /* Fills "zScores" (and "pValues") with the z-score (and the two-sided p-value) of each position */
+    void compute(QVector<double>* zScores, QVector<double>* pValues = nullptr) const;
+
+    /* Two-sided p-value of a z-score (standard normal distribution) */
+    static double pValue(double zScore);
+    /* Color of a z-score (hot spots at the 90%, 95%, 99% and 99.9% confidence levels) */
+    static QColor selectColor(double zScore);
+
+private:
+    QVector<QPointF> _positions;
+    QVector<double> _values;
+    GetisOrdWeights _weights;
+    double _parameter;
+    RTree* _rtree = nullptr;
+
+    /* Fills "neighbors" and "distances" with the neighbors (position ids) of the position "i" */
+    void getNeighbors(int i, QVector<int>* neighbors, QVector<double>* distances) const;
+};
+
+#endif //LOCALL_GETIS_ORD_H
@@ -103,14 +103,19 @@ void GTFSTrace::parseTrips(Loader* loader) {
 
     // get all the stops
     _stops = QMap<QString, Stop*>();
+    QVector<QPointF> stopCoords; // (lon, lat) of the stops, projected at once
+    foreach (auto stop, stopList) {
+        stopCoords.append(QPointF(stop.value("stop_lon").toDouble(), stop.value("stop_lat").toDouble()));
+    }
+    if(!stopCoords.isEmpty())
+        ProjFactory::getInstance().transformCoordinates(stopCoords.size(), &stopCoords[0].rx(), &stopCoords[0].ry(), 2);
+    int stopIdx = 0;
     foreach (auto stop, stopList) {
         QString stopId   = stop.value("stop_id");
         QString stopName = stop.value("stop_name");
-        double lat       = stop.value("stop_lat").toDouble();
-        double lon       = stop.value("stop_lon").toDouble();
-        double x, y;
-        ProjFactory::getInstance().transformCoordinates(lat, lon, &x, &y);
-        QPointF coord(x, y);
+        QPointF coord    = stopCoords.at(stopIdx++);
+        double x = coord.x();
+        double y = coord.y();
 
         if(x < 500 || y < 500) {
             continue;
@@ -127,18 +132,23 @@ void GTFSTrace::parseTrips(Loader* loader) {
     QMap<QString, geos::geom::LineString*> geomShapes;
     if(_snapToShape) {
         geos::geom::GeometryFactory* global_factory = new geos::geom::GeometryFactory();
+        QVector<QPointF> shapeCoords; // (lon, lat) of the waypoints of the shapes kept, projected at once
+        foreach(auto waypoint, shapesList) {
+            if(okShapes.contains(waypoint.value("shape_id")))
+                shapeCoords.append(QPointF(waypoint.value("shape_pt_lon").toDouble(),
+                                           waypoint.value("shape_pt_lat").toDouble()));
+        }
+        if(!shapeCoords.isEmpty())
+            ProjFactory::getInstance().transformCoordinates(shapeCoords.size(), &shapeCoords[0].rx(), &shapeCoords[0].ry(), 2);
+        int shapeIdx = 0;
         foreach(auto waypoint, shapesList) {
             QString shapeId = waypoint.value("shape_id");
-            double lat      = waypoint.value("shape_pt_lat").toDouble();
-            double lon      = waypoint.value("shape_pt_lon").toDouble();
             int seq         = waypoint.value("shape_pt_sequence").toInt();
 
             if(!okShapes.contains(shapeId))
                 continue;
 
-            double x, y;
-            ProjFactory::getInstance().transformCoordinates(lat, lon, &x, &y);
-            QPointF coord(x, y);
+            QPointF coord = shapeCoords.at(shapeIdx++);
 
             if(!_shapes.contains(shapeId)) {
                 // instantiate a new point sequence
@@ -299,7 +309,7 @@ bool GTFSTrace::openTrace(Loader* loader) {
 //        if(id > 1000) break;
     }
 
-    qDebug() << "[DONE] Added" << _nodes.size() << "nodes";
+    qDebug() << "[DONE] Added" << getNbNodes() << "nodes";
     loader->loadProgressChanged((qreal) 1.0, "Done");
 
     return true;
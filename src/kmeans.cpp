@@ -0,0 +1,205 @@
+//
+// Mini-batch k-means of a set of points, seeded with k-means++
+//
+
+#include "kmeans.h"
+
+#include <QtConcurrent>
+#include <QtMath>
+#include <limits>
+
+#ifdef LOCALL_SIMD_KMEANS
+#define LOCALL_SIMD_LOOP _Pragma("omp simd")
+#else
+#define LOCALL_SIMD_LOOP
+#endif
+
+static const double INF = std::numeric_limits<double>::infinity();
+static const int BLOCK_SIZE = 1024; // points compared to the centroids at once (the buffers stay in cache)
+
+KMeans::KMeans(const QVector<double>& xs, const QVector<double>& ys, QThreadPool* pool):
+        _xs(xs),
+        _ys(ys),
+        _pool(pool ? pool : QThreadPool::globalInstance()) { }
+
+void KMeans::assign(const double* xs, const double* ys, int count, const double* cxs, const double* cys, int k,
+                    int* labels, double* dists) {
+    for(int i = 0; i < count; ++i) {
+        labels[i] = 0;
+        dists[i] = INF;
+    }
+    for(int c = 0; c < k; ++c) {
+        double cx = cxs[c], cy = cys[c];
+        LOCALL_SIMD_LOOP
+        for(int i = 0; i < count; ++i) {
+            double dx = xs[i] - cx, dy = ys[i] - cy;
+            double d = dx * dx + dy * dy;
+            bool closer = d < dists[i];
+            dists[i] = closer ? d : dists[i];
+            labels[i] = closer ? c : labels[i];
+        }
+    }
+}
+
+bool KMeans::compute(int k, int batchSize, int maxIterations, double tolerance, unsigned seed) {
+    _cxs.clear();
+    _cys.clear();
+    _sizes.clear();
+    _inertia = 0.0;
+    _nbIterations = 0;
+    int n = _xs.size();
+    if(n == 0 || k <= 0)
+        return false;
+    k = qMin(k, n);
+
+    std::mt19937 gen(seed);
+    this->seed(k, &gen);
+
+    // mini-batches: each centroid moves towards the points of the batch assigned to it, with a
+    // learning rate of 1 / (number of points assigned to the centroid so far)
+    int b = qMin(batchSize, n);
+    QVector<double> bxs(b), bys(b), dists(b);
+    QVector<int> labels(b);
+    QVector<long long> counts(k, 0);
+    std::uniform_int_distribution<int> pick(0, n - 1);
+    for(int it = 0; it < maxIterations; ++it) {
+        for(int j = 0; j < b; ++j) {
+            int i = pick(gen);
+            bxs[j] = _xs.at(i);
+            bys[j] = _ys.at(i);
+        }
+        assign(bxs.constData(), bys.constData(), b, _cxs.constData(), _cys.constData(), k,
+               labels.data(), dists.data());
+
+        QVector<double> prevXs = _cxs, prevYs = _cys;
+        for(int j = 0; j < b; ++j) {
+            int c = labels.at(j);
+            counts[c]++;
+            double eta = 1.0 / counts.at(c);
+            _cxs[c] += eta * (bxs.at(j) - _cxs.at(c));
+            _cys[c] += eta * (bys.at(j) - _cys.at(c));
+        }
+        _nbIterations++;
+
+        double shift = 0.0;
+        for(int c = 0; c < k; ++c) {
+            shift = qMax(shift, qSqrt(qPow(_cxs.at(c) - prevXs.at(c), 2) + qPow(_cys.at(c) - prevYs.at(c), 2)));
+        }
+        if(shift < tolerance)
+            break;
+    }
+
+    assignAll();
+    return true;
+}
+
+void KMeans::seed(int k, std::mt19937* gen) {
+    // sample of the points (all of them if there are few)
+    int n = _xs.size();
+    QVector<double> sxs, sys;
+    if(n <= KMEANS_SEEDING_SAMPLE) {
+        sxs = _xs;
+        sys = _ys;
+    } else {
+        std::uniform_int_distribution<int> pick(0, n - 1);
+        for(int j = 0; j < KMEANS_SEEDING_SAMPLE; ++j) {
+            int i = pick(*gen);
+            sxs.append(_xs.at(i));
+            sys.append(_ys.at(i));
+        }
+    }
+    int s = sxs.size();
+
+    // k-means++: the first centroid at random, the next ones drawn with a probability proportional
+    // to the squared distance to the closest centroid
+    QVector<double> minDists(s, INF), dists(s);
+    QVector<int> labels(s);
+    int next = std::uniform_int_distribution<int>(0, s - 1)(*gen);
+    for(int c = 0; c < k; ++c) {
+        _cxs.append(sxs.at(next));
+        _cys.append(sys.at(next));
+        if(c == k - 1)
+            break;
+
+        assign(sxs.constData(), sys.constData(), s, &_cxs.last(), &_cys.last(), 1, labels.data(), dists.data());
+        double sum = 0.0;
+        for(int i = 0; i < s; ++i) {
+            minDists[i] = qMin(minDists.at(i), dists.at(i));
+            sum += minDists.at(i);
+        }
+        if(sum <= 0.0) { // fewer distinct points than centroids
+            next = std::uniform_int_distribution<int>(0, s - 1)(*gen);
+            continue;
+        }
+        double r = std::uniform_real_distribution<double>(0.0, sum)(*gen);
+        next = s - 1;
+        for(int i = 0; i < s; ++i) {
+            r -= minDists.at(i);
+            if(r < 0.0 && minDists.at(i) > 0.0) {
+                next = i;
+                break;
+            }
+        }
+    }
+}
+
+void KMeans::assignAll() {
+    int n = _xs.size();
+    int k = _cxs.size();
+
+    // contiguous chunks of points (a few per thread to balance the load), each with its own sums
+    int nbChunks = qMax(1, qMin(n, 4 * _pool->maxThreadCount()));
+    int chunkSize = qCeil((double) n / nbChunks);
+    nbChunks = qCeil((double) n / chunkSize);
+    QVector<QVector<double>> sumXs(nbChunks, QVector<double>(k, 0.0)), sumYs(nbChunks, QVector<double>(k, 0.0));
+    QVector<QVector<long long>> counts(nbChunks, QVector<long long>(k, 0));
+    QVector<double> inertias(nbChunks, 0.0);
+
+    QList<QFuture<void>> futures;
+    for(int t = 0; t < nbChunks; ++t) {
+        futures.append(QtConcurrent::run(_pool, [&, t]() {
+            int begin = t * chunkSize, end = qMin(begin + chunkSize, n);
+            double* sumX = sumXs[t].data();
+            double* sumY = sumYs[t].data();
+            long long* count = counts[t].data();
+            int labels[BLOCK_SIZE];
+            double dists[BLOCK_SIZE];
+            double inertia = 0.0;
+            for(int first = begin; first < end; first += BLOCK_SIZE) {
+                int size = qMin(BLOCK_SIZE, end - first);
+                const double* xs = _xs.constData() + first;
+                const double* ys = _ys.constData() + first;
+                assign(xs, ys, size, _cxs.constData(), _cys.constData(), k, labels, dists);
+                for(int i = 0; i < size; ++i) {
+                    sumX[labels[i]] += xs[i];
+                    sumY[labels[i]] += ys[i];
+                    count[labels[i]]++;
+                    inertia += dists[i];
+                }
+            }
+            inertias[t] = inertia;
+        }));
+    }
+    for(QFuture<void>& future : futures) {
+        future.waitForFinished();
+    }
+
+    // the centroids move to the mean of their points (in the order of the chunks)
+    _sizes.fill(0, k);
+    _inertia = 0.0;
+    for(int c = 0; c < k; ++c) {
+        double sumX = 0.0, sumY = 0.0;
+        for(int t = 0; t < nbChunks; ++t) {
+            sumX += sumXs.at(t).at(c);
+            sumY += sumYs.at(t).at(c);
+            _sizes[c] += counts.at(t).at(c);
+        }
+        if(_sizes.at(c) > 0) {
+            _cxs[c] = sumX / _sizes.at(c);
+            _cys[c] = sumY / _sizes.at(c);
+        }
+    }
+    for(double inertia : inertias) {
+        _inertia += inertia;
+    }
+}
@@ -0,0 +1,58 @@
+//
+// Mini-batch k-means of a set of points, seeded with k-means++
+//
+
+#ifndef LOCALL_KMEANS_H
+#define LOCALL_KMEANS_H
+
+#include <QVector>
+#include <QThreadPool>
+#include <random>
+
+#include "constants.h"
+
+/* k-means of the points (xs[i], ys[i]) (e.g. the projected positions of a trace). The centroids are
+ * seeded with k-means++ (Arthur and Vassilvitskii, 2007) on a sample of the points, then moved by
+ * mini-batches of points drawn at random (Sculley, 2010), each centroid by the mean of the points it
+ * was assigned so far, so one iteration does not depend on the number of points. A last pass assigns
+ * all the points on the threads of the pool and moves each centroid to the mean of its points.
+ * The assignments compare a block of points to one centroid at a time (vectorized loop). */
+class KMeans {
+public:
+    KMeans(const QVector<double>& xs, const QVector<double>& ys, QThreadPool* pool = nullptr);
+
+    /* Computes "k" centroids (fewer if there are fewer points), the batches stop after "maxIterations"
+     * or when no centroid moved more than "tolerance" during a batch. Returns false without points */
+    bool compute(int k, int batchSize = KMEANS_BATCH_SIZE, int maxIterations = KMEANS_MAX_ITERATIONS,
+                 double tolerance = KMEANS_TOLERANCE, unsigned seed = 1);
+
+    int getNbCentroids() const { return _cxs.size(); }
+    double getCentroidX(int c) const { return _cxs.at(c); }
+    double getCentroidY(int c) const { return _cys.at(c); }
+    /* Number of points assigned to the centroid c by the last pass */
+    long long getSize(int c) const { return _sizes.at(c); }
+    /* Sum of the squared distances of the points to their centroid in the last pass */
+    double getInertia() const { return _inertia; }
+    int getNbIterations() const { return _nbIterations; }
+
+    /* Sets labels[i] and dists[i] to the closest of the "k" centroids (cxs, cys) of the point
+     * (xs[i], ys[i]) and to its squared distance, for the "count" points (ties go to the lowest centroid) */
+    static void assign(const double* xs, const double* ys, int count, const double* cxs, const double* cys, int k,
+                       int* labels, double* dists);
+
+private:
+    const QVector<double>& _xs;
+    const QVector<double>& _ys;
+    QThreadPool* _pool;
+
+    QVector<double> _cxs, _cys;   // <centroid, coordinates>
+    QVector<long long> _sizes;    // <centroid, number of points>
+    double _inertia = 0.0;
+    int _nbIterations = 0;
+
+    void seed(int k, std::mt19937* gen);
+    /* Assigns all the points and moves the centroids to the mean of their points */
+    void assignAll();
+};
+
+#endif //LOCALL_KMEANS_H
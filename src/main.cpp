@@ -3,6 +3,7 @@
 #include "gtfs_layer.h"
 #include "geometry_index.h"
 #include "spatial_stats.h"
+#include "snapshot.h"
 #include <QApplication>
 #include <qcommandlineparser.h>
 
@@ -64,6 +65,24 @@ int main(int argc, char *argv[]) {
         QCommandLineOption cellSizeOption(QStringList() << "cell-size", "cell size for the spatial stats.", "value",
                                           "-1");
         parser.addOption(cellSizeOption);
+        QCommandLineOption horizonOption(QStringList() << "horizon",
+                                         "Maximum travel time (s) in the visit matrix, -1 for no horizon "
+                                         "(should cover the largest deadline queried).", "value",
+                                         QString::number(DEFAULT_HORIZON));
+        parser.addOption(horizonOption);
+        QCommandLineOption bucketSizeOption(QStringList() << "bucket-size",
+                                            "Time buckets (s) of the visit matrix, merged into the time windows "
+                                            "queried to the server, -1 for no buckets.", "value",
+                                            QString::number(DEFAULT_BUCKET_SIZE));
+        parser.addOption(bucketSizeOption);
+        QCommandLineOption snapshotInOption(QStringList() << "snapshot-in",
+                                            "Load the trace and the spatial stats from a snapshot (.locall).", "file",
+                                            QString());
+        parser.addOption(snapshotInOption);
+        QCommandLineOption snapshotOutOption(QStringList() << "snapshot-out",
+                                             "Save the trace and the spatial stats in a snapshot (.locall).", "file",
+                                             QString());
+        parser.addOption(snapshotOutOption);
 
         // Process the actual command line arguments given by the user
         parser.process(*(a.data()));
@@ -79,6 +98,8 @@ int main(int argc, char *argv[]) {
         double startTime = -1;
         double endTime = -1;
         double cellSize = -1;
+        long long horizon = parser.value(horizonOption).toLongLong();
+        long long bucketSize = parser.value(bucketSizeOption).toLongLong();
         if (parser.isSet(samplingOption))
             sampling = parser.value(samplingOption).toDouble();
         if (parser.isSet(startTimeOption))
@@ -103,33 +124,52 @@ int main(int argc, char *argv[]) {
         QObject::connect(&l, &Loader::loadProgressChanged, &p, &ProgressConsole::updateProgress);
 
 
-        if (parser.isSet(gtfsOption)) {
-            QString gtfsPath = parser.value(gtfsOption);
-            qDebug() << "load GTFS directory" << gtfsPath << "...";
-
-            trace = new GTFSTrace(gtfsPath, true);
-            future = l.load(static_cast<GTFSTrace*>(trace), &GTFSTrace::openTrace, &l);
+        GeometryIndex* geometryIndex = nullptr;
+        SpatialStats* spatialStats = nullptr;
+
+        if (parser.isSet(snapshotInOption)) {
+            // the snapshot holds the projected trace, the geometries and the spatial stats
+            QString snapshotPath = parser.value(snapshotInOption);
+            qDebug() << "load snapshot" << snapshotPath << "...";
+            if (!Snapshot::load(snapshotPath, &trace, &geometryIndex, &spatialStats, &l)) {
+                qWarning() << "Cannot load the snapshot" << snapshotPath;
+                return 1;
+            }
+        } else {
+            if (parser.isSet(gtfsOption)) {
+                QString gtfsPath = parser.value(gtfsOption);
+                qDebug() << "load GTFS directory" << gtfsPath << "...";
+
+                trace = new GTFSTrace(gtfsPath, true);
+                future = l.load(static_cast<GTFSTrace*>(trace), &GTFSTrace::openTrace, &l);
+                future.result();
+
+            } else if (parser.isSet(traceOption)) {
+                QString tracePath = parser.value(traceOption);
+            } else if (parser.isSet(traceDirOption)) {
+                QString traceDir = parser.value(traceDirOption);
+            }
+
+            // check if the trace is not null
+            if(!trace) a->exit(0);
+
+            qDebug() << "Compute ogrGeometry index";
+            geometryIndex = trace->makeGeometryIndex(sampling, startTime, endTime,
+                                                      cellSize, pointsType, pointsFile);
+
+            qDebug() << "compute spatial stats";
+            spatialStats = new SpatialStats(trace,
+                                            (int) sampling, (long long) startTime, (long long) endTime,
+                                            geometryIndex);
+            spatialStats->setHorizon(horizon);
+            spatialStats->setBucketSize(bucketSize);
+            future = l.load(spatialStats,&SpatialStats::computeStats, &l);
             future.result();
-
-        } else if (parser.isSet(traceOption)) {
-            QString tracePath = parser.value(traceOption);
-        } else if (parser.isSet(traceDirOption)) {
-            QString traceDir = parser.value(traceDirOption);
         }
 
-        // check if the trace is not null
-        if(!trace) a->exit(0);
-
-        qDebug() << "Compute ogrGeometry index";
-        GeometryIndex* geometryIndex = trace->makeGeometryIndex(sampling, startTime, endTime,
-                                                                cellSize, pointsType, pointsFile);
-
-        qDebug() << "compute spatial stats";
-        SpatialStats* spatialStats = new SpatialStats(trace,
-                                                      (int) sampling, (long long) startTime, (long long) endTime,
-                                                      geometryIndex);
-        future = l.load(spatialStats,&SpatialStats::computeStats, &l);
-        future.result();
+        if (parser.isSet(snapshotOutOption)) {
+            Snapshot::save(parser.value(snapshotOutOption), spatialStats, &l);
+        }
 
         ComputeAllocation* computeAllocation = new ComputeAllocation(spatialStats);
         RESTServer server(8, nullptr, computeAllocation);
@@ -0,0 +1,312 @@
+//
+// Exact maximal covering location problem, branch-and-bound with Lagrangian bounds
+//
+
+#include "mclp_solver.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "constants.h"
+
+static const double INF = std::numeric_limits<double>::infinity();
+
+/* True if a bound does not improve on the objective (up to the rounding of the sums) */
+static bool isPruned(double bound, double objective) {
+    return bound - objective <= 1e-9 * qMax(1.0, qAbs(objective));
+}
+
+MCLPSolver::MCLPSolver(int nbDemands, const QVector<int>& offsets, const QVector<int>& demands,
+                       const QVector<double>& weights):
+        _nbDemands(nbDemands),
+        _nbCandidates(offsets.size() - 1),
+        _offsets(offsets),
+        _demands(demands),
+        _weights(weights),
+        _conflicts(offsets.size() - 1) { }
+
+void MCLPSolver::addConflict(int k1, int k2) {
+    if(k1 == k2)
+        return;
+    _conflicts[k1].append(k2);
+    _conflicts[k2].append(k1);
+}
+
+double MCLPSolver::evaluate(const QVector<int>& solution) const {
+    QVector<double> best(_nbDemands, 0.0); // largest weight of each demand
+    for(int k : solution) {
+        for(int idx = _offsets[k]; idx < _offsets[k+1]; ++idx) {
+            best[_demands[idx]] = qMax(best[_demands[idx]], _weights[idx]);
+        }
+    }
+    double objective = 0.0;
+    for(double w : best) {
+        objective += w;
+    }
+    return objective;
+}
+
+bool MCLPSolver::solve(int p, double timeBudget) {
+    _timer.start();
+    _timeBudget = timeBudget;
+
+    _p = p;
+    _solution.clear();
+    _objective = 0.0;
+    _upperBound = 0.0;
+    _nbNodes = 0;
+    if(p <= 0 || _nbCandidates <= 0)
+        return true;
+
+    Node root;
+    root.status.fill(-1, _nbCandidates);
+    root.lambda.fill(0.0, _nbDemands);
+    root.nbAllocated = 0;
+
+    // trivial bound of the root, so that the upper bound stays finite if the time budget is over
+    // before the root is bounded: each demand covered with its largest weight, or the p largest
+    // coverages of the candidates
+    QVector<double> maxWeights(_nbDemands, 0.0);
+    QVector<double> coverages(_nbCandidates, 0.0);
+    for(int k = 0; k < _nbCandidates; ++k) {
+        for(int idx = _offsets[k]; idx < _offsets[k+1]; ++idx) {
+            maxWeights[_demands[idx]] = qMax(maxWeights[_demands[idx]], _weights[idx]);
+            coverages[k] += _weights[idx];
+        }
+    }
+    int n = qMin(p, _nbCandidates);
+    std::partial_sort(coverages.begin(), coverages.begin() + n, coverages.end(), std::greater<double>());
+    double demandsBound = 0.0, candidatesBound = 0.0;
+    for(double w : maxWeights) {
+        demandsBound += w;
+    }
+    for(int i = 0; i < n; ++i) {
+        candidatesBound += coverages.at(i);
+    }
+    root.bound = qMin(demandsBound, candidatesBound);
+
+    // greedy incumbent (largest marginal coverage first)
+    updateIncumbent(root, QVector<int>());
+
+    // depth-first search, the child with the candidate allocated is explored first
+    QVector<Node> stack;
+    stack.append(root);
+    bool optimal = true;
+    double openBound = 0.0; // largest bound of the nodes left unexplored
+    while(!stack.isEmpty()) {
+        if(isTimeOver()) {
+            optimal = false;
+            for(const Node& node : stack) {
+                if(!isPruned(node.bound, _objective))
+                    openBound = qMax(openBound, node.bound);
+            }
+            break;
+        }
+
+        Node node = stack.takeLast();
+        if(isPruned(node.bound, _objective))
+            continue;
+        _nbNodes++;
+
+        int branch = -1;
+        int iterations = _nbNodes == 1 ? MCLP_ROOT_ITERATIONS : MCLP_NODE_ITERATIONS;
+        double bound = qMin(node.bound, this->bound(&node, iterations, &branch));
+        if(isPruned(bound, _objective) || branch < 0)
+            continue;
+        if(isTimeOver()) { // the node is left open
+            stack.append(node);
+            stack.last().bound = bound;
+            continue;
+        }
+
+        Node excluded = node;
+        excluded.status[branch] = 0;
+        excluded.bound = bound;
+        stack.append(excluded);
+
+        Node allocated = node;
+        allocate(&allocated.status, branch);
+        allocated.nbAllocated++;
+        allocated.bound = bound;
+        stack.append(allocated);
+    }
+
+    _upperBound = optimal ? _objective : qMax(_objective, openBound);
+    return optimal || isPruned(_upperBound, _objective);
+}
+
+double MCLPSolver::lagrangian(const Node& node, const QVector<double>& lambda, QVector<double>* reduced,
+                              QVector<int>* selected) const {
+    // reduced coverage of the candidates: sum of max(0, w - lambda) over the demands they cover
+    reduced->fill(0.0, _nbCandidates);
+    selected->clear();
+    QVector<int> freeCandidates;
+    for(int k = 0; k < _nbCandidates; ++k) {
+        if(node.status[k] == 0)
+            continue;
+        double r = 0.0;
+        for(int idx = _offsets[k]; idx < _offsets[k+1]; ++idx) {
+            r += qMax(0.0, _weights[idx] - lambda[_demands[idx]]);
+        }
+        (*reduced)[k] = r;
+        if(node.status[k] == 1)
+            selected->append(k);
+        else if(r > 0.0)
+            freeCandidates.append(k);
+    }
+
+    // the allocated candidates, then the best free candidates (ties go to the lowest id)
+    int n = qMin(freeCandidates.size(), _p - node.nbAllocated);
+    auto greater = [reduced](int a, int b) {
+        return reduced->at(a) > reduced->at(b) || (reduced->at(a) == reduced->at(b) && a < b);
+    };
+    std::partial_sort(freeCandidates.begin(), freeCandidates.begin() + n, freeCandidates.end(), greater);
+
+    double bound = 0.0;
+    for(double l : lambda) {
+        bound += l;
+    }
+    for(int k : *selected) {
+        bound += reduced->at(k);
+    }
+    for(int i = 0; i < n; ++i) {
+        bound += reduced->at(freeCandidates.at(i));
+        selected->append(freeCandidates.at(i));
+    }
+    return bound;
+}
+
+double MCLPSolver::bound(Node* node, int iterations, int* branch) {
+    QVector<double> lambda = node->lambda;
+    QVector<double> reduced, bestReduced;
+    QVector<int> selected, bestSelected;
+    QVector<int> count(_nbDemands);
+    double bestBound = INF;
+    double step = 2.0;  // step factor, halved when the bound stalls
+    int stall = 0;
+
+    for(int it = 0; it < iterations; ++it) {
+        double bound = lagrangian(*node, lambda, &reduced, &selected);
+        if(bound < bestBound) {
+            bestBound = bound;
+            bestReduced = reduced;
+            bestSelected = selected;
+            node->lambda = lambda;
+            stall = 0;
+        } else if(++stall >= MCLP_STALL_ITERATIONS) {
+            step /= 2.0;
+            stall = 0;
+        }
+        updateIncumbent(*node, selected);
+        if(isPruned(bestBound, _objective) || step < 1e-4 || isTimeOver())
+            break;
+
+        // subgradient: 1 - number of relaxed assignments of each demand
+        count.fill(0);
+        for(int k : selected) {
+            for(int idx = _offsets[k]; idx < _offsets[k+1]; ++idx) {
+                if(_weights[idx] > lambda[_demands[idx]])
+                    count[_demands[idx]]++;
+            }
+        }
+        double norm = 0.0;
+        for(int d = 0; d < _nbDemands; ++d) {
+            int g = 1 - count[d];
+            if(g < 0 || (g > 0 && lambda[d] > 0.0))
+                norm += g * g;
+        }
+        if(norm == 0.0)
+            break; // the relaxed assignments are feasible, the multipliers cannot improve the bound
+
+        double t = step * (bound - _objective) / norm;
+        for(int d = 0; d < _nbDemands; ++d) {
+            lambda[d] = qMax(0.0, lambda[d] - t * (1 - count[d]));
+        }
+    }
+
+    // branch on the free candidate of the relaxed solution with the best reduced coverage, or
+    // on the best free candidate if the relaxed solution has none
+    *branch = -1;
+    if(node->nbAllocated >= _p)
+        return bestBound;
+    for(int k : bestSelected) {
+        if(node->status[k] == -1) {
+            *branch = k;
+            return bestBound;
+        }
+    }
+    for(int k = 0; k < _nbCandidates; ++k) {
+        if(node->status[k] == -1 && (*branch < 0 || bestReduced[k] > bestReduced[*branch]))
+            *branch = k;
+    }
+    return bestBound;
+}
+
+void MCLPSolver::updateIncumbent(const Node& node, const QVector<int>& selected) {
+    // the allocated candidates and the candidates of the relaxed solution that are not in conflict
+    QVector<signed char> status = node.status;
+    QVector<int> candidates;
+    for(int k = 0; k < _nbCandidates; ++k) {
+        if(status[k] == 1)
+            candidates.append(k);
+    }
+    for(int k : selected) {
+        if(status[k] == -1 && candidates.size() < _p) {
+            allocate(&status, k);
+            candidates.append(k);
+        }
+    }
+
+    // completed by the largest marginal coverages
+    QVector<double> best(_nbDemands, 0.0);
+    for(int k : candidates) {
+        for(int idx = _offsets[k]; idx < _offsets[k+1]; ++idx) {
+            best[_demands[idx]] = qMax(best[_demands[idx]], _weights[idx]);
+        }
+    }
+    while(candidates.size() < _p) {
+        int bestK = -1;
+        double bestGain = 0.0;
+        for(int k = 0; k < _nbCandidates; ++k) {
+            if(status[k] != -1)
+                continue;
+            double gain = 0.0;
+            for(int idx = _offsets[k]; idx < _offsets[k+1]; ++idx) {
+                gain += qMax(0.0, _weights[idx] - best[_demands[idx]]);
+            }
+            if(gain > bestGain) {
+                bestGain = gain;
+                bestK = k;
+            }
+        }
+        if(bestK < 0)
+            break;
+        allocate(&status, bestK);
+        candidates.append(bestK);
+        for(int idx = _offsets[bestK]; idx < _offsets[bestK+1]; ++idx) {
+            best[_demands[idx]] = qMax(best[_demands[idx]], _weights[idx]);
+        }
+    }
+
+    double objective = 0.0;
+    for(double w : best) {
+        objective += w;
+    }
+    if(objective > _objective || _solution.isEmpty()) {
+        _objective = objective;
+        _solution = candidates;
+    }
+}
+
+bool MCLPSolver::isTimeOver() const {
+    return _timeBudget >= 0.0 && _timer.elapsed() > _timeBudget * 1000.0;
+}
+
+void MCLPSolver::allocate(QVector<signed char>* status, int k) const {
+    (*status)[k] = 1;
+    for(int c : _conflicts.at(k)) {
+        if(status->at(c) == -1)
+            (*status)[c] = 0;
+    }
+}
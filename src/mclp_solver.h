@@ -0,0 +1,81 @@
+//
+// Exact maximal covering location problem, branch-and-bound with Lagrangian bounds
+//
+
+#ifndef LOCALL_MCLP_SOLVER_H
+#define LOCALL_MCLP_SOLVER_H
+
+#include <QVector>
+#include <QElapsedTimer>
+
+/* Maximal covering location problem: allocate at most p candidates so as to maximize the sum over
+ * the demands of the largest weight of the allocated candidates covering them. Candidate k covers
+ * the demands demands[offsets[k]..offsets[k+1]) with the weights weights[offsets[k]..offsets[k+1])
+ * (the links of the coverage engine), and the candidates in conflict cannot be both allocated.
+ *
+ * The assignment constraints (each demand is counted once) are relaxed with Lagrange multipliers,
+ * so the bound of a set of fixed candidates is the sum of the multipliers plus the best reduced
+ * coverages of the free candidates (Galvão and ReVelle, 1996), tightened by subgradient steps. Each
+ * relaxed solution, made feasible, gives an incumbent. The search is a depth-first branch-and-bound
+ * on the candidate with the best reduced coverage (allocated first, then excluded), which stops
+ * after the time budget with the best incumbent and the largest bound of the open nodes. */
+class MCLPSolver {
+public:
+    MCLPSolver(int nbDemands, const QVector<int>& offsets, const QVector<int>& demands,
+               const QVector<double>& weights);
+
+    /* The candidates k1 and k2 cannot be both allocated */
+    void addConflict(int k1, int k2);
+
+    /* Solves the problem for "p" candidates within "timeBudget" seconds (no limit if negative),
+     * returns true if the solution is optimal */
+    bool solve(int p, double timeBudget = -1.0);
+
+    const QVector<int>& getSolution() const { return _solution; }  // allocated candidates
+    double getObjective() const { return _objective; }
+    double getUpperBound() const { return _upperBound; }
+    /* (upper bound - objective) / upper bound, 0 if the solution is optimal */
+    double getGap() const { return _upperBound > 0.0 ? (_upperBound - _objective) / _upperBound : 0.0; }
+    int getNbNodes() const { return _nbNodes; }
+
+    /* Objective of the candidates "solution" */
+    double evaluate(const QVector<int>& solution) const;
+
+private:
+    struct Node {
+        QVector<signed char> status;   // <candidate, -1 free, 0 excluded, 1 allocated>
+        QVector<double> lambda;        // Lagrange multipliers of the parent (warm start)
+        int nbAllocated;
+        double bound;                  // bound of the parent
+    };
+
+    int _nbDemands;
+    int _nbCandidates;
+    QVector<int> _offsets, _demands;
+    QVector<double> _weights;
+    QVector<QVector<int>> _conflicts;  // <candidate, [candidate]>
+
+    int _p = 0;
+    QVector<int> _solution;
+    double _objective = 0.0;
+    double _upperBound = 0.0;
+    int _nbNodes = 0;
+    QElapsedTimer _timer;
+    double _timeBudget = -1.0;         // (s), no limit if negative
+
+    /* Lagrangian bound of the node for the multipliers "lambda", fills "reduced" with the reduced
+     * coverage of each candidate and "selected" with the candidates of the relaxed solution */
+    double lagrangian(const Node& node, const QVector<double>& lambda, QVector<double>* reduced,
+                      QVector<int>* selected) const;
+    /* Subgradient optimization of the multipliers of the node, returns the bound of the node and
+     * the candidate to branch on in "branch" (-1 if the node is a leaf) */
+    double bound(Node* node, int iterations, int* branch);
+    /* Completes the candidates "selected" of the relaxed solution into a feasible solution of the
+     * node and updates the incumbent */
+    void updateIncumbent(const Node& node, const QVector<int>& selected);
+    bool isTimeOver() const;
+    /* Allocates the candidate k (the candidates in conflict with k are excluded) */
+    void allocate(QVector<signed char>* status, int k) const;
+};
+
+#endif //LOCALL_MCLP_SOLVER_H
@@ -0,0 +1,119 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QPair>
+#include <QDebug>
+#include <QtNumeric>
+#include <random>
+
+#include "mclp_solver.h"
+
+
+/* To compile this file and execute the main below, add this file to the CMakeList and remove the main.cpp
+ * Usage: ./LocAll [number of instances] [time budget]
+ *  -> random instances small enough to enumerate all the allocations (up to 16 candidates, with
+ *     conflicts between some candidates), checks that the solver finds the optimal objective
+ *  -> then solves a large instance within the time budget (2 s by default) and reports its gap,
+ *     and checks that its upper bound stays finite with a zero time budget */
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    int nbInstances = (argc > 1) ? QString(argv[1]).toInt() : 500;
+    double timeBudget = (argc > 2) ? QString(argv[2]).toDouble() : 2.0;
+
+    std::mt19937 gen(1);
+    int errors = 0;
+    long long nbNodes = 0;
+    for(int t = 0; t < nbInstances; ++t) {
+        int nbCandidates = 4 + gen() % 13, nbDemands = 5 + gen() % 60, p = 1 + gen() % 5;
+        QVector<int> offsets, demands;
+        QVector<double> weights;
+        offsets.append(0);
+        for(int k = 0; k < nbCandidates; ++k) {
+            for(int l = 0; l < nbDemands; ++l) {
+                if(gen() % 4 == 0) {
+                    demands.append(l);
+                    // integer weights (many ties) for half of the instances
+                    weights.append(t % 2 ? (double) (1 + gen() % 5) : (gen() % 1000) / 100.0);
+                }
+            }
+            offsets.append(demands.size());
+        }
+        MCLPSolver solver(nbDemands, offsets, demands, weights);
+        QVector<QPair<int,int>> conflicts;
+        if(t % 3 == 0) {
+            for(int k1 = 0; k1 < nbCandidates; ++k1) {
+                for(int k2 = k1 + 1; k2 < nbCandidates; ++k2) {
+                    if(gen() % 6 == 0) {
+                        solver.addConflict(k1, k2);
+                        conflicts.append(qMakePair(k1, k2));
+                    }
+                }
+            }
+        }
+        bool optimal = solver.solve(p);
+        nbNodes += solver.getNbNodes();
+
+        // best allocation of at most p candidates without conflicts
+        double best = 0.0;
+        for(int mask = 0; mask < (1 << nbCandidates); ++mask) {
+            QVector<int> solution;
+            for(int k = 0; k < nbCandidates; ++k) {
+                if(mask & (1 << k))
+                    solution.append(k);
+            }
+            bool feasible = solution.size() <= p;
+            for(const QPair<int,int>& c : conflicts) {
+                if((mask & (1 << c.first)) && (mask & (1 << c.second)))
+                    feasible = false;
+            }
+            if(feasible)
+                best = qMax(best, solver.evaluate(solution));
+        }
+
+        bool feasible = solver.getSolution().size() <= p;
+        for(const QPair<int,int>& c : conflicts) {
+            if(solver.getSolution().contains(c.first) && solver.getSolution().contains(c.second))
+                feasible = false;
+        }
+        if(!optimal || !feasible || qAbs(best - solver.getObjective()) > 1e-9 || solver.getGap() != 0.0
+           || qAbs(solver.evaluate(solver.getSolution()) - solver.getObjective()) > 1e-9) {
+            qDebug() << "instance" << t << "optimal" << optimal << "feasible" << feasible
+                     << "objective" << solver.getObjective() << "expected" << best;
+            errors++;
+        }
+    }
+    qDebug() << (errors == 0 ? "[OK]" : "[FAILED]") << nbInstances << "instances," << errors << "errors,"
+             << nbNodes << "nodes";
+
+    // large instance, stopped by the time budget
+    int nbCandidates = 400, nbDemands = 3000, p = 20;
+    QVector<int> offsets, demands;
+    QVector<double> weights;
+    offsets.append(0);
+    for(int k = 0; k < nbCandidates; ++k) {
+        for(int l = 0; l < nbDemands; ++l) {
+            if(gen() % 60 == 0) {
+                demands.append(l);
+                weights.append((gen() % 1000) / 100.0);
+            }
+        }
+        offsets.append(demands.size());
+    }
+    MCLPSolver solver(nbDemands, offsets, demands, weights);
+    QElapsedTimer timer;
+    timer.start();
+    bool optimal = solver.solve(p, timeBudget);
+    qDebug() << "large instance" << (optimal ? "optimal" : "time budget reached") << "in" << timer.elapsed() << "ms,"
+             << "objective" << solver.getObjective() << "upper bound" << solver.getUpperBound()
+             << "gap" << solver.getGap() << "nodes" << solver.getNbNodes();
+
+    // no time to bound the root: the upper bound is the trivial bound
+    solver.solve(p, 0.0);
+    if(!qIsFinite(solver.getUpperBound()) || !qIsFinite(solver.getGap())) {
+        qDebug() << "[FAILED] no time budget, upper bound" << solver.getUpperBound() << "gap" << solver.getGap();
+        errors++;
+    }
+
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+#include "spatial_stats.h"
+#include "geometry_index.h"
+#include "geometries.h"
+
+
+/* To compile this file and execute the main below, add this file to the CMakeList and remove the main.cpp
+ * Usage: ./LocAll
+ *  -> runs the same traces through the two paths of MobileNode::addPosition on dense grids of cells
+ *     and compares the visits (start, end and geometry of each visit, in the order of the records) */
+
+/* Position of a node at a given time */
+struct Fix {
+    long long time;
+    double x;
+    double y;
+};
+
+/* Runs a trace through the cells crossed by the segments (the path of MobileNode::addPosition on a
+ * dense grid) and through the point query of each sample (the path of the other indexes), on the
+ * same index, so the visits are expected to be identical, in the same order */
+class MobileNodeVisitsTest {
+public:
+    MobileNodeVisitsTest(SpatialStats* spatialStats): _spatialStats(spatialStats) { }
+
+    bool run(const QString& name, int sampling, const QList<Fix>& trace) {
+        if(!_spatialStats->getGeometryIndex()->isDense()) {
+            qDebug() << name << "the geometry index is not a dense grid";
+            return false;
+        }
+        MobileNode crossings(name, sampling, _spatialStats);
+        MobileNode samples(name, sampling, _spatialStats);
+        for(const Fix& fix : trace) {
+            crossings.addPosition(fix.time, fix.x, fix.y);
+            addSampledPosition(&samples, fix.time, fix.x, fix.y);
+        }
+        return compareVisits(name, crossings._visits, samples._visits);
+    }
+
+private:
+    SpatialStats* _spatialStats;
+
+    /* Same as MobileNode::addPosition, with the samples instead of the cells crossed */
+    void addSampledPosition(MobileNode* node, long long time, double x, double y) {
+        if(node->_prevPos.isNull() || time - node->_prevTime > 300 || time <= node->_prevTime) {
+            // restart of the recording, or no sample
+            node->addPosition(time, x, y);
+            return;
+        }
+        node->addSamples(time, QPointF(x,y));
+        node->_prevPos = QPointF(x,y);
+        node->_prevTime = time;
+    }
+
+    bool compareVisits(const QString& name, const QVector<Visit>& crossings, const QVector<Visit>& samples) {
+        for(int i = 0; i < qMin(crossings.size(), samples.size()); ++i) {
+            const Visit& a = crossings.at(i);
+            const Visit& b = samples.at(i);
+            if(a.start != b.start || a.end != b.end || a.geom != b.geom) {
+                qDebug() << name << "visit" << i << "differs:" << a.start << a.end << a.geom->toString()
+                         << "instead of" << b.start << b.end << b.geom->toString();
+                return false;
+            }
+        }
+        if(crossings.size() != samples.size()) {
+            qDebug() << name << "number of visits differs:" << crossings.size() << "instead of" << samples.size();
+            return false;
+        }
+        if(samples.isEmpty()) {
+            qDebug() << name << "no visits recorded";
+            return false;
+        }
+        return true;
+    }
+};
+
+/* Grid of nbCells x nbCells cells of "cellSize" from (x0,y0), indexed as a dense grid */
+GeometryIndex* makeGridIndex(double x0, double y0, double cellSize, int nbCells, QList<Geometry*>* cells) {
+    for(int j = 0; j < nbCells; ++j) {
+        for(int i = 0; i < nbCells; ++i) {
+            cells->append(new Cell(x0 + i*cellSize, y0 + j*cellSize, cellSize));
+        }
+    }
+    return new GeometryIndex(*cells, cellSize);
+}
+
+/* Moves along the borders of the cells, through their corners (diagonals) and along their centers,
+ * with samples that fall on the borders and the corners */
+QList<Fix> makeAlignedTrace(double x0, double y0, double cellSize, int nbCells, int sampling) {
+    QList<Fix> trace;
+    long long time = 1000;
+    int step = qMax(1, sampling);
+    double end = (nbCells - 1) * cellSize;
+    // horizontal and vertical borders, one cell per sample then one cell per 3 samples
+    for(int k : { 1, 3 }) {
+        trace.append({ time, x0 + cellSize, y0 + cellSize });
+        for(int i = 2; i < nbCells; ++i)
+            trace.append({ time += k*step, x0 + i*cellSize, y0 + cellSize });
+        for(int j = 2; j < nbCells; ++j)
+            trace.append({ time += k*step, x0 + end, y0 + j*cellSize });
+        time += 1000; // restart
+    }
+    // diagonal through the corners, in both directions, then back along the anti-diagonal
+    trace.append({ time, x0, y0 });
+    trace.append({ time += nbCells*step, x0 + end, y0 + end });
+    trace.append({ time += nbCells*step, x0 + cellSize, y0 + cellSize });
+    trace.append({ time += 2*nbCells*step, x0 + end, y0 + cellSize });
+    trace.append({ time += nbCells*step, x0 + cellSize, y0 + end });
+    time += 1000;
+    // centers of the cells, in a single move (several samples in each cell)
+    trace.append({ time, x0 + 0.5*cellSize, y0 + 0.5*cellSize });
+    trace.append({ time += 7*nbCells*step, x0 + end + 0.5*cellSize, y0 + 0.5*cellSize });
+    trace.append({ time += 5*nbCells*step, x0 + end + 0.5*cellSize, y0 + end + 0.5*cellSize });
+    // steep move that touches a corner, and a move that leaves the grid and comes back
+    trace.append({ time += 3*step, x0 + end - 2*cellSize, y0 + end - 0.5*cellSize });
+    trace.append({ time += 4*nbCells*step, x0 - 2*cellSize, y0 + 3*cellSize });
+    trace.append({ time += 4*nbCells*step, x0 + 2*cellSize, y0 + 2*cellSize });
+    return trace;
+}
+
+/* Stationary nodes: on a corner, on a border, inside a cell, with fixes at the same time */
+QList<Fix> makeStationaryTrace(double x0, double y0, double cellSize, int sampling) {
+    QList<Fix> trace;
+    long long time = 1000;
+    int step = qMax(1, sampling);
+    QList<QPointF> positions = { QPointF(x0 + 2*cellSize, y0 + 2*cellSize),
+                                 QPointF(x0 + 3*cellSize, y0 + 2.5*cellSize),
+                                 QPointF(x0 + 1.25*cellSize, y0 + 1.75*cellSize) };
+    for(const QPointF& pos : positions) {
+        for(int i = 0; i < 5; ++i) {
+            trace.append({ time, pos.x(), pos.y() });
+            trace.append({ time, pos.x(), pos.y() });
+            time += (i % 2) ? step/2 + 1 : 4*step;
+        }
+        // then a move of one cell in x
+        trace.append({ time, pos.x() + cellSize, pos.y() });
+        time += 1000;
+    }
+    return trace;
+}
+
+/* Random walks that also leave the grid, with gaps shorter than the sampling, fixes at the same
+ * time and gaps that restart the recording */
+QList<Fix> makeRandomTrace(double x0, double y0, double cellSize, int nbCells, int nbPoints) {
+    QList<Fix> trace;
+    double size = nbCells * cellSize;
+    double x = x0 + (qrand() % 1000) / 1000.0 * size;
+    double y = y0 + (qrand() % 1000) / 1000.0 * size;
+    long long time = 1000;
+    for(int i = 0; i < nbPoints; ++i) {
+        trace.append({ time, x, y });
+        int move = qrand() % 10;
+        if(move == 0) { // grid-aligned jump
+            x = x0 + (qrand() % (nbCells + 2) - 1) * cellSize;
+            y = y0 + (qrand() % (nbCells + 2) - 1) * cellSize;
+        } else if(move > 2) {
+            x += ((qrand() % 2001) - 1000) / 1000.0 * 3 * cellSize;
+            y += ((qrand() % 2001) - 1000) / 1000.0 * 3 * cellSize;
+        } // else stationary
+        int gap = qrand() % 20;
+        time += (gap == 0) ? 0 : (gap == 1) ? 301 + qrand() % 600 : 1 + qrand() % 120;
+    }
+    return trace;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    qsrand(42);
+
+    // cell size and origin of the grids (including a non-integer cell size and UTM coordinates)
+    struct Grid { double x0; double y0; double cellSize; int nbCells; };
+    QList<Grid> grids = { { 0.0, 0.0, 100.0, 12 },
+                          { -300.0, -150.0, 37.5, 16 },
+                          { 548000.0, 4176000.0, 200.0, 20 } };
+    QList<int> samplings = { -1, 1, 7, 10, 30 };
+
+    int failures = 0;
+    for(const Grid& grid : grids) {
+        QList<Geometry*> cells;
+        GeometryIndex* geometryIndex = makeGridIndex(grid.x0, grid.y0, grid.cellSize, grid.nbCells, &cells);
+        SpatialStats* spatialStats = new SpatialStats(nullptr, -1, -1, -1, geometryIndex);
+        MobileNodeVisitsTest test(spatialStats);
+
+        for(int sampling : samplings) {
+            QList<QPair<QString, QList<Fix>>> traces;
+            traces << qMakePair(QString("aligned"), makeAlignedTrace(grid.x0, grid.y0, grid.cellSize, grid.nbCells, sampling))
+                   << qMakePair(QString("stationary"), makeStationaryTrace(grid.x0, grid.y0, grid.cellSize, sampling));
+            for(int i = 0; i < 20; ++i)
+                traces << qMakePair(QString("random %1").arg(i), makeRandomTrace(grid.x0, grid.y0, grid.cellSize, grid.nbCells, 200));
+
+            for(const QPair<QString, QList<Fix>>& trace : traces) {
+                bool ok = test.run(trace.first, sampling, trace.second);
+                if(!ok) {
+                    qDebug() << "[FAILED]" << "cell size" << grid.cellSize << "sampling" << sampling << trace.first;
+                    failures++;
+                }
+            }
+        }
+        qDebug() << "cell size" << grid.cellSize << "origin" << grid.x0 << grid.y0 << "done";
+
+        delete spatialStats;
+        delete geometryIndex;
+        qDeleteAll(cells);
+    }
+    qDebug() << (failures ? "[FAILED]" : "[OK]") << failures << "failures";
+
+    return failures;
+}
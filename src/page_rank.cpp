@@ -0,0 +1,153 @@
+//
+// PageRank of the geometries over their transition graph
+//
+
+#include "page_rank.h"
+
+#include <QtConcurrent>
+#include <QtMath>
+
+#include "coverage_matrix.h"
+
+PageRank::PageRank(CoverageMatrix* coverageMatrix, const QList<Geometry*>& nodes, QThreadPool* pool):
+        _nodes(nodes.toVector()),
+        _removed(nodes.size(), false),
+        _pool(pool ? pool : QThreadPool::globalInstance()) {
+
+    // <coverage matrix id, node id>
+    QVector<int> nodeIds(coverageMatrix->getNbGeometries(), -1);
+    for(int i = 0; i < _nodes.size(); ++i) {
+        int id = coverageMatrix->getId(_nodes.at(i));
+        if(id >= 0)
+            nodeIds[id] = i;
+    }
+
+    // links reaching each node from the other nodes
+    _inOffsets.reserve(_nodes.size() + 1);
+    for(int j = 0; j < _nodes.size(); ++j) {
+        _inOffsets.append(_inNodes.size());
+        int col = coverageMatrix->getId(_nodes.at(j));
+        if(col < 0)
+            continue;
+        for(int idx = coverageMatrix->colBegin(col); idx < coverageMatrix->colEnd(col); ++idx) {
+            int link = coverageMatrix->transposedLink(idx);
+            int i = nodeIds.at(coverageMatrix->getRow(link));
+            double weight = coverageMatrix->getMedScore(link);
+            if(i >= 0 && i != j && weight > 0.0) {
+                _inNodes.append(i);
+                _inWeights.append(weight);
+            }
+        }
+    }
+    _inOffsets.append(_inNodes.size());
+}
+
+bool PageRank::compute(QVector<double>* ranks, double alpha, int maxIterations, double tolerance,
+                       double* residual) const {
+    int n = _nodes.size();
+    int nbNodes = _removed.count(false);
+    if(residual)
+        *residual = 0.0;
+    if(nbNodes == 0) {
+        ranks->fill(0.0, n);
+        return true;
+    }
+
+    // inverse of the weight of the links towards the remaining nodes (0 for the dangling nodes)
+    QVector<double> invOutWeights(n, 0.0);
+    for(int j = 0; j < n; ++j) {
+        if(_removed.at(j))
+            continue;
+        for(int idx = _inOffsets.at(j); idx < _inOffsets.at(j+1); ++idx) {
+            int i = _inNodes.at(idx);
+            if(!_removed.at(i))
+                invOutWeights[i] += _inWeights.at(idx);
+        }
+    }
+    QVector<int> danglingNodes;
+    for(int i = 0; i < n; ++i) {
+        if(_removed.at(i))
+            continue;
+        if(invOutWeights.at(i) > 0.0)
+            invOutWeights[i] = 1.0 / invOutWeights.at(i);
+        else
+            danglingNodes.append(i);
+    }
+
+    // initial ranks over the remaining nodes, summing to 1
+    QVector<double> x(n, 0.0);
+    double sum = 0.0;
+    if(ranks->size() == n) {
+        for(int i = 0; i < n; ++i) {
+            if(!_removed.at(i))
+                sum += ranks->at(i);
+        }
+    }
+    for(int i = 0; i < n; ++i) {
+        if(!_removed.at(i))
+            x[i] = sum > 0.0 ? ranks->at(i) / sum : 1.0 / nbNodes;
+    }
+
+    // contiguous chunks of nodes (a few per thread to balance the load)
+    int nbChunks = qMax(1, qMin(n, 4 * _pool->maxThreadCount()));
+    int chunkSize = qCeil((double) n / nbChunks);
+    QVector<QPair<int,int>> chunks;
+    for(int begin = 0; begin < n; begin += chunkSize) {
+        chunks.append(qMakePair(begin, qMin(begin + chunkSize, n)));
+    }
+
+    QVector<double> xlast(n), contributions(n);
+    QVector<double> errors(chunks.size());
+    bool converged = false;
+    for(int it = 0; it < maxIterations && !converged; ++it) {
+        xlast.swap(x);
+
+        // rank sent along each link (0 from the removed and the dangling nodes)
+        double dangleSum = 0.0;
+        for(int i : danglingNodes) {
+            dangleSum += xlast.at(i);
+        }
+        for(int i = 0; i < n; ++i) {
+            contributions[i] = xlast.at(i) * invOutWeights.at(i);
+        }
+        double base = (alpha * dangleSum + (1.0 - alpha)) / nbNodes;
+
+        // x = alpha * P^T xlast + base, each task gathers the incoming links of its nodes
+        const double* c = contributions.constData();
+        const double* last = xlast.constData();
+        double* next = x.data();
+        QList<QFuture<void>> futures;
+        for(int t = 0; t < chunks.size(); ++t) {
+            futures.append(QtConcurrent::run(_pool, [this, &chunks, &errors, c, last, next, alpha, base, t]() {
+                double err = 0.0;
+                for(int j = chunks.at(t).first; j < chunks.at(t).second; ++j) {
+                    if(_removed.at(j)) {
+                        next[j] = 0.0;
+                        continue;
+                    }
+                    double s = 0.0;
+                    for(int idx = _inOffsets.at(j); idx < _inOffsets.at(j+1); ++idx) {
+                        s += c[_inNodes.at(idx)] * _inWeights.at(idx);
+                    }
+                    next[j] = alpha * s + base;
+                    err += qAbs(next[j] - last[j]);
+                }
+                errors[t] = err;
+            }));
+        }
+        for(QFuture<void>& future : futures) {
+            future.waitForFinished();
+        }
+
+        double err = 0.0;
+        for(double e : errors) {
+            err += e;
+        }
+        converged = err < nbNodes * tolerance;
+        if(residual)
+            *residual = err;
+    }
+
+    *ranks = x;
+    return converged;
+}
@@ -0,0 +1,50 @@
+//
+// PageRank of the geometries over their transition graph
+//
+
+#ifndef LOCALL_PAGE_RANK_H
+#define LOCALL_PAGE_RANK_H
+
+#include <QList>
+#include <QVector>
+#include <QThreadPool>
+
+// forward class declarations
+class Geometry;
+class CoverageMatrix;
+
+/* Transition graph between a set of nodes (the links of the coverage matrix between them, weighted
+ * by their median score), stored once as the CSR of the incoming links of each node. Removing a
+ * node only masks it: the ranks are computed on the graph of the remaining nodes, the weights of
+ * the links leaving a node being normalized by its total weight towards the remaining nodes. Each
+ * step of the power iteration gathers the incoming links of the nodes on the threads of the pool. */
+class PageRank {
+public:
+    PageRank(CoverageMatrix* coverageMatrix, const QList<Geometry*>& nodes, QThreadPool* pool = nullptr);
+
+    int size() const { return _nodes.size(); }
+    Geometry* getNode(int i) const { return _nodes.at(i); }
+    bool isRemoved(int i) const { return _removed.at(i); }
+    /* Removes the node i and its links from the graph */
+    void removeNode(int i) { _removed[i] = true; }
+
+    /* Fills "ranks" with the rank of each node (0 for the removed nodes), starting from "ranks" if
+     * it has a rank per node (warm start), from the uniform distribution otherwise. The rank of the
+     * dangling nodes (no link towards the remaining nodes) is spread over all the nodes. Returns
+     * true if the L1 change of the ranks falls below nbNodes * tolerance within maxIterations,
+     * "ranks" holds the last iterate otherwise and "residual" its L1 change */
+    bool compute(QVector<double>* ranks, double alpha = 0.85, int maxIterations = 100, double tolerance = 1.0e-6,
+                 double* residual = nullptr) const;
+
+private:
+    QVector<Geometry*> _nodes;
+    QVector<bool> _removed;
+    QThreadPool* _pool;
+
+    // <node, [node linking to it]> and the weights of these links (CSR)
+    QVector<int> _inOffsets;
+    QVector<int> _inNodes;
+    QVector<double> _inWeights;
+};
+
+#endif //LOCALL_PAGE_RANK_H
@@ -1,20 +1,57 @@
 #include "proj_factory.h"
+#include "transverse_mercator.h"
 
 #include <QDebug>
+#include <QVector>
 
 ProjFactory::ProjFactory(const QString& projIn, const QString& projOut) {
     // construct the in-projections and out-projections
     setProj(projIn, projOut);
 }
 
+ThreadProj::ThreadProj(projPJ projIn, projPJ projOut, int generation):
+        generation(generation) {
+    // initialize the projections from their definition, in a context of their own
+    ctx = pj_ctx_alloc();
+    if(projIn) {
+        char* def = pj_get_def(projIn, 0);
+        this->projIn = pj_init_plus_ctx(ctx, def);
+        pj_dalloc(def);
+    }
+    if(projOut) {
+        char* def = pj_get_def(projOut, 0);
+        this->projOut = pj_init_plus_ctx(ctx, def);
+        pj_dalloc(def);
+    }
+}
+
+ThreadProj::~ThreadProj() {
+    if(projIn)  pj_free(projIn);
+    if(projOut) pj_free(projOut);
+    pj_ctx_free(ctx);
+}
+
+ThreadProj* ProjFactory::getThreadProj() {
+    int generation = _generation.load();
+    if(!_threadProjs.hasLocalData() || _threadProjs.localData()->generation != generation) {
+        // (the previous copy is deleted by the thread storage)
+        _threadProjs.setLocalData(new ThreadProj(_projIn, _projOut, generation));
+    }
+    return _threadProjs.localData();
+}
+
 void ProjFactory::transformCoordinates(double lat, double lon, double *x, double *y) {
     double x1 = 0;
     double y1 = 0;
     // Transformation of the lat/lon coordinates to projected coordinates
     if(_projIn && _projOut) {
+        ThreadProj* proj = getThreadProj(); // the loaders project from several threads
         x1 = lon * DEG_TO_RAD;
         y1 = lat * DEG_TO_RAD;
-        pj_transform(_projIn, _projOut, 1, 1, &x1, &y1, NULL);
+        if(proj->projIn && proj->projOut)
+            pj_transform(proj->projIn, proj->projOut, 1, 1, &x1, &y1, NULL);
+        else
+            pj_transform(_projIn, _projOut, 1, 1, &x1, &y1, NULL);
     } else {
         x1 = lon;
         y1 = lat;
@@ -24,6 +61,88 @@ void ProjFactory::transformCoordinates(double lat, double lon, double *x, double
     *y = y1;
 }
 
+void ProjFactory::transformCoordinates(long count, double* lons, double* lats, int stride) {
+    // without projection, the coordinates stay in degrees
+    if(count <= 0 || !_projIn || !_projOut)
+        return;
+
+    TransverseMercator* nativeProj = getNativeProj();
+    if(nativeProj) {
+        nativeProj->forward(count, lons, lats, stride);
+        return;
+    }
+
+    // Transformation of the lat/lon coordinates to projected coordinates, in one call to PROJ
+    for(long i = 0; i < count; ++i) {
+        lons[i * stride] *= DEG_TO_RAD;
+        lats[i * stride] *= DEG_TO_RAD;
+    }
+    ThreadProj* proj = getThreadProj();
+    if(proj->projIn && proj->projOut)
+        pj_transform(proj->projIn, proj->projOut, count, stride, lons, lats, NULL);
+    else
+        pj_transform(_projIn, _projOut, count, stride, lons, lats, NULL);
+}
+
+TransverseMercator* ProjFactory::getNativeProj() {
+    QMutexLocker locker(&_nativeProjMutex);
+    int generation = _generation.load();
+    if(_nativeProjGeneration != generation) {
+        delete _nativeProj;
+        _nativeProj = makeNativeProj();
+        _nativeProjGeneration = generation;
+    }
+    return _nativeProjEnabled ? _nativeProj : 0;
+}
+
+TransverseMercator* ProjFactory::makeNativeProj() {
+    if(!_projIn || !_projOut || !pj_is_latlong(_projIn))
+        return 0;
+
+    char* def = pj_get_def(_projOut, 0);
+    double lon0, lat0, k0, x0, y0;
+    bool supported = TransverseMercator::parseDefinition(QString(def), &lon0, &lat0, &k0, &x0, &y0);
+    pj_dalloc(def);
+    if(!supported)
+        return 0;
+
+    double a, es;
+    pj_get_spheroid_defn(_projOut, &a, &es);
+    TransverseMercator* nativeProj = new TransverseMercator(a, es, lon0, lat0, k0, x0, y0);
+
+    // check the native projection against PROJ on a grid around the central meridian
+    QVector<double> lons, lats;
+    for(double lat = -80.0; lat <= 84.0; lat += 2.0) {
+        for(double dlon = -3.5; dlon <= 3.5; dlon += 0.5) {
+            lons.append(lon0 + dlon);
+            lats.append(lat);
+        }
+    }
+    QVector<double> xs = lons, ys = lats;
+    nativeProj->forward(xs.size(), xs.data(), ys.data());
+    for(int i = 0; i < lons.size(); ++i) {
+        lons[i] *= DEG_TO_RAD;
+        lats[i] *= DEG_TO_RAD;
+    }
+    ThreadProj* proj = getThreadProj();
+    int error = (proj->projIn && proj->projOut) ?
+                pj_transform(proj->projIn, proj->projOut, lons.size(), 1, lons.data(), lats.data(), NULL) :
+                pj_transform(_projIn, _projOut, lons.size(), 1, lons.data(), lats.data(), NULL);
+
+    double maxError = 0.0;
+    for(int i = 0; i < lons.size(); ++i) {
+        maxError = qMax(maxError, qMax(qAbs(xs.at(i) - lons.at(i)), qAbs(ys.at(i) - lats.at(i))));
+    }
+    if(error != 0 || !(maxError < NATIVE_PROJ_TOLERANCE)) {
+        qDebug() << "[NATIVE PROJ] disabled, max error with PROJ" << maxError << "m";
+        delete nativeProj;
+        return 0;
+    }
+
+    qDebug() << "[NATIVE PROJ] enabled, max error with PROJ" << maxError << "m";
+    return nativeProj;
+}
+
 void ProjFactory::transformCoordinates(const QString &projIn, double lat, double lon, double *x, double *y) {
     projPJ proj;
     getProj(&proj, projIn);
@@ -9,6 +9,24 @@
 #include <QList>
 #include <QDebug>
 #include <QMap>
+#include <QAtomicInt>
+#include <QThreadStorage>
+#include <QMutex>
+
+// forward class declaration
+class TransverseMercator;
+
+
+/* Copy of the projections for one thread (PROJ.4 projections must not be shared between threads) */
+struct ThreadProj {
+    ThreadProj(projPJ projIn, projPJ projOut, int generation);
+    ~ThreadProj();
+
+    projCtx ctx;
+    projPJ projIn  = 0;
+    projPJ projOut = 0;
+    int generation;
+};
 
 
 class ProjFactory {
@@ -22,19 +40,32 @@ public:
     void revertCoordinates(double x, double y, double* lat, double* lon);
     void transformCoordinates(const QString& projIn, double lat, double lon, double* x, double* y);
     void transformCoordinates(double lat, double lon, double* x, double* y);
+    /* Projects "count" points in place, (lons[i*stride], lats[i*stride]) hold the longitude and
+     * the latitude in degrees and receive the projected coordinates (x, y) */
+    void transformCoordinates(long count, double* lons, double* lats, int stride = 1);
+
+    /* Enables the native transverse Mercator projection in the batch projection (when the output
+     * projection is UTM and the native projection agrees with PROJ) */
+    void setNativeProj(bool enabled) {
+        _nativeProjEnabled = enabled;
+    }
     void setProj(const QString& projIn, const QString& projOut) {
         setProjIn(projIn);
         setProjOut(projOut);
     }
 
     void setProjIn(const QString& projIn) {
-        if(!projIn.isEmpty())
+        if(!projIn.isEmpty()) {
             _projIn  = pj_init_plus(projIn.toStdString().c_str());
+            _generation.ref();
+        }
     }
 
     void setProjOut(const QString& projOut) {
-        if(!projOut.isEmpty())
+        if(!projOut.isEmpty()) {
             _projOut = pj_init_plus(projOut.toStdString().c_str());
+            _generation.ref();
+        }
     }
 
     void getProj(projPJ* proj, const QString& p) {
@@ -44,6 +75,7 @@ public:
     void setProj(projPJ projIn, projPJ projOut) {
         _projIn  = projIn;
         _projOut = projOut;
+        _generation.ref();
     }
 
     char* getOutputProj() const {
@@ -85,6 +117,19 @@ private:
 
     projPJ _projIn  = 0;
     projPJ _projOut = 0;
+    QAtomicInt _generation;                     // changes each time the projections are set
+    QThreadStorage<ThreadProj*> _threadProjs;   // projections used by each thread
+
+    bool _nativeProjEnabled = true;
+    int _nativeProjGeneration = -1;             // generation of the projections of _nativeProj
+    TransverseMercator* _nativeProj = 0;        // native projection, null if the projections are not supported
+    QMutex _nativeProjMutex;
+
+    /* Returns the copy of the projections of the calling thread */
+    ThreadProj* getThreadProj();
+    /* Returns the native projection for the current projections (null if there is none) */
+    TransverseMercator* getNativeProj();
+    TransverseMercator* makeNativeProj();
 };
 
 #endif // PROJFACTORY_H
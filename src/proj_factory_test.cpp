@@ -0,0 +1,73 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QRegExp>
+#include <QDebug>
+#include <random>
+
+#include "proj_factory.h"
+
+
+/* To compile this file and execute the main below, add this file to the CMakeList and remove the main.cpp
+ * Usage: ./LocAll [output projection] [number of points]
+ *  -> the output projection is UTM 10N by default, the points are drawn at random within 3.5 degrees
+ *     of the central meridian
+ *  -> checks that the batch projection (native and with PROJ) agrees with the projection point
+ *     by point, and compares their throughput */
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    QString projOut = (argc > 1) ? QString(argv[1]) : "+proj=utm +zone=10 +ellps=WGS84 +datum=WGS84 +units=m +no_defs";
+    int count = (argc > 2) ? QString(argv[2]).toInt() : 1000000;
+    double lon0 = 0.0;
+    QRegExp rx("\\+(zone|lon_0)=(-?[\\d\\.]+)");
+    if(rx.indexIn(projOut) != -1)
+        lon0 = rx.cap(1) == "zone" ? rx.cap(2).toInt() * 6 - 183 : rx.cap(2).toDouble();
+
+    ProjFactory& factory = ProjFactory::getInstance();
+    factory.setProj("+proj=longlat +ellps=WGS84 +datum=WGS84 +no_defs", projOut);
+
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> lonDist(lon0 - 3.5, lon0 + 3.5), latDist(-80.0, 84.0);
+    QVector<double> lons(count), lats(count);
+    for(int i = 0; i < count; ++i) {
+        lons[i] = lonDist(gen);
+        lats[i] = latDist(gen);
+    }
+
+    // reference: one call to PROJ per point
+    QElapsedTimer timer;
+    timer.start();
+    QVector<double> refXs(count), refYs(count);
+    for(int i = 0; i < count; ++i) {
+        factory.transformCoordinates(lats.at(i), lons.at(i), &refXs[i], &refYs[i]);
+    }
+    qint64 pointTime = timer.elapsed();
+
+    auto runBatch = [&](bool native, qint64* time, double* maxError) {
+        factory.setNativeProj(native);
+        QVector<double> xs = lons, ys = lats;
+        timer.start();
+        factory.transformCoordinates(count, xs.data(), ys.data());
+        *time = timer.elapsed();
+        *maxError = 0.0;
+        for(int i = 0; i < count; ++i) {
+            *maxError = qMax(*maxError, qMax(qAbs(xs.at(i) - refXs.at(i)), qAbs(ys.at(i) - refYs.at(i))));
+        }
+    };
+
+    qint64 projTime, nativeTime;
+    double projError, nativeError;
+    runBatch(false, &projTime, &projError);
+    runBatch(true, &nativeTime, &nativeError);
+
+    qDebug() << count << "points" << projOut;
+    qDebug() << "point by point" << pointTime << "ms";
+    qDebug() << "batch PROJ    " << projTime << "ms, max error" << projError << "m";
+    qDebug() << "batch native  " << nativeTime << "ms, max error" << nativeError << "m";
+
+    bool ok = projError == 0.0 && nativeError < NATIVE_PROJ_TOLERANCE;
+    qDebug() << (ok ? "[OK]" : "[FAILED]") << "batch projection";
+
+    return ok ? 0 : 1;
+}
@@ -7,6 +7,7 @@
 
 #include "loader.h"
 #include "geometries.h"
+#include "spatial_stats.h"
 
 using namespace qhttp::server;
 QAtomicInt  gHandledConnections;
@@ -44,7 +45,7 @@ public slots:
                 gHandledConnections.ref();
                 res->addHeader("connection", "close");
 
-                QRegExp exp("^/allocation/(loc|pgrk|kmeans|rnd)$");
+                QRegExp exp("^/allocation/(loc|pgrk|kmeans|rnd|mclp)$");
 
                 if (exp.indexIn(req->url().path()) != -1) {
                     QString method = exp.capturedTexts()[1];
@@ -52,6 +53,7 @@ public slots:
                     QUrlQuery query(queryStr);
 
                     QString originalReq = "{}";
+                    QString results;  // results of the method, added to the response
                     QHash<Geometry*, Allocation*> allocation;
 
                     // convert the method name
@@ -59,8 +61,43 @@ public slots:
                     else if (method == "pgrk") method = PAGE_RANK_MEHTOD_NAME;
                     else if (method == "kmeans") method = K_MEANS_MEHTOD_NAME;
                     else if (method == "rnd") method = RANDOM_METHOD_NAME;
+                    else if (method == "mclp") method = EXACT_MCLP_METHOD_NAME;
+
+                    // spatial stats of the time window [start, end] (merged from the time buckets)
+                    // -> the window is kept alive until the response is sent
+                    ComputeAllocation* computeAllocation = _computeAllocation;
+                    QSharedPointer<SpatialStats> window;
+                    QScopedPointer<ComputeAllocation> windowAllocation;
+                    long long start = -1, end = -1;
+                    if (query.hasQueryItem("start") || query.hasQueryItem("end")) {
+                        SpatialStats* spatialStats = _computeAllocation->getSpatialStats();
+                        start = query.hasQueryItem("start") ? query.queryItemValue("start").toLongLong() : spatialStats->getStartTime();
+                        end = query.hasQueryItem("end") ? query.queryItemValue("end").toLongLong() : spatialStats->getEndTime();
 
-                    if (method == LOCATION_ALLOCATION_MEHTOD_NAME) { // allocation allocation
+                        Loader l;
+                        ProgressConsole p;
+                        connect(&l, &Loader::loadProgressChanged, &p, &ProgressConsole::updateProgress);
+                        QFuture<bool> future = l.load(spatialStats, &SpatialStats::getWindow, &l, start, end, &window);
+                        if (!future.result() || !window) {
+                            QString respBody = QString("{\"error\":\"no spatial stats for the time window [%1, %2]\"}").arg(
+                                    QString::number(start), QString::number(end));
+                            res->setStatusCode(qhttp::ESTATUS_INTERNAL_SERVER_ERROR);
+                            res->addHeader("Content-Type", "application/json");
+                            res->end(respBody.toUtf8());
+                            return;
+                        }
+
+                        // the bounds actually used (the window is widened to whole time buckets)
+                        start = window->getStartTime();
+                        end = window->getEndTime();
+                        if (window.data() != spatialStats) {
+                            windowAllocation.reset(new ComputeAllocation(window.data()));
+                            computeAllocation = windowAllocation.data();
+                        }
+                    }
+
+                    if (method == LOCATION_ALLOCATION_MEHTOD_NAME || method == EXACT_MCLP_METHOD_NAME ||
+                        method == PAGE_RANK_MEHTOD_NAME) { // allocation allocation (greedy or exact), page rank
 
                         int nbFacilities = query.queryItemValue("nbFacilities").toInt();
                         double deadline = query.queryItemValue("deadline").toDouble();
@@ -68,14 +105,18 @@ public slots:
 
                         TravelTimeStat ttStat = NoneTTStat;
                         double travelTime = 0.0;
+                        double ttPercentile = 0.5;
                         if (query.hasQueryItem("travelTime")) {
                             QString tt = query.queryItemValue("travelTime");
-                            QRegExp exp1("^(med|avg|[\\d.]+)");
+                            QRegExp exp1("^(med|avg|p[\\d.]+|[\\d.]+)");
                             if (exp1.indexIn(tt) != -1) {
                                 QString stat = exp1.capturedTexts()[1];
                                 if (stat == "med") ttStat = MedTTStat;
                                 else if (stat == "avg") ttStat = AvgTTStat;
-                                else { // a number
+                                else if (stat.startsWith("p")) { // a percentile (e.g. p90)
+                                    ttStat = PctTTStat;
+                                    ttPercentile = qBound(0.0, stat.mid(1).toDouble() / 100.0, 1.0);
+                                } else { // a number
                                     ttStat = AvgTTStat;
                                     travelTime = stat.toDouble();
                                 }
@@ -97,23 +138,57 @@ public slots:
                             }
                         }
 
-                        AllocationParams params(deadline,nbFacilities,delFactor,ttStat,dStat,travelTime,distance,method);
+                        // number of threads to score the candidates (-1 for the ideal thread count)
+                        int nbThreads = -1;
+                        if (query.hasQueryItem("nbThreads"))
+                            nbThreads = query.queryItemValue("nbThreads").toInt();
+
+                        AllocationParams params(deadline,nbFacilities,delFactor,ttStat,dStat,travelTime,distance,method,nbThreads,ttPercentile);
+
+                        // time budget (s) of the exact method, the best allocation found is returned with its gap
+                        if (query.hasQueryItem("timeBudget"))
+                            params.timeBudget = query.queryItemValue("timeBudget").toDouble();
 
                         /* run the allocation function */
                         Loader l;
                         ProgressConsole p;
                         connect(&l, &Loader::loadProgressChanged, &p, &ProgressConsole::updateProgress);
-                        QFuture<bool> future = l.load(_computeAllocation, &ComputeAllocation::processAllocationMethod, &l, &params, &allocation);
+                        QFuture<bool> future = l.load(computeAllocation, &ComputeAllocation::processAllocationMethod, &l, &params, &allocation);
                         future.result(); // wait for the results
 
                         originalReq = QString(
-                                "{\"method\":\"%1\",\"nbFacilities\":\"%2\",\"deadline\":\"%3\",\"delFactor\":\"%4\",\"travelTime\":\"%5\",\"distance\":\"%6\"}").arg(
+                                "{\"method\":\"%1\",\"nbFacilities\":\"%2\",\"deadline\":\"%3\",\"delFactor\":\"%4\",\"travelTime\":\"%5\",\"distance\":\"%6\",\"nbThreads\":\"%7\",\"start\":\"%8\",\"end\":\"%9\"}").arg(
                                 method, QString::number(nbFacilities), QString::number(deadline),
-                                QString::number(delFactor), QString::number(travelTime), QString::number(distance));
-
-                    } else if (method == PAGE_RANK_MEHTOD_NAME) { // page rank
+                                QString::number(delFactor), QString::number(travelTime), QString::number(distance),
+                                QString::number(nbThreads), QString::number(start), QString::number(end));
+
+                        if (method == EXACT_MCLP_METHOD_NAME) {
+                            originalReq = originalReq.left(originalReq.size() - 1) +
+                                    QString(",\"timeBudget\":\"%1\"}").arg(QString::number(params.timeBudget));
+                            results = QString(", \"objective\":\"%1\", \"upperBound\":\"%2\", \"optimalityGap\":\"%3\"").arg(
+                                    QString::number(params.objective), QString::number(params.upperBound),
+                                    QString::number(params.optimalityGap));
+                        }
 
                     } else if (method == K_MEANS_MEHTOD_NAME) { // kmeans
+                        int nbFacilities = query.queryItemValue("nbFacilities").toInt();
+
+                        // number of threads to assign the points (-1 for the ideal thread count)
+                        int nbThreads = -1;
+                        if (query.hasQueryItem("nbThreads"))
+                            nbThreads = query.queryItemValue("nbThreads").toInt();
+
+                        AllocationParams params(0,nbFacilities,0.0,NoneTTStat,NoneDStat,0.0,0.0,method,nbThreads);
+
+                        Loader l;
+                        ProgressConsole p;
+                        connect(&l, &Loader::loadProgressChanged, &p, &ProgressConsole::updateProgress);
+                        QFuture<bool> future = l.load(computeAllocation, &ComputeAllocation::processAllocationMethod, &l, &params, &allocation);
+                        future.result(); // wait for the results
+
+                        originalReq = QString("{\"method\":\"%1\",\"nbFacilities\":\"%2\",\"nbThreads\":\"%3\",\"start\":\"%4\",\"end\":\"%5\"}").arg(
+                                method, QString::number(nbFacilities), QString::number(nbThreads),
+                                QString::number(start), QString::number(end));
 
                     } else if (method == RANDOM_METHOD_NAME) { // random
                         int nbFacilities = query.queryItemValue("nbFacilities").toInt();
@@ -122,7 +197,7 @@ public slots:
                         Loader l;
                         ProgressConsole p;
                         connect(&l, &Loader::loadProgressChanged, &p, &ProgressConsole::updateProgress);
-                        QFuture<bool> future = l.load(_computeAllocation, &ComputeAllocation::runRandomAllocation, &l, nbFacilities, &allocation);
+                        QFuture<bool> future = l.load(computeAllocation, &ComputeAllocation::runRandomAllocation, &l, nbFacilities, &allocation);
                         future.result(); // wait for the results
 
                         originalReq = QString("{\"method\":\"%1\",\"nbFacilities\":\"%2\"}").arg(method,
@@ -130,8 +205,8 @@ public slots:
                     }
 
                     QString allocationStr = constructResponse(allocation);
-                    QString respBody = QString("{\"originalReq\":%1, \"allocationResult\":%2}").arg(originalReq,
-                                                                                                    allocationStr);
+                    QString respBody = QString("{\"originalReq\":%1, \"allocationResult\":%2%3}").arg(originalReq,
+                                                                                                      allocationStr, results);
                     res->setStatusCode(qhttp::ESTATUS_OK);
                     res->addHeader("Content-Type", "application/json");
                     res->end(respBody.toUtf8());
@@ -0,0 +1,77 @@
+//
+// R-tree of geometry bounds, bulk loaded with the Sort-Tile-Recursive algorithm
+//
+
+#include "rtree.h"
+
+#include <algorithm>
+#include <qmath.h>
+
+/* Sorts the items in STR order: by x, then by y in each vertical slice of nbSlices * capacity items */
+template<typename T, typename BoxOf>
+static void sortTiles(QVector<T>* items, int capacity, BoxOf boxOf) {
+    int n = items->size();
+    int nbNodes = (n + capacity - 1) / capacity;
+    int sliceSize = qCeil(qSqrt(nbNodes)) * capacity;
+
+    std::sort(items->begin(), items->end(), [&boxOf](const T& a, const T& b) {
+        return boxOf(a).centerX() < boxOf(b).centerX();
+    });
+    for(int start = 0; start < n; start += sliceSize) {
+        std::sort(items->begin() + start, items->begin() + qMin(n, start + sliceSize), [&boxOf](const T& a, const T& b) {
+            return boxOf(a).centerY() < boxOf(b).centerY();
+        });
+    }
+}
+
+RTree::RTree(const QVector<Entry>& entries, int nodeCapacity):
+        _nodeCapacity(qMax(2, nodeCapacity)), _entries(entries) {
+    if(_entries.isEmpty())
+        return;
+
+    // pack the entries in the leaves
+    sortTiles(&_entries, _nodeCapacity, [](const Entry& e) -> const Box& { return e.box; });
+    QVector<Node> level;
+    for(int i = 0; i < _entries.size(); i += _nodeCapacity) {
+        Node node;
+        node.first = i;
+        node.count = qMin(_nodeCapacity, _entries.size() - i);
+        node.leaf  = true;
+        node.box   = _entries.at(i).box;
+        for(int j = i + 1; j < i + node.count; ++j) {
+            node.box.unite(_entries.at(j).box);
+        }
+        level.append(node);
+    }
+
+    // pack each level in the nodes of the level above, up to the root
+    while(level.size() > 1) {
+        sortTiles(&level, _nodeCapacity, [](const Node& n) -> const Box& { return n.box; });
+        int offset = _nodes.size();
+        _nodes += level;
+
+        QVector<Node> parents;
+        for(int i = 0; i < level.size(); i += _nodeCapacity) {
+            Node node;
+            node.first = offset + i;
+            node.count = qMin(_nodeCapacity, level.size() - i);
+            node.leaf  = false;
+            node.box   = level.at(i).box;
+            for(int j = i + 1; j < i + node.count; ++j) {
+                node.box.unite(level.at(j).box);
+            }
+            parents.append(node);
+        }
+        level = parents;
+    }
+    _nodes += level;
+}
+
+QList<QRectF> RTree::getLeafBounds() const {
+    QList<QRectF> bounds;
+    for(const Node& node : _nodes) {
+        if(node.leaf)
+            bounds.append(QRectF(node.box.minX, node.box.minY, node.box.maxX - node.box.minX, node.box.maxY - node.box.minY));
+    }
+    return bounds;
+}
@@ -0,0 +1,136 @@
+//
+// R-tree of geometry bounds, bulk loaded with the Sort-Tile-Recursive algorithm
+//
+
+#ifndef LOCALL_RTREE_H
+#define LOCALL_RTREE_H
+
+#include <QVector>
+#include <QRectF>
+#include <QVarLengthArray>
+#include <QPair>
+#include <qmath.h>
+#include <queue>
+#include <functional>
+
+// forward class declaration
+class Geometry;
+
+/* Static R-tree of the bounds of a set of geometries. The tree is packed with STR
+ * (Leutenegger et al., 1997): the entries are sorted in vertical slices then by y in each slice,
+ * and each run of "nodeCapacity" entries (resp. nodes) forms a node of the level above. */
+class RTree {
+public:
+    struct Box {
+        double minX, maxX, minY, maxY;
+
+        bool contains(double x, double y) const {
+            return x >= minX && x <= maxX && y >= minY && y <= maxY;
+        }
+        bool intersects(const Box& b) const {
+            return b.minX <= maxX && b.maxX >= minX && b.minY <= maxY && b.maxY >= minY;
+        }
+        void unite(const Box& b) {
+            minX = qMin(minX, b.minX); maxX = qMax(maxX, b.maxX);
+            minY = qMin(minY, b.minY); maxY = qMax(maxY, b.maxY);
+        }
+        double centerX() const { return (minX + maxX) / 2; }
+        double centerY() const { return (minY + maxY) / 2; }
+        /* Distance from the point (x,y) to the box (0 inside) */
+        double distance(double x, double y) const {
+            double dx = qMax(qMax(minX - x, x - maxX), 0.0);
+            double dy = qMax(qMax(minY - y, y - maxY), 0.0);
+            return qSqrt(dx * dx + dy * dy);
+        }
+    };
+
+    struct Entry {
+        Box box;
+        Geometry* geom;
+        int id;     // id of the geometry for the caller
+    };
+
+    RTree(const QVector<Entry>& entries, int nodeCapacity = 16);
+
+    /* Calls visitor(const Entry&) for each entry whose bounds contain the point (x,y) */
+    template<typename Visitor>
+    void search(double x, double y, Visitor visitor) const {
+        searchNodes([x, y](const Box& box) { return box.contains(x, y); }, visitor);
+    }
+
+    /* Calls visitor(const Entry&) for each entry whose bounds intersect "box" */
+    template<typename Visitor>
+    void search(const Box& box, Visitor visitor) const {
+        searchNodes([&box](const Box& b) { return b.intersects(box); }, visitor);
+    }
+
+    /* Calls visitor(const Entry&, distance) on the entries by increasing distance(const Entry&) from
+     * the point (x,y), as long as the visitor returns true (best-first search). The distance of an
+     * entry must not be smaller than the distance from the point to its box. */
+    template<typename Distance, typename Visitor>
+    void nearest(double x, double y, Distance distance, Visitor visitor) const {
+        if(_nodes.isEmpty())
+            return;
+        // <distance, node id or -(entry id)-1>, the closest first
+        std::priority_queue<QPair<double, int>, std::vector<QPair<double, int>>, std::greater<QPair<double, int>>> queue;
+        queue.push(qMakePair(_nodes.last().box.distance(x, y), _nodes.size() - 1));
+        while(!queue.empty()) {
+            QPair<double, int> item = queue.top();
+            queue.pop();
+            if(item.second < 0) {
+                if(!visitor(_entries.at(-item.second - 1), item.first))
+                    return;
+                continue;
+            }
+            const Node& node = _nodes.at(item.second);
+            for(int i = node.first; i < node.first + node.count; ++i) {
+                if(node.leaf)
+                    queue.push(qMakePair(distance(_entries.at(i)), -i - 1));
+                else
+                    queue.push(qMakePair(_nodes.at(i).box.distance(x, y), i));
+            }
+        }
+    }
+
+    int size() const { return _entries.size(); }
+    const QVector<Entry>& getEntries() const { return _entries; }
+    /* Bounds of the leaves of the tree */
+    QList<QRectF> getLeafBounds() const;
+
+private:
+    struct Node {
+        Box box;
+        int first;   // first child (node or entry for the leaves)
+        int count;   // number of children
+        bool leaf;
+    };
+
+    int _nodeCapacity;
+    QVector<Entry> _entries;    // entries in the order of the leaves
+    QVector<Node> _nodes;       // nodes, the children of a node are contiguous, the root is the last node
+
+    template<typename Match, typename Visitor>
+    void searchNodes(Match match, Visitor visitor) const {
+        if(_nodes.isEmpty())
+            return;
+        QVarLengthArray<int, 64> stack;
+        stack.append(_nodes.size() - 1);
+        while(!stack.isEmpty()) {
+            const Node& node = _nodes.at(stack.last());
+            stack.removeLast();
+            if(!match(node.box))
+                continue;
+            for(int i = node.first; i < node.first + node.count; ++i) {
+                if(node.leaf) {
+                    const Entry& entry = _entries.at(i);
+                    if(match(entry.box))
+                        visitor(entry);
+                } else {
+                    stack.append(i);
+                }
+            }
+        }
+    }
+};
+
+#endif //LOCALL_RTREE_H
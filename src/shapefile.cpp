@@ -49,12 +49,12 @@ QSet<QPointF> Shapefile::getIntersections(double maxAngle) {
     return intersections;
 }
 
-GeometryIndex* Shapefile::makeGeometryIndex(int cellSize) {
+GeometryIndex* Shapefile::makeGeometryIndex(int cellSize, GeometryIndexType indexType) {
     QSet<Geometry*> geometries;
     for(auto it = _features.begin(); it != _features.end(); ++it) {
         geometries.insert(it.value()->geometry);
     }
-    return new GeometryIndex(geometries, cellSize);
+    return new GeometryIndex(geometries, cellSize, indexType);
 }
 
 
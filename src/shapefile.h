@@ -130,7 +130,8 @@ public:
         return &_attributes;
     }
 
-    GeometryIndex* makeGeometryIndex(int cellSize = 100);
+    /* Index of the feature geometries (R-tree by default, the features have very different sizes) */
+    GeometryIndex* makeGeometryIndex(int cellSize = 100, GeometryIndexType indexType = RTreeIndexType);
 
 private:
     const QString _filename;
@@ -0,0 +1,642 @@
+//
+// Binary snapshot (.locall) of a projected trace and of its spatial stats
+//
+
+#include "snapshot.h"
+
+#include <cstring>
+#include <QFile>
+
+#include "spatial_stats.h"
+#include "geometry_index.h"
+#include "getis_ord.h"
+#include "trace.h"
+#include "loader.h"
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'L','O','C','A','L','L','\0','\0'};
+const quint32 BYTE_ORDER_MARK = 0x01020304;
+const int CHUNK_SIZE = 64 << 20; // bytes per chunk of a section in memory (a QByteArray holds less than 2 GB)
+
+enum SectionId : quint32 {
+    MetaSection = 0,
+    TraceNameSection,       // UTF-8 name of the trace
+    NodeNamesSection,       // UTF-8 node names, one after the other
+    NodeNameOffsetsSection, // qint64[nbNodes+1], offsets in NodeNamesSection
+    NodeOffsetsSection,     // qint64[nbNodes+1], offsets in the position columns
+    TimestampsSection,      // qint64[nbPositions]
+    XsSection,              // double[nbPositions]
+    YsSection,              // double[nbPositions]
+    GeometriesSection,      // GeometryRecord[nbGeometries]
+    GeometryPointsSection,  // double[], points of the polygons and paths
+    GeometryValuesSection,  // GeometryValueRecord[]
+    MatrixValuesSection,    // MatrixValueRecord[]
+    PoolSection,            // qint64[], variable-length lists of the values
+    NbSections
+};
+
+struct Header {
+    char magic[8];
+    quint32 byteOrder;
+    quint32 version;
+    quint32 nbSections;
+    quint32 reserved;
+};
+
+struct SectionEntry {
+    quint32 id;
+    quint32 reserved;
+    qint64 offset;
+    qint64 size;
+};
+
+struct MetaRecord {
+    qint64 sampling;
+    qint64 startTime;
+    qint64 endTime;
+    qint64 horizon;
+    double cellSize;
+    qint64 nbNodes;
+    qint64 nbPositions;
+    qint64 nbGeometries;
+};
+
+/* Part of the pool (offset and number of qint64) */
+struct Range {
+    qint64 offset;
+    qint64 count;
+};
+
+struct DistributionRecord {
+    Range values;           // (value, count) pairs
+    qint64 cummulativeSum;
+    double count;
+    double average;
+};
+
+struct GeometryRecord {
+    qint32 type;
+    qint32 reserved;
+    double values[4];       // Coord: x, y / Circle: x, y, radius / Cell: x, y, width, height
+    Range points;           // offset and count in GeometryPointsSection (polygons and paths)
+};
+
+struct GeometryValueRecord {
+    qint32 geom;
+    qint32 connections;
+    double localStat;
+    double medIncomingScore;
+    double avgIncomingScore;
+    double medScore;
+    double avgScore;
+    quint32 color;
+    quint32 reserved;
+    Range visits;           // (start, end) pairs
+    Range visitFrequency;
+    Range nodes;            // node ids of the trace
+    DistributionRecord interVisitDurationDist;
+    DistributionRecord travelTimes;
+};
+
+struct MatrixValueRecord {
+    qint32 geom1;
+    qint32 geom2;
+    double medScore;
+    double avgScore;
+    Range visits;           // (start, end) pairs
+    Range visitFrequency;
+    Range nodes;            // node ids of the trace
+    DistributionRecord travelTimeDist;
+    DistributionRecord interVisitDurationDist;
+};
+
+/* Builds the sections of the snapshot (in chunks, so that a section may exceed 2 GB) */
+class SnapshotWriter {
+public:
+    QVector<qint64> pool;   // written as the PoolSection, without copy
+
+    template<typename T>
+    void append(SectionId id, const T& record) {
+        append(id, (const char*) &record, sizeof(T));
+    }
+    template<typename T>
+    void append(SectionId id, const QVector<T>& records) {
+        append(id, (const char*) records.constData(), records.size() * (qint64) sizeof(T));
+    }
+    void append(SectionId id, const QByteArray& bytes) {
+        append(id, bytes.constData(), bytes.size());
+    }
+    void append(SectionId id, const char* bytes, qint64 size) {
+        QList<QByteArray>& chunks = _sections[id];
+        _sizes[id] += size;
+        while(size > 0) {
+            if(chunks.isEmpty() || chunks.last().size() >= CHUNK_SIZE)
+                chunks.append(QByteArray());
+            int n = (int) qMin(size, (qint64) (CHUNK_SIZE - chunks.last().size()));
+            chunks.last().append(bytes, n);
+            bytes += n;
+            size -= n;
+        }
+    }
+
+    /* Size (in bytes) of the section */
+    qint64 size(SectionId id) const {
+        return id == PoolSection ? pool.size() * (qint64) sizeof(qint64) : _sizes[id];
+    }
+
+    Range addVisits(const QMultiMap<long long, long long>& visits) {
+        Range r = {pool.size(), 2 * visits.size()};
+        for(auto it = visits.begin(); it != visits.end(); ++it) {
+            pool.append(it.key());
+            pool.append(it.value());
+        }
+        return r;
+    }
+    Range addList(const QList<long long>& values) {
+        Range r = {pool.size(), values.size()};
+        for(long long v : values) pool.append(v);
+        return r;
+    }
+    Range addNodes(const QSet<QString>& nodes, TraceStore* store) {
+        Range r = {pool.size(), 0};
+        for(const QString& node : nodes) {
+            int id = store->getNodeId(node);
+            if(id < 0) continue;
+            pool.append(id);
+            r.count++;
+        }
+        return r;
+    }
+    DistributionRecord addDistribution(const Distribution& dist) {
+        DistributionRecord d;
+        const QMap<int,int>& values = dist.getValues();
+        d.values = {pool.size(), 2 * values.size()};
+        for(auto it = values.begin(); it != values.end(); ++it) {
+            pool.append(it.key());
+            pool.append(it.value());
+        }
+        d.cummulativeSum = dist.getCummulativeSum();
+        d.count = dist.getCount();
+        d.average = const_cast<Distribution&>(dist).getAverage();
+        return d;
+    }
+
+    bool write(const QString& filename) {
+        QFile file(filename);
+        if(!file.open(QFile::WriteOnly | QFile::Truncate))
+            return false;
+
+        Header header;
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.byteOrder = BYTE_ORDER_MARK;
+        header.version = Snapshot::VERSION;
+        header.nbSections = NbSections;
+        header.reserved = 0;
+
+        // the sections follow the table, each one aligned on 8 bytes
+        QVector<SectionEntry> table(NbSections);
+        qint64 offset = sizeof(Header) + NbSections * sizeof(SectionEntry);
+        for(int i = 0; i < NbSections; ++i) {
+            offset = (offset + 7) & ~((qint64) 7);
+            table[i] = {(quint32) i, 0, offset, size((SectionId) i)};
+            offset += table[i].size;
+        }
+
+        file.write((const char*) &header, sizeof(Header));
+        file.write((const char*) table.constData(), NbSections * sizeof(SectionEntry));
+        qint64 pos = sizeof(Header) + NbSections * sizeof(SectionEntry);
+        for(int i = 0; i < NbSections; ++i) {
+            if(table[i].offset > pos)
+                file.write(QByteArray((int) (table[i].offset - pos), '\0'));
+            if(i == PoolSection)
+                file.write((const char*) pool.constData(), table[i].size);
+            for(const QByteArray& chunk : _sections[i])
+                file.write(chunk);
+            pos = table[i].offset + table[i].size;
+        }
+        return file.error() == QFile::NoError;
+    }
+
+private:
+    QList<QByteArray> _sections[NbSections];
+    qint64 _sizes[NbSections] = {};
+};
+
+/* Reads the sections of a mapped snapshot */
+class SnapshotReader {
+public:
+    const uchar* data = nullptr;
+    qint64 size = 0;
+    SectionEntry table[NbSections];
+
+    bool open(const uchar* d, qint64 s) {
+        data = d;
+        size = s;
+        if(size < (qint64) (sizeof(Header) + NbSections * sizeof(SectionEntry)))
+            return false;
+
+        const Header* header = (const Header*) data;
+        if(memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0
+           || header->byteOrder != BYTE_ORDER_MARK
+           || header->version != Snapshot::VERSION
+           || header->nbSections != NbSections)
+            return false;
+
+        memcpy(table, data + sizeof(Header), NbSections * sizeof(SectionEntry));
+        for(int i = 0; i < NbSections; ++i) {
+            if(table[i].offset < 0 || table[i].size < 0 || table[i].offset + table[i].size > size
+               || table[i].offset % 8 != 0)
+                return false;
+        }
+        return true;
+    }
+
+    template<typename T>
+    const T* records(SectionId id, qint64* count) const {
+        *count = table[id].size / (qint64) sizeof(T);
+        return (const T*) (data + table[id].offset);
+    }
+
+    QByteArray bytes(SectionId id) const {
+        return QByteArray::fromRawData((const char*) data + table[id].offset, (int) table[id].size);
+    }
+};
+
+/* Checks that the range is within the pool */
+bool isValid(const Range& r, qint64 poolSize) {
+    return r.offset >= 0 && r.count >= 0 && r.offset + r.count <= poolSize;
+}
+
+/* Checks that the offsets start at 0, never decrease and end at "end" */
+bool isValid(const qint64* offsets, qint64 nbOffsets, qint64 end) {
+    if(nbOffsets < 1 || offsets[0] != 0 || offsets[nbOffsets-1] != end)
+        return false;
+    for(qint64 i = 1; i < nbOffsets; ++i) {
+        if(offsets[i] < offsets[i-1])
+            return false;
+    }
+    return true;
+}
+
+}
+
+bool Snapshot::save(const QString& filename, SpatialStats* spatialStats, Loader* loader) {
+    Trace* trace = spatialStats->getTrace();
+    TraceStore* store = trace->getTraceStore();
+    loader->loadProgressChanged(0.0, "Save snapshot (trace)");
+
+    SnapshotWriter writer;
+
+    /* trace */
+    writer.append(TraceNameSection, trace->getName().toUtf8());
+    QVector<qint64> nameOffsets, nodeOffsets;
+    nameOffsets.append(0);
+    nodeOffsets.append(0);
+    for(int id = 0; id < store->getNbNodes(); ++id) {
+        writer.append(NodeNamesSection, store->getNodeName(id).toUtf8());
+        nameOffsets.append(writer.size(NodeNamesSection));
+
+        const NodeColumns& positions = store->getNode(id);
+        writer.append(TimestampsSection, positions.timestamps);
+        writer.append(XsSection, positions.xs);
+        writer.append(YsSection, positions.ys);
+        nodeOffsets.append(nodeOffsets.last() + positions.size());
+    }
+    writer.append(NodeNameOffsetsSection, nameOffsets);
+    writer.append(NodeOffsetsSection, nodeOffsets);
+
+    /* geometries */
+    loader->loadProgressChanged(0.3, "Save snapshot (geometries)");
+    QHash<Geometry*, GeometryValue*> geometries;
+    spatialStats->getGeometries(&geometries);
+    QHash<Geometry*, QHash<Geometry*, GeometryMatrixValue*>*> geometryMatrix;
+    spatialStats->getGeometryMatrix(&geometryMatrix);
+
+    // the indexed geometries in the order of their ids (restored with the same ids), then the others
+    GeometryIndex* geometryIndex = spatialStats->getGeometryIndex();
+    QList<Geometry*> allGeometries;
+    for(int id = 0; id < geometryIndex->size(); ++id) {
+        allGeometries.append(geometryIndex->getGeometry(id));
+    }
+    QSet<Geometry*> otherGeometries = geometries.keys().toSet();
+    for(auto it = geometryMatrix.begin(); it != geometryMatrix.end(); ++it) {
+        otherGeometries.insert(it.key());
+        otherGeometries.unite(it.value()->keys().toSet());
+    }
+    otherGeometries.subtract(allGeometries.toSet());
+    allGeometries.append(otherGeometries.toList());
+
+    QHash<Geometry*, int> geometryIds;
+    QVector<double> points;
+    for(Geometry* geom : allGeometries) {
+        GeometryRecord r;
+        memset(&r, 0, sizeof(GeometryRecord));
+        r.type = geom->getGeometryType();
+        r.points = {points.size(), 0};
+        switch(geom->getGeometryType()) {
+            case CoordGeometryType:
+            case CircleGeometryType:
+                r.values[0] = geom->getCenter().x();
+                r.values[1] = geom->getCenter().y();
+                if(geom->getGeometryType() == CircleGeometryType)
+                    r.values[2] = static_cast<Circle*>(geom)->getRadius();
+                break;
+            case CellGeometryType: {
+                Cell* cell = static_cast<Cell*>(geom);
+                r.values[0] = cell->x();
+                r.values[1] = cell->y();
+                r.values[2] = cell->width();
+                r.values[3] = cell->height();
+                break;
+            }
+            case PolygonGeometryType: {
+                Polygon* polygon = static_cast<Polygon*>(geom);
+                for(const QPointF& p : *polygon) {
+                    points.append(p.x());
+                    points.append(p.y());
+                }
+                r.points.count = points.size() - r.points.offset;
+                break;
+            }
+            case PathGeometryType: {
+                // (element type, x, y) of the elements of the path
+                Path* path = static_cast<Path*>(geom);
+                for(int i = 0; i < path->elementCount(); ++i) {
+                    QPainterPath::Element e = path->elementAt(i);
+                    points.append((double) e.type);
+                    points.append(e.x);
+                    points.append(e.y);
+                }
+                r.points.count = points.size() - r.points.offset;
+                break;
+            }
+            default:
+                continue;
+        }
+        geometryIds.insert(geom, geometryIds.size());
+        writer.append(GeometriesSection, r);
+    }
+    writer.append(GeometryPointsSection, points);
+
+    /* aggregates of the spatial stats */
+    loader->loadProgressChanged(0.5, "Save snapshot (spatial stats)");
+    for(auto it = geometries.begin(); it != geometries.end(); ++it) {
+        GeometryValue* val = it.value();
+        GeometryValueRecord r;
+        memset(&r, 0, sizeof(GeometryValueRecord));
+        r.geom = geometryIds.value(it.key());
+        r.connections = val->connections;
+        r.localStat = val->localStat;
+        r.medIncomingScore = val->medIncomingScore;
+        r.avgIncomingScore = val->avgIncomingScore;
+        r.medScore = val->medScore;
+        r.avgScore = val->avgScore;
+        r.color = val->color.rgba();
+        r.visits = writer.addVisits(val->visits);
+        r.visitFrequency = writer.addList(val->visitFrequency);
+        r.nodes = writer.addNodes(val->nodes, store);
+        r.interVisitDurationDist = writer.addDistribution(val->interVisitDurationDist);
+        r.travelTimes = writer.addDistribution(val->travelTimes);
+        writer.append(GeometryValuesSection, r);
+    }
+    for(auto it = geometryMatrix.begin(); it != geometryMatrix.end(); ++it) {
+        for(auto jt = it.value()->begin(); jt != it.value()->end(); ++jt) {
+            GeometryMatrixValue* val = jt.value();
+            MatrixValueRecord r;
+            memset(&r, 0, sizeof(MatrixValueRecord));
+            r.geom1 = geometryIds.value(it.key());
+            r.geom2 = geometryIds.value(jt.key());
+            r.medScore = val->medScore;
+            r.avgScore = val->avgScore;
+            r.visits = writer.addVisits(val->visits);
+            r.visitFrequency = writer.addList(val->visitFrequency);
+            r.nodes = writer.addNodes(val->nodes, store);
+            r.travelTimeDist = writer.addDistribution(val->travelTimeDist);
+            r.interVisitDurationDist = writer.addDistribution(val->interVisitDurationDist);
+            writer.append(MatrixValuesSection, r);
+        }
+    }
+
+    MetaRecord meta;
+    memset(&meta, 0, sizeof(MetaRecord));
+    meta.sampling = spatialStats->getSampling();
+    meta.startTime = spatialStats->getStartTime();
+    meta.endTime = spatialStats->getEndTime();
+    meta.horizon = spatialStats->getHorizon();
+    meta.cellSize = spatialStats->getCellSize();
+    meta.nbNodes = store->getNbNodes();
+    meta.nbPositions = nodeOffsets.last();
+    meta.nbGeometries = geometryIds.size();
+    writer.append(MetaSection, meta);
+
+    loader->loadProgressChanged(0.8, "Save snapshot (write)");
+    bool ok = writer.write(filename);
+    qDebug() << "[DONE] snapshot" << filename << (ok ? "saved" : "not saved");
+    loader->loadProgressChanged((qreal) 1.0, "Done");
+    return ok;
+}
+
+bool Snapshot::load(const QString& filename, Trace** trace, GeometryIndex** geometryIndex,
+                    SpatialStats** spatialStats, Loader* loader) {
+    loader->loadProgressChanged(0.0, "Load snapshot");
+
+    QFile file(filename);
+    if(!file.open(QFile::ReadOnly))
+        return false;
+    qint64 fileSize = file.size();
+    uchar* data = file.map(0, fileSize);
+    if(!data)
+        return false;
+
+    SnapshotReader reader;
+    qint64 count;
+    if(!reader.open(data, fileSize)
+       || reader.table[MetaSection].size != (qint64) sizeof(MetaRecord)) {
+        qWarning() << "Invalid snapshot" << filename;
+        file.unmap(data);
+        return false;
+    }
+    MetaRecord meta = *(reader.records<MetaRecord>(MetaSection, &count));
+
+    qint64 poolSize;
+    const qint64* pool = reader.records<qint64>(PoolSection, &poolSize);
+
+    /* trace */
+    qint64 nbNameOffsets, nbNodeOffsets, nbTimestamps, nbXs, nbYs;
+    const qint64* nameOffsets = reader.records<qint64>(NodeNameOffsetsSection, &nbNameOffsets);
+    const qint64* nodeOffsets = reader.records<qint64>(NodeOffsetsSection, &nbNodeOffsets);
+    const qint64* timestamps = reader.records<qint64>(TimestampsSection, &nbTimestamps);
+    const double* xs = reader.records<double>(XsSection, &nbXs);
+    const double* ys = reader.records<double>(YsSection, &nbYs);
+    QByteArray names = reader.bytes(NodeNamesSection);
+    if(nbNameOffsets != meta.nbNodes + 1 || nbNodeOffsets != meta.nbNodes + 1
+       || nbTimestamps != meta.nbPositions || nbXs != meta.nbPositions || nbYs != meta.nbPositions
+       || !isValid(nameOffsets, nbNameOffsets, names.size())
+       || !isValid(nodeOffsets, nbNodeOffsets, meta.nbPositions)) {
+        qWarning() << "Invalid snapshot (trace)" << filename;
+        file.unmap(data);
+        return false;
+    }
+
+    Trace* t = new Trace(QString::fromUtf8(reader.bytes(TraceNameSection)));
+    for(int id = 0; id < meta.nbNodes; ++id) {
+        QString node = QString::fromUtf8(names.mid((int) nameOffsets[id], (int) (nameOffsets[id+1] - nameOffsets[id])));
+        qint64 begin = nodeOffsets[id], end = nodeOffsets[id+1];
+        NodeColumns* positions = new NodeColumns();
+        positions->timestamps.resize((int) (end - begin));
+        positions->xs.resize((int) (end - begin));
+        positions->ys.resize((int) (end - begin));
+        memcpy(positions->timestamps.data(), timestamps + begin, (end - begin) * sizeof(qint64));
+        memcpy(positions->xs.data(), xs + begin, (end - begin) * sizeof(double));
+        memcpy(positions->ys.data(), ys + begin, (end - begin) * sizeof(double));
+        t->addNodeTrace(node, positions);
+    }
+    TraceStore* store = t->getTraceStore();
+
+    /* geometries */
+    loader->loadProgressChanged(0.3, "Load snapshot (geometries)");
+    qint64 nbGeometries, nbPoints;
+    const GeometryRecord* geometryRecords = reader.records<GeometryRecord>(GeometriesSection, &nbGeometries);
+    const double* points = reader.records<double>(GeometryPointsSection, &nbPoints);
+    QVector<Geometry*> geometries;
+    geometries.reserve((int) nbGeometries);
+    for(qint64 i = 0; i < nbGeometries; ++i) {
+        const GeometryRecord& r = geometryRecords[i];
+        const double* v = r.values;
+        Geometry* geom = nullptr;
+        if(!isValid(r.points, nbPoints))
+            continue;
+        switch(r.type) {
+            case CoordGeometryType:  geom = new Coord(v[0], v[1]); break;
+            case CircleGeometryType: geom = new Circle(v[0], v[1], v[2]); break;
+            case CellGeometryType:   geom = new Cell(QRectF(v[0], v[1], v[2], v[3])); break;
+            case PolygonGeometryType: {
+                QPolygonF polygon;
+                for(qint64 j = r.points.offset; j + 1 < r.points.offset + r.points.count; j += 2)
+                    polygon.append(QPointF(points[j], points[j+1]));
+                geom = new Polygon(polygon);
+                break;
+            }
+            case PathGeometryType: {
+                QPainterPath path;
+                for(qint64 j = r.points.offset; j + 2 < r.points.offset + r.points.count; j += 3) {
+                    QPointF p(points[j+1], points[j+2]);
+                    int type = (int) points[j];
+                    if(type == QPainterPath::MoveToElement) {
+                        path.moveTo(p);
+                    } else if(type == QPainterPath::LineToElement) {
+                        path.lineTo(p);
+                    } else if(type == QPainterPath::CurveToElement && j + 8 < r.points.offset + r.points.count) {
+                        // a curve is followed by its two curve data elements
+                        path.cubicTo(p, QPointF(points[j+4], points[j+5]), QPointF(points[j+7], points[j+8]));
+                        j += 6;
+                    }
+                }
+                geom = new Path(path);
+                break;
+            }
+            default:
+                break;
+        }
+        geometries.append(geom);
+    }
+    if(geometries.size() != meta.nbGeometries) {
+        qWarning() << "Invalid snapshot (geometries)" << filename;
+        file.unmap(data);
+        return false;
+    }
+    QList<Geometry*> geometryList; // in the order of the records (the ids of the saved index)
+    for(Geometry* geom : geometries)
+        if(geom) geometryList.append(geom);
+    GeometryIndex* index = new GeometryIndex(geometryList, meta.cellSize);
+
+    SpatialStats* stats = new SpatialStats(t, meta.sampling, meta.startTime, meta.endTime, index);
+    stats->setHorizon(meta.horizon);
+
+    /* aggregates of the spatial stats */
+    loader->loadProgressChanged(0.6, "Load snapshot (spatial stats)");
+    auto geometryAt = [&](qint32 id) -> Geometry* {
+        return (id >= 0 && id < geometries.size()) ? geometries.at(id) : nullptr;
+    };
+    auto isValidDist = [&](const DistributionRecord& d) { return isValid(d.values, poolSize); };
+    auto restoreVisits = [&](const Range& r, QMultiMap<long long, long long>* visits) {
+        // insert the visits in reverse, the most recent value of a key comes first in the map
+        for(qint64 j = r.offset + r.count - 2; j >= r.offset; j -= 2)
+            visits->insert(pool[j], pool[j+1]);
+    };
+    auto restoreList = [&](const Range& r, QList<long long>* values) {
+        values->reserve((int) r.count);
+        for(qint64 j = r.offset; j < r.offset + r.count; ++j)
+            values->append(pool[j]);
+    };
+    auto restoreNodes = [&](const Range& r, QSet<QString>* nodes) {
+        for(qint64 j = r.offset; j < r.offset + r.count; ++j)
+            if(pool[j] >= 0 && pool[j] < store->getNbNodes())
+                nodes->insert(store->getNodeName((int) pool[j]));
+    };
+    auto restoreDistribution = [&](const DistributionRecord& d, Distribution* dist) {
+        QMap<int,int> values;
+        for(qint64 j = d.values.offset; j + 1 < d.values.offset + d.values.count; j += 2)
+            values.insert((int) pool[j], (int) pool[j+1]);
+        dist->restore(values, (int) d.cummulativeSum, d.count, d.average);
+    };
+
+    qint64 nbValues;
+    const GeometryValueRecord* valueRecords = reader.records<GeometryValueRecord>(GeometryValuesSection, &nbValues);
+    for(qint64 i = 0; i < nbValues; ++i) {
+        const GeometryValueRecord& r = valueRecords[i];
+        Geometry* geom = geometryAt(r.geom);
+        if(!geom || !isValid(r.visits, poolSize) || !isValid(r.visitFrequency, poolSize) || !isValid(r.nodes, poolSize)
+           || !isValidDist(r.interVisitDurationDist) || !isValidDist(r.travelTimes))
+            continue;
+        GeometryValue* val = new GeometryValue(geom);
+        val->connections = r.connections;
+        val->localStat = r.localStat;
+        val->localStatPValue = GetisOrd::pValue(r.localStat);
+        val->medIncomingScore = r.medIncomingScore;
+        val->avgIncomingScore = r.avgIncomingScore;
+        val->medScore = r.medScore;
+        val->avgScore = r.avgScore;
+        val->color = QColor::fromRgba(r.color);
+        restoreVisits(r.visits, &val->visits);
+        restoreList(r.visitFrequency, &val->visitFrequency);
+        restoreNodes(r.nodes, &val->nodes);
+        restoreDistribution(r.interVisitDurationDist, &val->interVisitDurationDist);
+        restoreDistribution(r.travelTimes, &val->travelTimes);
+        stats->_geometries.insert(geom, val);
+    }
+
+    qint64 nbMatrixValues;
+    const MatrixValueRecord* matrixRecords = reader.records<MatrixValueRecord>(MatrixValuesSection, &nbMatrixValues);
+    for(qint64 i = 0; i < nbMatrixValues; ++i) {
+        const MatrixValueRecord& r = matrixRecords[i];
+        Geometry* geom1 = geometryAt(r.geom1);
+        Geometry* geom2 = geometryAt(r.geom2);
+        if(!geom1 || !geom2 || !isValid(r.visits, poolSize) || !isValid(r.visitFrequency, poolSize) || !isValid(r.nodes, poolSize)
+           || !isValidDist(r.travelTimeDist) || !isValidDist(r.interVisitDurationDist))
+            continue;
+        GeometryMatrixValue* val = new GeometryMatrixValue(geom1, geom2);
+        val->medScore = r.medScore;
+        val->avgScore = r.avgScore;
+        restoreVisits(r.visits, &val->visits);
+        restoreList(r.visitFrequency, &val->visitFrequency);
+        restoreNodes(r.nodes, &val->nodes);
+        restoreDistribution(r.travelTimeDist, &val->travelTimeDist);
+        restoreDistribution(r.interVisitDurationDist, &val->interVisitDurationDist);
+        if(!stats->_geometryMatrix.contains(geom1))
+            stats->_geometryMatrix.insert(geom1, new QHash<Geometry*, GeometryMatrixValue*>());
+        stats->_geometryMatrix.value(geom1)->insert(geom2, val);
+    }
+
+    file.unmap(data);
+
+    *trace = t;
+    *geometryIndex = index;
+    *spatialStats = stats;
+
+    qDebug() << "[DONE] snapshot" << filename << "loaded" << meta.nbNodes << "nodes"
+             << stats->_geometries.size() << "geometries";
+    loader->loadProgressChanged((qreal) 1.0, "Done");
+    return true;
+}
@@ -0,0 +1,33 @@
+//
+// Binary snapshot (.locall) of a projected trace and of its spatial stats
+//
+
+#ifndef LOCALL_SNAPSHOT_H
+#define LOCALL_SNAPSHOT_H
+
+#include <QString>
+
+// forward class declarations
+class Trace;
+class GeometryIndex;
+class SpatialStats;
+class Loader;
+
+/* Snapshot file: a header, a table of sections, then the sections (arrays of fixed-size
+ * records, aligned on 8 bytes, in the byte order of the machine that wrote them), so that
+ * the file is read from a memory mapping without parsing.
+ * It holds the projected positions of the trace, the geometries of the index and the
+ * aggregates computed by SpatialStats::computeStats (the mobile nodes are not saved). */
+class Snapshot {
+public:
+    static const quint32 VERSION = 1;
+
+    /* Saves the trace, the geometries and the stats of "spatialStats" (computed) in "filename" */
+    static bool save(const QString& filename, SpatialStats* spatialStats, Loader* loader);
+
+    /* Loads the snapshot "filename", returns false if it is not a valid snapshot of the current version */
+    static bool load(const QString& filename, Trace** trace, GeometryIndex** geometryIndex,
+                     SpatialStats** spatialStats, Loader* loader);
+};
+
+#endif //LOCALL_SNAPSHOT_H
@@ -1,5 +1,10 @@
 #include "spatial_stats.h"
 
+#include <QElapsedTimer>
+#include <QStack>
+
+#include "getis_ord.h"
+
 SpatialStats::SpatialStats(Trace* trace,
                            long long sampling,
                            long long startTime,
@@ -11,35 +16,56 @@ SpatialStats::SpatialStats(Trace* trace,
     _endTime(endTime),
     _geometryIndex(geometryIndex) { }
 
+SpatialStats::~SpatialStats() {
+    // the windows are released with their shared pointers (deleted once no request uses them)
+    for(auto it = _geometryMatrix.begin(); it != _geometryMatrix.end(); ++it) {
+        qDeleteAll(*it.value());
+        delete it.value();
+    }
+    qDeleteAll(_geometries);
+    qDeleteAll(_mobileNodes);
+    for(VisitMatrixShard* shard : _buckets) {
+        for(auto it = shard->geometryMatrix.begin(); it != shard->geometryMatrix.end(); ++it) {
+            qDeleteAll(*it.value());
+            delete it.value();
+        }
+        qDeleteAll(shard->geometries);
+        delete shard;
+    }
+    delete _coverageMatrix.loadAcquire();
+}
+
 void SpatialStats::populateMobileNodes(Loader* loader) {
     QString currentMsg = "Populate the nodes ("
                          +QString::number(_startTime)+" -> "+QString::number(_endTime)
                          +", "+QString::number(_sampling)+")";
 
     // add the successive point positions of the mobile nodes
-    QHash<QString, QMap<long long, QPointF>*> nodes;
-    _trace->getNodes(&nodes);
+    TraceStore* store = _trace->getTraceStore();
+    int nbNodes = store->getNbNodes();
 
     int count = 0;
-    for(auto it = nodes.begin(); it != nodes.end(); ++it) {
-        QString nodeId = it.key();
-        if(!_mobileNodes.contains(nodeId) && it.value()->size() > 0) {
+    for(int id = 0; id < nbNodes; ++id) {
+        const NodeColumns& positions = store->getNode(id);
+        QString nodeId = store->getNodeName(id);
+        if(positions.isEmpty())
+            continue;
+        if(!_mobileNodes.contains(nodeId)) {
             _mobileNodes.insert(nodeId, new MobileNode(nodeId, (int) _sampling, this));
         }
         MobileNode* node = _mobileNodes.value(nodeId);
-        if(it.value()->lastKey() < _startTime)
+        if(positions.timestamps.last() < _startTime)
             continue;
 
-        auto jt = (_startTime == -1) ? it.value()->begin() : it.value()->lowerBound(_startTime);
-        for(; jt != it.value()->end(); ++jt) {
-            if(_endTime != -1 && jt.key() > _endTime) break;
-            long long ts = jt.key();
-            QPointF pos = jt.value();
-            node->addPosition(ts, pos.x(), pos.y());
+        int j = (_startTime == -1) ? 0 : positions.lowerBound(_startTime);
+        for(; j < positions.size(); ++j) {
+            long long ts = positions.timestamps.at(j);
+            if(_endTime != -1 && ts > _endTime) break;
+            node->addPosition(ts, positions.xs.at(j), positions.ys.at(j));
         }
 
         count++;
-        loader->loadProgressChanged(0.10 * ((qreal) count / (qreal) nodes.size()), currentMsg);
+        loader->loadProgressChanged(0.10 * ((qreal) count / (qreal) nbNodes), currentMsg);
 //        if(loader) {
 //            loader->loadProgressChanged();
 //            loader->changeText(currentMsg);
@@ -49,69 +75,280 @@ void SpatialStats::populateMobileNodes(Loader* loader) {
     }
 }
 
-void SpatialStats::computeVisitMatrix(QString& node) {
+long long SpatialStats::getBucket(long long time) const {
+    if(_bucketSize <= 0)
+        return 0;
+    return time >= 0 ? time / _bucketSize : (time - _bucketSize + 1) / _bucketSize;
+}
+
+void SpatialStats::computeVisitMatrix(QString& node, QHash<long long, VisitMatrixShard*>* shards) {
     MobileNode* mobileNode = _mobileNodes.value(node);
-    auto geoms = mobileNode->getGeometries(); // get the set of geometries the node visits
+    VisitView visits = mobileNode->getVisits(); // visits of the node, sorted by start time
     qDebug() << "Node" << mobileNode->getId();
-    for(auto it = geoms.begin(); it != geoms.end(); ++it) {
-        long long start1 = it.key();
-
-        // loop through the geometries visited at the same start time start1
-        for (auto kt = it.value()->begin(); kt != it.value()->end(); ++kt) {
-            Geometry *geom1 = kt.key();
-            long long end1 = kt.value();
-
-            _geometriesMutex.lock();
-            // add the ogrGeometry to the set of visited geometries
-            if (!_geometries.contains(geom1))
-                _geometries.insert(geom1, new GeometryValue(geom1));
-
-            // update the corresponding ogrGeometry value
-            GeometryValue *val = _geometries.value(geom1);
-            val->visits.insert(start1, end1);
-            val->visitFrequency.append(start1);
-            val->nodes.insert(mobileNode->getId());
-            _geometriesMutex.unlock();
-
-            // examine the subsequent visited geometries
-            QSet<Geometry *> visitedGeometries; // remember the cells the node visited
-            // to avoid accounting for them multiple times
-            for (auto jt = it + 1; jt != geoms.end(); ++jt) {
-                long long start2 = jt.key();
-
-                // loop through the geometries visited at the same start time start2
-                for (auto lt = jt.value()->begin(); lt != jt.value()->end(); ++lt) {
-                    Geometry *geom2 = lt.key();
-                    long long end2 = lt.value();
-
-                    // stop when the node visits the same starting ogrGeometry again
-                    if (geom1 == geom2) break;
-
-                    // do not take account already visited geometries
-                    if (visitedGeometries.contains(geom2))
-                        continue;
-
-                    _geometryMatrixMutex.lock();
-                    // add the ogrGeometry to the matrix of visited geometries
-                    if (!_geometryMatrix.contains(geom1)) {
-                        _geometryMatrix.insert(geom1, new QHash<Geometry *, GeometryMatrixValue *>());
-                    }
-                    if (!_geometryMatrix.value(geom1)->contains(geom2)) {
-                        _geometryMatrix.value(geom1)->insert(geom2, new GeometryMatrixValue(geom1, geom2));
-                    }
 
-                    GeometryMatrixValue *matVal = _geometryMatrix.value(geom1)->value(geom2);
-                    matVal->travelTimeDist.addValue((int) qMax((long long) 0, start2 - start1));
-                    matVal->visitFrequency.append(start1);
-                    matVal->visits.insert(start1, end1);
-                    matVal->nodes.insert(mobileNode->getId());
-                    _geometryMatrixMutex.unlock();
+    // last outer visit for which each geometry was accounted (avoids accounting for it multiple times)
+    QHash<Geometry*, int> lastSeen;
+    int visit = 0;
+    int next = 0; // first visit that starts after start1
+    for(int i = 0; i < visits.size(); ++i) {
+        long long start1 = visits.at(i).start;
+        Geometry *geom1 = visits.at(i).geom;
+        long long end1 = visits.at(i).end;
+        while(next < visits.size() && visits.at(next).start <= start1)
+            next++;
+
+        // the visits are accounted in the time bucket of their start time
+        VisitMatrixShard*& shard = (*shards)[getBucket(start1)];
+        if (!shard)
+            shard = new VisitMatrixShard();
+
+        // add the ogrGeometry to the set of visited geometries
+        if (!shard->geometries.contains(geom1))
+            shard->geometries.insert(geom1, new GeometryValue(geom1));
+
+        // update the corresponding ogrGeometry value
+        GeometryValue *val = shard->geometries.value(geom1);
+        val->visits.insert(start1, end1);
+        val->visitFrequency.append(start1);
+        val->nodes.insert(mobileNode->getId());
+
+        // add the ogrGeometry to the matrix of visited geometries
+        QHash<Geometry *, GeometryMatrixValue *>* row = shard->geometryMatrix.value(geom1, nullptr);
+
+        // examine the subsequent visited geometries
+        visit++;
+        for (int j = next; j < visits.size(); ++j) {
+            long long start2 = visits.at(j).start;
+            Geometry *geom2 = visits.at(j).geom;
+
+            // the subsequent visits are beyond the horizon
+            if (_horizon > 0 && start2 - start1 > _horizon) break;
+
+            // stop when the node visits the same starting ogrGeometry again
+            // (skip the other visits with the same start time start2)
+            if (geom1 == geom2) {
+                while (j + 1 < visits.size() && visits.at(j+1).start == start2)
+                    j++;
+                continue;
+            }
+
+            // do not take account already visited geometries
+            if (lastSeen.value(geom2, 0) == visit)
+                continue;
+
+            if (!row) {
+                row = new QHash<Geometry *, GeometryMatrixValue *>();
+                shard->geometryMatrix.insert(geom1, row);
+            }
+            if (!row->contains(geom2)) {
+                row->insert(geom2, new GeometryMatrixValue(geom1, geom2));
+            }
+
+            GeometryMatrixValue *matVal = row->value(geom2);
+            matVal->travelTimeDist.addValue((int) qMax((long long) 0, start2 - start1));
+            matVal->visitFrequency.append(start1);
+            matVal->visits.insert(start1, end1);
+            matVal->nodes.insert(mobileNode->getId());
+
+            lastSeen.insert(geom2, visit);
+        }
+    }
+}
+
+void VisitMatrixShard::merge(VisitMatrixShard* other) {
+    for(auto it = other->geometries.begin(); it != other->geometries.end(); ++it) {
+        GeometryValue* val = geometries.value(it.key(), nullptr);
+        if(val) {
+            val->merge(*it.value());
+            delete it.value();
+        } else {
+            geometries.insert(it.key(), it.value());
+        }
+    }
+    for(auto it = other->geometryMatrix.begin(); it != other->geometryMatrix.end(); ++it) {
+        QHash<Geometry*, GeometryMatrixValue*>* row = geometryMatrix.value(it.key(), nullptr);
+        if(!row) {
+            geometryMatrix.insert(it.key(), it.value());
+            continue;
+        }
+        for(auto jt = it.value()->begin(); jt != it.value()->end(); ++jt) {
+            GeometryMatrixValue* matVal = row->value(jt.key(), nullptr);
+            if(matVal) {
+                matVal->merge(*jt.value());
+                delete jt.value();
+            } else {
+                row->insert(jt.key(), jt.value());
+            }
+        }
+        delete it.value();
+    }
+    other->geometries.clear();
+    other->geometryMatrix.clear();
+}
+
+void SpatialStats::mergeVisitMatrixShards(Loader* loader, const QList<VisitMatrixShard*>& shards, bool copy) {
+    // the first shard that has a geometry (resp. a matrix row) hands it over (or a copy) to the spatial
+    // stats, the same geometry in the other shards is then merged into it, each geometry in parallel
+    QHash<Geometry*, VisitMatrixShard*> owners; // <geometry, shard of its value (and row)>
+    for(VisitMatrixShard* shard : shards) {
+        for(auto it = shard->geometries.begin(); it != shard->geometries.end(); ++it) {
+            if(_geometries.contains(it.key()))
+                continue;
+            _geometries.insert(it.key(), copy ? new GeometryValue(*it.value()) : it.value());
+            owners.insert(it.key(), shard);
+
+            // the keys of geometryMatrix are a subset of the keys of geometries (in each shard)
+            QHash<Geometry*, GeometryMatrixValue*>* row = shard->geometryMatrix.value(it.key(), nullptr);
+            if(row && copy) {
+                QHash<Geometry*, GeometryMatrixValue*>* rowCopy = new QHash<Geometry*, GeometryMatrixValue*>();
+                for(auto jt = row->begin(); jt != row->end(); ++jt)
+                    rowCopy->insert(jt.key(), new GeometryMatrixValue(*jt.value()));
+                row = rowCopy;
+            }
+            if(row)
+                _geometryMatrix.insert(it.key(), row);
+        }
+    }
+    // the rows only found in the other shards are merged into an empty row
+    for(VisitMatrixShard* shard : shards) {
+        for(auto it = shard->geometryMatrix.begin(); it != shard->geometryMatrix.end(); ++it) {
+            if(!_geometryMatrix.contains(it.key()))
+                _geometryMatrix.insert(it.key(), new QHash<Geometry*, GeometryMatrixValue*>());
+        }
+    }
+
+    QString currentMsg = "Merge visit matrix ("+QString::number(shards.size())+" shards)";
+    int size = _geometries.size();
+    QEventLoop loop;
+    QFutureWatcher<void> futureWatcher;
+    QObject::connect( &futureWatcher, SIGNAL(finished()), &loop, SLOT(quit()));
+    QObject::connect(&futureWatcher, &QFutureWatcher<void>::progressValueChanged, [=](int progress) {
+        loader->loadProgressChanged(0.4 + 0.1 * ((qreal) progress / (qreal) size), currentMsg);
+    });
+
+    QList<Geometry*> geoms = _geometries.keys();
+    futureWatcher.setFuture(QtConcurrent::map(geoms, [this, &shards, &owners, copy] (Geometry* geom) {
+        GeometryValue* val = _geometries.value(geom);
+        QHash<Geometry*, GeometryMatrixValue*>* row = _geometryMatrix.value(geom, nullptr);
+        VisitMatrixShard* owner = owners.value(geom);
+        for(VisitMatrixShard* shard : shards) {
+            if(shard == owner)
+                continue;
+            GeometryValue* shardVal = shard->geometries.value(geom, nullptr);
+            if(shardVal) {
+                val->merge(*shardVal);
+                if(!copy) delete shardVal;
+            }
 
-                    visitedGeometries.insert(geom2);
+            QHash<Geometry*, GeometryMatrixValue*>* shardRow = shard->geometryMatrix.value(geom, nullptr);
+            if(shardRow) {
+                for(auto it = shardRow->begin(); it != shardRow->end(); ++it) {
+                    GeometryMatrixValue* matVal = row->value(it.key(), nullptr);
+                    if(matVal) {
+                        matVal->merge(*it.value());
+                        if(!copy) delete it.value();
+                    } else {
+                        row->insert(it.key(), copy ? new GeometryMatrixValue(*it.value()) : it.value());
+                    }
                 }
+                if(!copy) delete shardRow;
             }
         }
+    }));
+    loop.exec();
+    futureWatcher.waitForFinished();
+}
+
+void SpatialStats::mergeTimeBuckets(const QList<QHash<long long, VisitMatrixShard*>*>& shards) {
+    // the first worker shard of each bucket becomes the bucket, the others are merged into it
+    QHash<long long, QList<VisitMatrixShard*>> others;
+    for(QHash<long long, VisitMatrixShard*>* workerShards : shards) {
+        for(auto it = workerShards->begin(); it != workerShards->end(); ++it) {
+            if(_buckets.contains(it.key()))
+                others[it.key()].append(it.value());
+            else
+                _buckets.insert(it.key(), it.value());
+        }
     }
+
+    QList<long long> buckets = others.keys();
+    QtConcurrent::blockingMap(buckets, [this, &others] (long long bucket) {
+        VisitMatrixShard* shard = _buckets.value(bucket);
+        for(VisitMatrixShard* other : others.value(bucket)) {
+            shard->merge(other);
+            delete other;
+        }
+    });
+}
+
+bool SpatialStats::getWindow(Loader* loader, long long start, long long end, QSharedPointer<SpatialStats>* window) {
+    if(!_buckets.isEmpty()) {
+        // whole buckets, within the bounds of the stats (the buckets hold no visit outside of them)
+        if(start != -1)
+            start = getBucket(start) * _bucketSize;
+        if(end != -1)
+            end = (getBucket(end) + 1) * _bucketSize - 1;
+        if(_startTime != -1)
+            start = start == -1 ? _startTime : qMax(start, _startTime);
+        if(_endTime != -1)
+            end = end == -1 ? _endTime : qMin(end, _endTime);
+    }
+    if(start == _startTime && end == _endTime) {
+        *window = QSharedPointer<SpatialStats>(this, [](SpatialStats*) { }); // not owned by the window
+        return true;
+    }
+
+    QPair<long long, long long> key = qMakePair(start, end);
+    {
+        QMutexLocker locker(&_windowsMutex);
+        if(_windows.contains(key)) {
+            _windowsOrder.removeOne(key);
+            _windowsOrder.append(key);
+            *window = _windows.value(key);
+            return true;
+        }
+    }
+
+    // the window is built without the lock, so the requests on the other windows are not blocked
+    QSharedPointer<SpatialStats> stats(new SpatialStats(_trace, _sampling, start, end, _geometryIndex));
+    stats->setHorizon(_horizon);
+    if(_buckets.isEmpty()) {
+        // no time buckets, recompute the stats from the trace
+        if(!stats->computeStats(loader))
+            return false;
+    } else {
+        // merge the buckets that intersect the window
+        QList<VisitMatrixShard*> shards;
+        auto it = start == -1 ? _buckets.begin() : _buckets.lowerBound(getBucket(start));
+        for(; it != _buckets.end() && (end == -1 || it.key() <= getBucket(end)); ++it)
+            shards.append(it.value());
+
+        loader->loadProgressChanged(0.0, "Merge time buckets");
+        stats->_phaseDurations.clear();
+        QElapsedTimer timer;
+        timer.start();
+        stats->mergeVisitMatrixShards(loader, shards, true);
+        stats->_phaseDurations.append(qMakePair(QString("merge time buckets"), timer.elapsed()));
+        stats->computeInterVisitsAndScores(loader);
+    }
+
+    QMutexLocker locker(&_windowsMutex);
+    if(_windows.contains(key)) {
+        // built by another request in the meantime, this copy is released
+        _windowsOrder.removeOne(key);
+        _windowsOrder.append(key);
+        *window = _windows.value(key);
+        return true;
+    }
+
+    // the least recently used windows are released (deleted by their last user)
+    _windows.insert(key, stats);
+    _windowsOrder.append(key);
+    while(_windowsOrder.size() > WINDOW_CACHE_SIZE) {
+        _windows.remove(_windowsOrder.takeFirst());
+    }
+    *window = stats;
+    return true;
 }
 
 void SpatialStats::computeInterVisits(Geometry* geom) {
@@ -125,8 +362,6 @@ void SpatialStats::computeInterVisits(Geometry* geom) {
             prevStartTime = start;
         }
     }
-    val->localStat = computeLocalStat(val->cell);
-    val->color = selectColorForLocalStat(val->localStat);
 }
 
 void SpatialStats::computeInterVisitsMatrix(Geometry* geom1) {
@@ -163,7 +398,24 @@ bool SpatialStats::computeStats(Loader* loader) {
     QString currentMsg = "Populate the nodes";
     loader->loadProgressChanged(0.0, currentMsg);
 
+    // the coverage matrix points to the distributions of the visit matrix, it is rebuilt on the next use
+    {
+        QMutexLocker locker(&_coverageMatrixMutex);
+        delete _coverageMatrix.fetchAndStoreOrdered(nullptr);
+    }
+
+    // wall-clock time of each phase
+    _phaseDurations.clear();
+    QElapsedTimer timer;
+    auto endPhase = [&](const QString& phase) {
+        qint64 elapsed = timer.restart();
+        _phaseDurations.append(qMakePair(phase, elapsed));
+        qDebug() << "Phase" << phase << "done in" << elapsed << "ms";
+    };
+    timer.start();
+
     populateMobileNodes(loader);
+    endPhase("populate nodes");
 
     // compute the visiting matrix for the current set of mobile nodes
     int nbNodes = _mobileNodes.size();
@@ -187,26 +439,71 @@ bool SpatialStats::computeStats(Loader* loader) {
         QObject::connect( &futureWatcher, SIGNAL(finished()), &loop, SLOT(quit()));
     //        QObject::disconnect(&futureWatcher, &QFutureWatcher<void>::progressValueChanged, 0, 0);
         QObject::connect(&futureWatcher, &QFutureWatcher<void>::progressValueChanged, [=](int progress) {
-            loader->loadProgressChanged(0.1 + 0.4 * (progress / (qreal) nbNodes), currentMsg);
+            loader->loadProgressChanged(0.1 + 0.3 * (progress / (qreal) nbNodes), currentMsg);
         });
 
-        /** Compute the inter-visit durations for the cells */
+        /** Compute the visit matrix, each worker fills its own shards (one per time bucket) */
+        QList<QHash<long long, VisitMatrixShard*>*> shards;
+        QStack<QHash<long long, VisitMatrixShard*>*> freeShards;
+        QMutex shardsMutex; // only held to take or give back a shard
         QList<QString> nodes = _mobileNodes.keys();
-        futureWatcher.setFuture(QtConcurrent::map(nodes, [this] (QString& node) {
-            computeVisitMatrix(node);
+        futureWatcher.setFuture(QtConcurrent::map(nodes, [this, &shards, &freeShards, &shardsMutex] (QString& node) {
+            shardsMutex.lock();
+            QHash<long long, VisitMatrixShard*>* shard;
+            if(freeShards.isEmpty()) {
+                shard = new QHash<long long, VisitMatrixShard*>();
+                shards.append(shard);
+            } else {
+                shard = freeShards.pop();
+            }
+            shardsMutex.unlock();
+
+            computeVisitMatrix(node, shard);
+
+            shardsMutex.lock();
+            freeShards.push(shard);
+            shardsMutex.unlock();
         }));
         loop.exec();
         futureWatcher.waitForFinished();
+        endPhase("visit matrix");
+
+        if(_bucketSize > 0) {
+            // keep the visit matrix of each time bucket, the stats get a copy of all the buckets
+            mergeTimeBuckets(shards);
+            endPhase("merge time buckets");
+            mergeVisitMatrixShards(loader, _buckets.values(), true);
+        } else {
+            QList<VisitMatrixShard*> workerShards;
+            for(QHash<long long, VisitMatrixShard*>* shard : shards)
+                workerShards.append(shard->values());
+            mergeVisitMatrixShards(loader, workerShards);
+            qDeleteAll(workerShards);
+        }
+        qDeleteAll(shards);
+        endPhase("merge visit matrix");
     }
 
+    computeInterVisitsAndScores(loader);
+    return true;
+}
+
+void SpatialStats::computeInterVisitsAndScores(Loader* loader) {
+    QElapsedTimer timer;
+    auto endPhase = [&](const QString& phase) {
+        qint64 elapsed = timer.restart();
+        _phaseDurations.append(qMakePair(phase, elapsed));
+        qDebug() << "Phase" << phase << "done in" << elapsed << "ms";
+    };
+    timer.start();
 
 /** Compute the inter-visit matrix */
-    currentMsg = "Inter-visit ("
+    QString currentMsg = "Inter-visit ("
                  +QString::number(_geometryMatrix.size())+")"
                  +" matrix size, ("
                  +QString::number(_geometries.size())
                  +" nodes size)";
-    loader->loadProgressChanged(0.4, currentMsg);
+    loader->loadProgressChanged(0.5, currentMsg);
 
     {
         currentMsg = "Compute inter-visit durations (cells)";
@@ -227,6 +524,29 @@ bool SpatialStats::computeStats(Loader* loader) {
         loop.exec();
         futureWatcher.waitForFinished();
     }
+    endPhase("inter-visit durations (cells)");
+
+    {
+        // local Getis-Ord G* of the number of visits of the cells
+        currentMsg = "Compute local stats (Getis-Ord G*)";
+        loader->loadProgressChanged(0.66, currentMsg);
+        QList<GeometryValue*> values = _geometries.values();
+        QVector<QPointF> positions;
+        QVector<double> visitCounts;
+        for(GeometryValue* val : values) {
+            positions.append(val->cell->getCenter());
+            visitCounts.append(val->visits.size());
+        }
+        QVector<double> zScores, pValues;
+        GetisOrd(positions, visitCounts).compute(&zScores, &pValues);
+        for(int i = 0; i < values.size(); ++i) {
+            GeometryValue* val = values.at(i);
+            val->localStat = zScores.at(i);
+            val->localStatPValue = pValues.at(i);
+            val->color = GetisOrd::selectColor(val->localStat);
+        }
+    }
+    endPhase("local stats (Getis-Ord G*)");
 
     currentMsg = "Compute inter-visit durations (matrix)";
     loader->loadProgressChanged(0.66, currentMsg);
@@ -249,6 +569,7 @@ bool SpatialStats::computeStats(Loader* loader) {
         loop.exec();
         futureWatcher.waitForFinished();
     }
+    endPhase("inter-visit durations (matrix)");
 
     currentMsg = "Compute scores";
     loader->loadProgressChanged(0.82, currentMsg);
@@ -286,89 +607,142 @@ bool SpatialStats::computeStats(Loader* loader) {
         count++;
         loader->loadProgressChanged(0.82 + 0.16 * ((qreal) count / (qreal) size), currentMsg);
     }
+    endPhase("scores");
 
     // TODO  Only one loader for both console and GUI
     loader->loadProgressChanged((qreal) 1.0, "Done");
     std::cout << std::endl;
-
-    return true;
 }
 
-QColor SpatialStats::selectColorForLocalStat(qreal zScore) {
-    if(zScore >= 3.291) return QColor("#720206");
-    else if(zScore >= 2.576) return QColor("#f33f1c");
-    else if(zScore >= 1.960) return QColor("#f37b22");
-    else if(zScore >= 1.645) return QColor("#fffe38");
-    else return QColor("#cccccc");
-}
-
-qreal SpatialStats::computeLocalStat(Geometry* geom_i) {
-    qreal sum1 = 0.0, sum2 = 0.0, sum3 = 0.0, sum4 = 0.0, sum5 = 0.0;
-    int n = _geometries.size();
-    for(auto it = _geometries.begin(); it != _geometries.end(); ++it) {
-        int count_j = it.value()->visits.size();
-        Geometry* geom_j = it.key();
-        int weight = (int) (1.0 / (0.01 + (qreal) qSqrt(qPow(geom_i->getCenter().x() - geom_j->getCenter().x(), 2) +
-                                                        qPow(geom_i->getCenter().y() - geom_j->getCenter().y(), 2))));
-        sum1 += weight * count_j;
-        sum2 += weight;
-        sum3 += qPow(weight,2);
-        sum4 += count_j;
-        sum5 += qPow(count_j,2);
-    }
-
-    // TODO compute p-scores
-
-    qreal mean = sum4 / n;
-    qreal S = qSqrt(sum5 / n - qPow(mean, 2));
-    return (sum1 - mean * sum2) / (S * qSqrt((n * sum3 - qPow(sum2,2)) / (n-1)));
-}
-
-
 void MobileNode::addPosition(long long time, double x, double y) {
     // assuming the positions are added sequentially
     if(_prevPos.isNull() || time - _prevTime > 300) { // restart the cell recording
         // get the list of geometries that contain the current position
-        QSet<Geometry*>* geoms = _spatialStats->containsPoint(x,y);
-        _startTimeGeometries.clear();
+        _openVisits.clear();
+        _prevGeometries.clear();
         // record all geometries
-        for(Geometry* geom : *geoms) {
-            _startTimeGeometries.insert(geom, time);
-            if(!_visitedGeometries.contains(time))
-                _visitedGeometries.insert(time, new QHash<Geometry*,long long>());
-            _visitedGeometries.value(time)->insert(geom,time);
-        }
-    } else { // increase the end time of the current recorded geometries
+        _spatialStats->containsPoint(x, y, [this, time](Geometry* geom) {
+            startVisit(geom, time);
+            _prevGeometries.insert(geom);
+        });
+    } else if(time > _prevTime) { // increase the end time of the current recorded geometries
         QPointF pos(x,y); // position of the node
-        // number of intermediate positions (with the sampling)
-        int nbPos = qMax(1, qCeil((time - _prevTime) / _sampling));
-        for(int i = 1; i <= nbPos; ++i) {
-            long long t = _prevTime + i*_sampling; // get the sampling time from the prevTime
-            QPointF p = (time - t)*_prevPos + (t - _prevTime)*pos;
-            p /= (time - _prevTime);
-
-            // get the corresponding visited Geometries
-            QSet<Geometry*> geoms;
-            _spatialStats->containsPoint(&geoms, p);
-
-            // start recording all the new geometries
-            QSet<Geometry*> newGeometries = geoms - _prevGeometries;
-            for(Geometry* geom : newGeometries) {
-                _startTimeGeometries.insert(geom, time);
-                if(!_visitedGeometries.contains(time))
-                    _visitedGeometries.insert(time, new QHash<Geometry*,long long>());
-                _visitedGeometries.value(time)->insert(geom,time);
-            }
-            // update the geometries that are currently being recorded
-            QSet<Geometry*> currentGeometries = geoms & _prevGeometries;
-            for(Geometry* geom : currentGeometries) {
-                long long startTimeGeom = _startTimeGeometries.value(geom);
-                _visitedGeometries.value(startTimeGeom)->insert(geom, time);
-            }
-
-            _prevGeometries = geoms;
-        }
+        GeometryIndex* geometryIndex = _spatialStats->getGeometryIndex();
+        if(geometryIndex && geometryIndex->isDense())
+            addCellCrossings(time, pos, geometryIndex);
+        else
+            addSamples(time, pos);
     }
     _prevPos = QPointF(x,y);
     _prevTime = time;
 }
+
+void MobileNode::addSamples(long long time, const QPointF& pos) {
+    GeometryIndex::GeometryBuffer geoms;
+    QSet<Geometry*> currentGeometries;
+    int nbPos = getNbSamples(time);
+    for(int i = 1; i <= nbPos; ++i) {
+        long long t = getSampleTime(i, time);
+        QPointF p = getSamplePosition(t, time, pos);
+
+        // start recording the new geometries, update those that are currently being recorded
+        // (in the order of the point query)
+        _spatialStats->getGeometriesAt(p.x(), p.y(), &geoms);
+        currentGeometries.clear();
+        for(Geometry* geom : geoms) {
+            if(_prevGeometries.contains(geom))
+                extendVisit(geom, t);
+            else
+                startVisit(geom, t);
+            currentGeometries.insert(geom);
+        }
+        _prevGeometries.swap(currentGeometries);
+    }
+}
+
+void MobileNode::addCellCrossings(long long time, const QPointF& pos, GeometryIndex* geometryIndex) {
+    int nbPos = getNbSamples(time);
+    double x0 = _prevPos.x(), y0 = _prevPos.y();
+    double dx = pos.x() - x0, dy = pos.y() - y0;
+    double samplesPerUnit = _sampling > 0 ? (double) (time - _prevTime) / _sampling : 1.0;
+
+    QSet<Geometry*> geoms; // geometries that contain the last sample
+    // visits that start in the segment, with the rank of the cell in the point query of their first sample
+    QVector<QPair<Visit, int>> newVisits;
+    geometryIndex->getDenseCellsAlong(x0, y0, pos.x(), pos.y(), &_crossedCells);
+    for(int id : _crossedCells) {
+        const GeometryIndex::DenseCell& cell = geometryIndex->getDenseCell(id);
+        auto inside = [&](int i) {
+            // same sample and same test as the point queries
+            QPointF p = getSamplePosition(getSampleTime(i, time), time, pos);
+            return p.x() >= cell.minX && p.x() <= cell.maxX && p.y() >= cell.minY && p.y() <= cell.maxY;
+        };
+
+        // part [u0,u1] of the segment in the cell, slightly enlarged (Liang and Barsky, 1984)
+        double eps = 1e-9 * (geometryIndex->getCellSize() + qAbs(cell.minX) + qAbs(cell.minY));
+        double p[4] = { -dx, dx, -dy, dy };
+        double q[4] = { x0 - cell.minX + eps, cell.maxX + eps - x0, y0 - cell.minY + eps, cell.maxY + eps - y0 };
+        double u0 = 0.0, u1 = 1.0;
+        bool crossed = true;
+        for(int k = 0; k < 4 && crossed; ++k) {
+            if(p[k] == 0.0)
+                crossed = q[k] >= 0.0;
+            else if(p[k] < 0.0)
+                u0 = qMax(u0, q[k] / p[k]);
+            else
+                u1 = qMin(u1, q[k] / p[k]);
+        }
+        if(!crossed || u0 > u1)
+            continue;
+
+        // first and last samples in the cell, around the samples of [u0,u1]
+        int a = qBound(1, qFloor(u0 * samplesPerUnit), nbPos);
+        int b = qBound(1, qCeil(u1 * samplesPerUnit) + 1, nbPos);
+        while(a <= b && !inside(a))
+            ++a;
+        if(a > b)
+            continue;
+        while(!inside(b))
+            --b;
+        while(a > 1 && inside(a-1))
+            --a;
+        while(b < nbPos && inside(b+1))
+            ++b;
+
+        // the visit continues if the cell contained the previous position (as a sample)
+        long long ta = getSampleTime(a, time), tb = getSampleTime(b, time);
+        if(a == 1 && _prevGeometries.contains(cell.geom)) {
+            extendVisit(cell.geom, tb);
+        } else {
+            // the point query lists the cell that starts in the grid cell of the sample, then
+            // those that start in the previous grid cell in x, in y, and in x and y
+            QPointF pa = getSamplePosition(ta, time, pos);
+            double cellSize = geometryIndex->getCellSize();
+            int rank = (qFloor(pa.x() / cellSize) != qFloor(cell.minX / cellSize) ? 1 : 0)
+                     + (qFloor(pa.y() / cellSize) != qFloor(cell.minY / cellSize) ? 2 : 0);
+            newVisits.append(qMakePair(Visit{ ta, tb, cell.geom }, rank));
+        }
+        if(b == nbPos)
+            geoms.insert(cell.geom);
+    }
+    _prevGeometries.swap(geoms);
+
+    // record the new visits in the order of the samples
+    std::sort(newVisits.begin(), newVisits.end(), [](const QPair<Visit, int>& v1, const QPair<Visit, int>& v2) {
+        return v1.first.start < v2.first.start || (v1.first.start == v2.first.start && v1.second < v2.second);
+    });
+    for(const QPair<Visit, int>& v : newVisits) {
+        startVisit(v.first.geom, v.first.start);
+        extendVisit(v.first.geom, v.first.end);
+    }
+}
+
+void MobileNode::startVisit(Geometry* geom, long long time) {
+    // the visits are started in the order of the time
+    _openVisits.insert(geom, _visits.size());
+    _visits.append({ time, time, geom });
+}
+
+void MobileNode::extendVisit(Geometry* geom, long long time) {
+    _visits[_openVisits.value(geom)].end = time;
+}
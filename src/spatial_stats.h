@@ -1,6 +1,9 @@
 #ifndef SPATIALSTATS_H
 #define SPATIALSTATS_H
 
+#include <algorithm>
+#include <QSharedPointer>
+
 #include "utils.h"
 #include "layer.h"
 #include "geometries.h"
@@ -9,11 +12,37 @@
 #include "weighted_allocation_layer.h"
 #include "geometry_index.h"
 #include "rest_server.h"
+#include "coverage_matrix.h"
 
 
 class TraceLayer;
 
+/* Visit of a geometry by a mobile node, from "start" to "end" */
+struct Visit {
+    long long start;
+    long long end;
+    Geometry* geom;
+};
+
+/* Read-only view on a range of visits (contiguous in memory) */
+class VisitView {
+public:
+    VisitView(const Visit* begin = nullptr, const Visit* end = nullptr):
+        _begin(begin), _end(end) { }
+
+    const Visit* begin() const { return _begin; }
+    const Visit* end() const { return _end; }
+    int size() const { return (int) (_end - _begin); }
+    bool isEmpty() const { return _begin == _end; }
+    const Visit& at(int i) const { return _begin[i]; }
+
+private:
+    const Visit* _begin;
+    const Visit* _end;
+};
+
 class MobileNode {
+    friend class MobileNodeVisitsTest; // runs the two paths of addPosition on the same trace
 public:
     MobileNode(QString id = "", int sampling = -1, SpatialStats* spatialStats = 0):
         _id(id), _sampling(sampling), _spatialStats(spatialStats) { }
@@ -21,35 +50,54 @@ public:
     void addPosition(long long time, double x, double y);
     QString getId() { return _id; }
 
-    QMap<long long, QHash<Geometry*,long long>*> getGeometries() { return _visitedGeometries; }
-
-    QMap<long long, QHash<Geometry*,long long>*> getCells(long long start, long long end) {
-        auto up = _visitedGeometries.lowerBound(start);
-        auto it = up;
-        if(up.key() != start)
-            it = up-1;
-        if(up == _visitedGeometries.end())
-            return QMap<long long, QHash<Geometry*,long long>*>(); // reached the end
-
-        QMap<long long, QHash<Geometry*,long long>*> res;
-        for(; it != _visitedGeometries.end() && it.key() <= end; ++it) {
-            res.insert(it.key(), it.value());
-        }
+    /* Visits of the node sorted by start time (in the order they started for the same start time) */
+    VisitView getVisits() const {
+        return VisitView(_visits.constData(), _visits.constData() + _visits.size());
+    }
 
-        return res;
+    /* Visits that start within [start, end] */
+    VisitView getVisits(long long start, long long end) const {
+        auto first = std::lower_bound(_visits.constBegin(), _visits.constEnd(), start,
+                                      [](const Visit& v, long long t) { return v.start < t; });
+        auto last  = std::upper_bound(first, _visits.constEnd(), end,
+                                      [](long long t, const Visit& v) { return t < v.start; });
+        return VisitView(first, last);
     }
 
 private:
     QString _id;
     int _sampling;                  // linear interpolation at different times
     QSet<Geometry*> _prevGeometries;
-    QHash<Geometry*, long long> _startTimeGeometries;   // record the start time of each ogrGeometry (reverse hash)
+    QHash<Geometry*, int> _openVisits;  // <geometry, index of its last visit> since the restart of the recording
     long long _prevTime = 0;        // node previous time of the point recording
     QPointF _prevPos = QPointF();   // node previous position
     SpatialStats* _spatialStats;
+    QVector<int> _crossedCells;     // buffer of the cells crossed by a segment
+
+    QVector<Visit> _visits;         // visits sorted by start time
+
+    /* Interpolated positions between the previous position and the position "pos" at "time":
+     * sample i (from 1) is at time min(time, prevTime + i * sampling). The coordinates of the
+     * samples are monotone (no rounding back and forth across the border of a cell). */
+    int getNbSamples(long long time) const {
+        return _sampling > 0 ? (int) qMax(1LL, (time - _prevTime) / _sampling) : 1;
+    }
+    long long getSampleTime(int i, long long time) const {
+        return _sampling > 0 ? qMin(time, _prevTime + i * (long long) _sampling) : time;
+    }
+    QPointF getSamplePosition(long long t, long long time, const QPointF& pos) const {
+        double u = (double) (t - _prevTime) / (double) (time - _prevTime);
+        return QPointF(_prevPos.x() + u * (pos.x() - _prevPos.x()), _prevPos.y() + u * (pos.y() - _prevPos.y()));
+    }
+
+    /* Visits of the geometries that contain the samples, tested one sample at a time */
+    void addSamples(long long time, const QPointF& pos);
+    /* Same visits when the geometries are the cells of a dense grid, from the cells crossed by
+     * the segment (the samples in a cell are contiguous, so only the first and the last are found) */
+    void addCellCrossings(long long time, const QPointF& pos, GeometryIndex* geometryIndex);
 
-    // start time, < Geometry id, end time >
-    QMap<long long, QHash<Geometry*,long long>*> _visitedGeometries;
+    void startVisit(Geometry* geom, long long time);
+    void extendVisit(Geometry* geom, long long time);
 };
 
 
@@ -62,12 +110,20 @@ struct GeometryValue {
     QSet<QString> nodes; // nodes that visited the cell
     Distribution travelTimes;
     int connections = 0;
-    qreal localStat;
+    qreal localStat; // z-score of the local Getis-Ord G* of the number of visits
+    qreal localStatPValue = 1.0; // two-sided p-value of the z-score
     QColor color;
     qreal medIncomingScore = 0.0; // sum of the score of the incoming edges (with median)
     qreal avgIncomingScore = 0.0; // sum of the score of the incoming edges (with average)
     qreal medScore = 0.0; // score with median of the inter-visit distribution
     qreal avgScore = 0.0; // score with average of the inter-visit distribution
+
+    /* Add the visits recorded in "other" (for the same cell) */
+    void merge(const GeometryValue& other) {
+        visitFrequency.append(other.visitFrequency);
+        visits.unite(other.visits);
+        nodes.unite(other.nodes);
+    }
 };
 
 
@@ -82,17 +138,38 @@ struct GeometryMatrixValue {
     QSet<QString> nodes; // nodes that visited the link
     qreal medScore = 0.0; // score with median of the inter-visit distribution
     qreal avgScore = 0.0; // score with average of the inter-visit distribution
+
+    /* Add the visits recorded in "other" (for the same link) */
+    void merge(const GeometryMatrixValue& other) {
+        travelTimeDist.merge(other.travelTimeDist);
+        visitFrequency.append(other.visitFrequency);
+        visits.unite(other.visits);
+        nodes.unite(other.nodes);
+    }
+};
+
+
+/* Part of the visit matrix filled by one worker thread, without locking,
+ * the shards are merged into the spatial stats once all the nodes are processed */
+struct VisitMatrixShard {
+    QHash<Geometry*, GeometryValue*> geometries;
+    QHash<Geometry*, QHash<Geometry*, GeometryMatrixValue*>* > geometryMatrix;
+
+    /* Add the values of "other" to the shard (the values of "other" are handed over or deleted) */
+    void merge(VisitMatrixShard* other);
 };
 
 
 class SpatialStats : public QObject {
     Q_OBJECT
+    friend class Snapshot; // saves and restores the computed stats
 public:
     SpatialStats(Trace* trace = nullptr,
                  long long sampling = -1,
                  long long startTime = -1,
                  long long endTime = -1,
                  GeometryIndex* geometryIndex = 0);
+    ~SpatialStats();
 
     /* Populate nodes from the trace layer */
     void populateMobileNodes(Loader* loader);
@@ -143,46 +220,111 @@ public:
         *geometries = _geometries;
     }
 
+    /* Returns the compact copy of the visit matrix used by the allocation methods
+     * (built on the first call, then shared by all the allocation requests until computeStats
+     * recomputes the visit matrix, which must not happen during an allocation) */
+    CoverageMatrix* getCoverageMatrix() {
+        // the matrix is read by the scoring threads, only lock while it is built
+        CoverageMatrix* coverageMatrix = _coverageMatrix.loadAcquire();
+        if(coverageMatrix)
+            return coverageMatrix;
+
+        QMutexLocker locker(&_coverageMatrixMutex);
+        coverageMatrix = _coverageMatrix.loadAcquire();
+        if(!coverageMatrix) {
+            coverageMatrix = new CoverageMatrix(this);
+            _coverageMatrix.storeRelease(coverageMatrix);
+        }
+        return coverageMatrix;
+    }
+
     double getAverageSpeed() {
         return _trace->averageSpeed();
     }
 
+    /* Maximum travel time (s) between two visits of a node accounted in the visit matrix
+     * (-1 for no horizon), to set before computeStats */
+    void setHorizon(long long horizon) {
+        _horizon = horizon;
+    }
+
+    long long getHorizon() {
+        return _horizon;
+    }
+
+    /* Size (s) of the time buckets of the visit matrix (-1 for no buckets), to set before computeStats.
+     * The visit matrix is also kept per bucket (of the start time of the visits), so that the stats
+     * of a time window are merged from the buckets instead of being recomputed from the trace */
+    void setBucketSize(long long bucketSize) {
+        _bucketSize = bucketSize;
+    }
+
+    long long getBucketSize() {
+        return _bucketSize;
+    }
+
+    /* Spatial stats of the time window [start, end] (-1 for no bound), merged from the time buckets
+     * that intersect the window (recomputed from the trace without buckets). The window is widened
+     * to whole buckets (within the bounds of these stats), its getStartTime/getEndTime give the
+     * bounds actually used. The last WINDOW_CACHE_SIZE windows are kept for the next calls, an
+     * evicted window is deleted once its last user releases it. The cache is only locked to look up
+     * and insert a window, so concurrent calls on the same new window may each build it (the first
+     * one inserted is kept) */
+    bool getWindow(Loader* loader, long long start, long long end, QSharedPointer<SpatialStats>* window);
+
+    long long getSampling() { return _sampling; }
+    long long getStartTime() { return _startTime; }
+    long long getEndTime() { return _endTime; }
+    Trace* getTrace() { return _trace; }
+    GeometryIndex* getGeometryIndex() { return _geometryIndex; }
+
     double getCellSize() {
         return _geometryIndex->getCellSize();
     }
 
-    /* Getis Ord G spatial stats
-     * TODO: compute the p-value
-    */
-    qreal computeLocalStat(Geometry* geom_i);
-
-    /* Returns the Geometry that contains the point (x,y) */
-    QSet<Geometry*>* containsPoint(double x, double y) {
-        return _geometryIndex->getGeometriesAt(x, y);
+    /* Calls visitor(Geometry*) for each Geometry that contains the point (x,y) */
+    template<typename Visitor>
+    void containsPoint(double x, double y, Visitor visitor) const {
+        _geometryIndex->forEachGeometryAt(x, y, visitor);
     }
-    QSet<Geometry*>* containsPoint(QSet<Geometry*>* geometries, QPointF p) {
-        return containsPoint(p.x(), p.y());
+
+    void getGeometriesAt(double x, double y, GeometryIndex::GeometryBuffer* geometries) const {
+        _geometryIndex->getGeometriesAt(x, y, geometries);
     }
 
-    QSet<Geometry*>* getGeometriesAt(double x, double y) const {
-        return _geometryIndex->getGeometriesAt(x, y);
+    /* Wall-clock duration (in ms) of each phase of the last computeStats call */
+    void getPhaseDurations(QList<QPair<QString, qint64>>* phaseDurations) {
+        *phaseDurations = _phaseDurations;
     }
 
 private:
     Trace* _trace;
     QHash<QString, MobileNode*> _mobileNodes; // <mobileNodeId, mobileNode>
     QHash<Geometry*, QHash<Geometry*, GeometryMatrixValue*>* > _geometryMatrix;
-    QMutex _geometryMatrixMutex;
     QHash<Geometry*, GeometryValue*> _geometries;
     QMutex _geometriesMutex;
+    QAtomicPointer<CoverageMatrix> _coverageMatrix;
+    QMutex _coverageMatrixMutex;
     GeometryIndex* _geometryIndex;
 
     long long _sampling = 1; // each 1 second
     long long _startTime;
     long long _endTime;
-
-    QColor selectColorForLocalStat(qreal zScore);
-    void computeVisitMatrix(QString& node);
+    long long _horizon = -1;
+    long long _bucketSize = -1;
+    QMap<long long, VisitMatrixShard*> _buckets; // <bucket, visit matrix of the visits starting in the bucket>
+    QHash<QPair<long long, long long>, QSharedPointer<SpatialStats>> _windows; // <(start, end), spatial stats of the window>
+    QList<QPair<long long, long long>> _windowsOrder; // windows from the least to the most recently used
+    QMutex _windowsMutex;
+    QList<QPair<QString, qint64>> _phaseDurations; // <phase, wall-clock duration (ms)>
+
+    long long getBucket(long long time) const;
+    void computeVisitMatrix(QString& node, QHash<long long, VisitMatrixShard*>* shards);
+    /* Merge the shards into the spatial stats, the values of the shards are handed over (or
+     * deleted once merged), or copied if "copy" is true (the shards are left untouched) */
+    void mergeVisitMatrixShards(Loader* loader, const QList<VisitMatrixShard*>& shards, bool copy = false);
+    void mergeTimeBuckets(const QList<QHash<long long, VisitMatrixShard*>*>& shards);
+    void computeInterVisitsAndScores(Loader* loader);
     void computeInterVisits(Geometry* geom);
     void computeInterVisitsMatrix(Geometry* geom1);
 
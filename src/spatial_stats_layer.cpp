@@ -126,14 +126,15 @@ void SpatialStatsLayer::exportContourFile() {
     qDebug() << topLeft << bottomRight << cellSize << (bottomRight.x() - topLeft.x()) / cellSize << (bottomRight.y() - topLeft.y()) / cellSize;
     QHash<Geometry*, GeometryMatrixValue*>* cells;
     _spatialStats->getValues(&cells, _selectedGeometry);
+    GeometryIndex::GeometryBuffer geoms;
     for(double i = topLeft.x(); i < bottomRight.x(); i += 10) {
         for(double j = topLeft.y(); j < bottomRight.y(); j += 10) {
-            QSet<Geometry*>* geoms = _spatialStats->getGeometriesAt(i,j);
+            _spatialStats->getGeometriesAt(i,j, &geoms);
             bool foundRightGeom = false;
-            if(geoms->isEmpty()) {
+            if(geoms.isEmpty()) {
                 return;
             }
-            for(Geometry* geom : *geoms) {
+            for(Geometry* geom : geoms) {
                 if(geom->getGeometryType() == CellGeometryType) {
                     // add the ogrGeometry to the output
                     if(cells->contains(geom)) {
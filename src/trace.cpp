@@ -6,178 +6,242 @@
 #include "proj_factory.h"
 #include "loader.h"
 #include "geometry_index.h"
+#include "trace_reader.h"
 
 bool Trace::openTrace(Loader* loader) {
-    if(_filename.contains("test")) {
-        QFile* file = new QFile(_filename);
-        if(!file->open(QFile::ReadOnly | QFile::Text))
-            return false;
+    if(_filename.contains("test") || _filename.contains("ONE")) {
+        // test: "ts;node;lon;lat", ONE: "ts node lon lat" (after a header line)
+        bool isONE = !_filename.contains("test");
+        char delim = isONE ? ' ' : ';';
 
-        while(!file->atEnd()) {
-            QString line = QString(file->readLine()).split(QRegExp("[\r\n]"), QString::SkipEmptyParts).at(0);
-            QStringList fields = line.split(";");
-            QString node = fields.at(1);
-            long long ts = (long long) fields.at(0).toDouble();
-            double lat   = fields.at(3).toDouble();
-            double lon   = fields.at(2).toDouble();
-//            qDebug() << "(" << node << "," << ts << "," << lat << "," << lon << ")";
-            if(ts <= 0)
-                continue;
-            // convert the points to the local projection
-            double x, y;
-            ProjFactory::getInstance().transformCoordinates(lat, lon, &x, &y);
-//            qDebug() << "adding node" << node << "(" << x << "," << y << "," << ts << ")";
-            addPoint(node, ts, x, y);
-            loader->loadProgressChanged(1.0 - file->bytesAvailable() / (qreal)file->size(), "");
-        }
-    } else if (_filename.contains("ONE")) {
-        QFile* file = new QFile(_filename);
-        if(!file->open(QFile::ReadOnly | QFile::Text))
+        TraceReader reader(_filename);
+        if(!reader.open())
             return false;
 
+        const char *lineBegin, *lineEnd;
         // read first line
         // minTime maxTime minX maxX minY maxY
-        if(!file->atEnd())
-            file->readLine();
-
-        while(!file->atEnd()) {
-            QString line = QString(file->readLine()).split(QRegExp("[\r\n]"), QString::SkipEmptyParts).at(0);
-            QStringList fields = line.split(" ");
-            QString node = fields.at(1);
-            long long ts = fields.at(0).toLongLong();
-            double lat   = fields.at(3).toDouble();
-            double lon   = fields.at(2).toDouble();
+        if(isONE)
+            reader.readLine(&lineBegin, &lineEnd);
+
+        QString node; // the lines of a same node usually follow each other
+        int nodeId = -1;
+        TraceField fields[4];
+
+        // the points are converted to the local projection by batches
+        QVector<int> batchIds;
+        QVector<long long> batchTimestamps;
+        QVector<double> batchXs, batchYs;
+        auto projectBatch = [&]() {
+            ProjFactory::getInstance().transformCoordinates(batchXs.size(), batchXs.data(), batchYs.data());
+            for(int i = 0; i < batchIds.size(); ++i) {
+//                qDebug() << "adding node" << batchIds.at(i) << "(" << batchXs.at(i) << "," << batchYs.at(i) << "," << batchTimestamps.at(i) << ")";
+                _store.append(batchIds.at(i), batchTimestamps.at(i), batchXs.at(i), batchYs.at(i));
+            }
+            batchIds.clear();
+            batchTimestamps.clear();
+            batchXs.clear();
+            batchYs.clear();
+        };
+        while(reader.readLine(&lineBegin, &lineEnd)) {
+            if(TraceReader::splitFields(lineBegin, lineEnd, delim, fields, 4) < 4)
+                continue;
+            if(nodeId == -1 || !fields[1].equals(node)) {
+                node = fields[1].toString();
+                nodeId = _store.addNode(node);
+            }
+            long long ts = isONE ? TraceReader::parseLongLong(fields[0])
+                                 : (long long) TraceReader::parseDouble(fields[0]);
+            double lat   = TraceReader::parseDouble(fields[3]);
+            double lon   = TraceReader::parseDouble(fields[2]);
 //            qDebug() << "(" << node << "," << ts << "," << lat << "," << lon << ")";
             if(ts <= 0)
                 continue;
-            // convert the points to the local projection
-            double x, y;
-            ProjFactory::getInstance().transformCoordinates(lat, lon, &x, &y);
-//            qDebug() << "adding node" << node << "(" << x << "," << y << "," << ts << ")";
-            addPoint(node, ts, x, y);
-            loader->loadProgressChanged(1.0 - file->bytesAvailable() / (qreal)file->size(), "");
+            batchIds.append(nodeId);
+            batchTimestamps.append(ts);
+            batchXs.append(lon);
+            batchYs.append(lat);
+            if(batchIds.size() == PROJ_BATCH_SIZE)
+                projectBatch();
+            if(ts < _startTime) _startTime = ts;
+            if(ts > _endTime) _endTime = ts;
+            if(reader.progressDue())
+                loader->loadProgressChanged(reader.progress(), "");
         }
-    } else if(_filename.contains("cabspotting")) {
+        projectBatch();
+    } else if(_filename.contains("cabspotting") || _filename.contains("gps_logs")) {
+        // cabspotting: one "new_*.txt" file per node, DieselNet: one folder per node
+        bool isCabspotting = _filename.contains("cabspotting");
 
         // "filename" is the repertory of the files
-        QDirIterator it(_filename, QStringList() << "new_*.txt", QDir::Files, QDirIterator::Subdirectories);
-        int count = 0;
-        QList<QString> filenames;
-        while (it.hasNext()) {
-            filenames.append(it.next());
-            count++;
-        }
-        for(int i = 0; i < count; ++i) {
-            openNodeTrace(filenames.at(i));
-            loader->loadProgressChanged((qreal) i / (qreal) count, "");
+        QStringList paths;
+        if(isCabspotting) {
+            QDirIterator it(_filename, QStringList() << "new_*.txt", QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext())
+                paths.append(it.next());
+        } else {
+            QDirIterator it(_filename, QDir::Dirs | QDir::NoSymLinks | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+            while (it.hasNext())
+                paths.append(it.next());
         }
-    } else if(_filename.contains("gps_logs")) {
-
-        QDirIterator it(_filename, QDir::Dirs | QDir::NoSymLinks | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-        int count = 0;
-        QList<QString> nodeNames;
-        while (it.hasNext()) {
-            QString folder = it.next();
-            nodeNames.append(folder);
-            count++;
+
+        // each file (resp. folder) is read in parallel in the buffer of its node
+        struct NodeBuffer {
+            QString path;
+            QString node;
+            NodeColumns* positions;
+        };
+        QVector<NodeBuffer> buffers;
+        for(const QString& path : paths) {
+            buffers.append({path, QString(), new NodeColumns()});
         }
-        for(int i = 0; i < count; ++i) {
-            openDieselNetNodeFolder(nodeNames.at(i));
-            loader->loadProgressChanged((qreal) i / (qreal) count, "");
+
+        int count = buffers.size();
+        QEventLoop loop;
+        QFutureWatcher<void> futureWatcher;
+        QObject::connect( &futureWatcher, SIGNAL(finished()), &loop, SLOT(quit()));
+        QObject::connect(&futureWatcher, &QFutureWatcher<void>::progressValueChanged, [=](int progress) {
+            loader->loadProgressChanged((qreal) progress / (qreal) count, "");
+        });
+        futureWatcher.setFuture(QtConcurrent::map(buffers, [this, isCabspotting] (NodeBuffer& buffer) {
+            if(isCabspotting)
+                openNodeTrace(buffer.path, &buffer.node, buffer.positions);
+            else
+                openDieselNetNodeFolder(buffer.path, &buffer.node, buffer.positions);
+        }));
+        loop.exec();
+        futureWatcher.waitForFinished();
+
+        // merge the node buffers once all the files are read
+        for(const NodeBuffer& buffer : buffers) {
+            addNodeTrace(buffer.node, buffer.positions);
         }
     }
 
+    _nodesCacheValid = false;
     qDebug() << "[DONE] loading file" << _filename << _startTime << _endTime;
     loader->loadProgressChanged((qreal)1.0, "Done");
 
     return true;
 }
 
-void Trace::openNodeTrace(QString filename) {
+void Trace::openNodeTrace(QString filename, QString* node, NodeColumns* positions) {
     // opens a node trace of format
     // [latitude (double), longitude (double), occupancy (int), time (long long)]
-    QFile* file = new QFile(filename);
 //    QRegExp rx("^new\\_(.*?)\\.txt$");
     QRegExp rx("new\\_(\\w+).txt");
     rx.indexIn(QFileInfo(filename).fileName());
-    QString node = rx.cap(1);
+    *node = rx.cap(1);
 
-    if(!file->open(QFile::ReadOnly | QFile::Text)) {
+    TraceReader reader(filename);
+    if(!reader.open()) {
         return;
     }
-    while(!file->atEnd())
-    {
-        QString line = QString(file->readLine()).split(QRegExp("[\r\n]"), QString::SkipEmptyParts).at(0);
-        QStringList fields = line.split(" ");
-        double lat = fields.at(0).toDouble();
-        double lon = fields.at(1).toDouble();
-        long long ts = fields.at(3).toLongLong();
+    const char *lineBegin, *lineEnd;
+    TraceField fields[4];
+    while(reader.readLine(&lineBegin, &lineEnd)) {
+        if(TraceReader::splitFields(lineBegin, lineEnd, ' ', fields, 4) < 4)
+            continue;
+        double lat = TraceReader::parseDouble(fields[0]);
+        double lon = TraceReader::parseDouble(fields[1]);
+        long long ts = TraceReader::parseLongLong(fields[3]);
         if(ts <= 0)
             continue;
-        // convert the points to the local projection
-        double x, y;
-        ProjFactory::getInstance().transformCoordinates(lat, lon, &x, &y);
-//        qDebug() << "adding node" << node << "(" << x << "," << y << "," << ts << ")";
-        addPoint(node, ts, x, y);
+//        qDebug() << "adding node" << *node << "(" << lon << "," << lat << "," << ts << ")";
+        positions->append(ts, lon, lat);
     }
+
+    // convert the points to the local projection ("positions" only holds the points of this file)
+    ProjFactory::getInstance().transformCoordinates(positions->size(), positions->xs.data(), positions->ys.data());
 }
 
-void Trace::openDieselNetNodeFolder(QString dirname) {
+void Trace::openDieselNetNodeFolder(QString dirname, QString* node, NodeColumns* positions) {
     // read the files of the directory
 //    qDebug() << "folder" << dirname;
     QDirIterator it(dirname, QStringList() << "*", QDir::Files | QDir::NoSymLinks | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-    QString node = QDir(dirname).dirName();
+    *node = QDir(dirname).dirName();
     while (it.hasNext()) {
-        openDieselNetNodeTrace(it.next(), node);
+        openDieselNetNodeTrace(it.next(), positions);
     }
 }
 
-void Trace::openDieselNetNodeTrace(QString filename, QString node) {
+void Trace::openDieselNetNodeTrace(QString filename, NodeColumns* positions) {
     // get the date
 //    qDebug() << "\tfile" << filename;
     QRegExp rx("(\\d{4})\\-(\\d{2})\\-(\\d{2})");  // date
-    QRegExp rx1("(\\d{2})\\:(\\d{2})\\:(\\d{2})"); // time
     rx.indexIn(QFileInfo(filename).fileName());
     int year = rx.cap(1).toInt();
     int month = rx.cap(2).toInt();
     int day = rx.cap(3).toInt();
 
+    // timestamp of the beginning of each hour of the day (the time zone offset only changes on the hour)
+    long long hourTimestamps[24];
+    for(int hh = 0; hh < 24; ++hh) {
+        hourTimestamps[hh] = (long long) QDateTime(QDate(year, month, day), QTime(hh, 0, 0)).toTime_t();
+    }
+
     // read the content of the file
-    QFile* file = new QFile(filename);
-    if(!file->open(QFile::ReadOnly | QFile::Text)) {
+    TraceReader reader(filename);
+    if(!reader.open()) {
         return;
     }
-    while(!file->atEnd()) {
-        QString line = QString(file->readLine()).split(QRegExp("[\r\n]"), QString::SkipEmptyParts).at(0);
-        QStringList fields = line.split(" ");
-        QString ts = fields.at(0);
-        double lat = fields.at(1).toDouble();
-        double lon = fields.at(2).toDouble();
+    const char *lineBegin, *lineEnd;
+    TraceField fields[3];
+    NodeColumns points; // points of the file, before the projection
+    while(reader.readLine(&lineBegin, &lineEnd)) {
+        if(TraceReader::splitFields(lineBegin, lineEnd, ' ', fields, 3) < 3)
+            continue;
+        double lat = TraceReader::parseDouble(fields[1]);
+        double lon = TraceReader::parseDouble(fields[2]);
 
-        rx1.indexIn(ts);
-        int hh = rx1.cap(1).toInt();
-        int mm = rx1.cap(2).toInt();
-        int ss = rx1.cap(3).toInt();
+        // time of the day "hh:mm:ss"
+        TraceField time[3];
+        if(TraceReader::splitFields(fields[0].begin, fields[0].end, ':', time, 3) < 3)
+            continue;
+        int hh = (int) TraceReader::parseLongLong(time[0]);
+        int mm = (int) TraceReader::parseLongLong(time[1]);
+        int ss = (int) TraceReader::parseLongLong(time[2]);
+        if(hh < 0 || hh > 23)
+            continue;
 
-        QDateTime d(QDate(year, month, day), QTime(hh, mm, ss));
-        long long timestamp = (long long) d.toTime_t();
+        long long timestamp = hourTimestamps[hh] + mm * 60 + ss;
 
         if(timestamp <= 0 || lat == 0 || lon == 0)
             continue;
-        // convert the points to the local projection
-        double x, y;
-        ProjFactory::getInstance().transformCoordinates(lat, lon, &x, &y);
-//        qDebug() << "\t\t" << year << month << day << hh << mm << ss << " / " << ts << QFileInfo(filename).fileName();
-//        qDebug() << "\t\tadding node" << node << "(" << x << "," << y << "," << d.toTime_t() << ")";
-        addPoint(node, d.toTime_t(), x, y);
+//        qDebug() << "\t\t" << year << month << day << hh << mm << ss << " / " << QFileInfo(filename).fileName();
+//        qDebug() << "\t\tadding node" << "(" << lon << "," << lat << "," << timestamp << ")";
+        points.append(timestamp, lon, lat);
+    }
+
+    // convert the points to the local projection
+    ProjFactory::getInstance().transformCoordinates(points.size(), points.xs.data(), points.ys.data());
+    for(int i = 0; i < points.size(); ++i) {
+        positions->append(points.timestamps.at(i), points.xs.at(i), points.ys.at(i));
+    }
+}
+
+void Trace::getNodes(QHash<QString, QMap<long long, QPointF>*>* nodes) {
+    QMutexLocker locker(&_nodesCacheMutex);
+    if(!_nodesCacheValid) {
+        for(QMap<long long, QPointF>* positions : _nodesCache) {
+            delete positions;
+        }
+        _nodesCache.clear();
+        for(int id = 0; id < _store.getNbNodes(); ++id) {
+            QMap<long long, QPointF>* positions = new QMap<long long, QPointF>();
+            _store.toMap(id, positions);
+            _nodesCache.insert(_store.getNodeName(id), positions);
+        }
+        _nodesCacheValid = true;
     }
+    *nodes = _nodesCache;
 }
 
 double Trace::averageSpeed() {
     if(_averageSpeeds.isEmpty()) {
         // compute the average speed for each node
-        for(auto it = _nodes.begin(); it != _nodes.end(); ++it) {
-            _averageSpeeds.addValue((int) averageSpeed(it.key()));
+        for(int id = 0; id < _store.getNbNodes(); ++id) {
+            _averageSpeeds.addValue((int) averageSpeed(_store.getNodeName(id)));
         }
     }
 
@@ -185,22 +249,17 @@ double Trace::averageSpeed() {
 }
 
 double Trace::averageSpeed(const QString& nodeId) {
-    QMap<long long, QPointF>* trace = _nodes.value(nodeId);
+    const NodeColumns& trace = _store.getNode(_store.getNodeId(nodeId));
     int count = 0;
     double sum = 0.0;
-    auto jt = trace->begin();
-    long long prevTS = jt.key();
-    QPointF prevPos = jt.value();
-    for(jt++; jt != trace->end(); ++jt) {
-        long long curTS = jt.key();
-        QPointF curPos = jt.value();
-        double distance = qSqrt(qPow(prevPos.x() - curPos.x(), 2) + qPow(prevPos.y() - curPos.y(), 2));
-        long long timeDiff = curTS - prevTS;
+    for(int j = 1; j < trace.size(); ++j) {
+        double dx = trace.xs.at(j) - trace.xs.at(j-1);
+        double dy = trace.ys.at(j) - trace.ys.at(j-1);
+        double distance = qSqrt(dx*dx + dy*dy);
+        long long timeDiff = trace.timestamps.at(j) - trace.timestamps.at(j-1);
         sum += distance / timeDiff;
         count++;
-//                qDebug() << prevPos << curPos << prevTS << curTS << distance << timeDiff << sum << count;
-        prevPos = curPos;
-        prevTS = curTS;
+//                qDebug() << distance << timeDiff << sum << count;
     }
 
     // add the average speed for the current node to the distribution
@@ -213,29 +272,30 @@ GeometryIndex* Trace::makeGeometryIndex(double sampling,
                                          double geometryCellsSize,
                                          GeometryType geometryType,
                                          QString geometryCirclesFile) {
-    // build the ogrGeometry index
-    QSet<Geometry*> geometries;
+    // build the ogrGeometry index (the geometries in the order they are created, to give them stable ids)
+    QList<Geometry*> geometries;
 
     /* build the cells from the trace */
 
     QSet<QPoint> cellGeometries;
-    for(auto it = _nodes.begin(); it != _nodes.end(); ++it) {
+    for(int id = 0; id < _store.getNbNodes(); ++id) {
+        const NodeColumns& positions = _store.getNode(id);
 
-        if(it.value()->lastKey() < startTime) {
+        if(positions.isEmpty() || positions.timestamps.last() < startTime) {
             continue;
         }
 
-        auto jt = (startTime == -1) ? it.value()->begin() : it.value()->lowerBound(startTime);
-        if(jt == it.value()->end()) {
+        int j = (startTime == -1) ? 0 : positions.lowerBound((long long) startTime);
+        if(j == positions.size()) {
             continue;
         }
 
-        long long prevTimestamp = jt.key(); // previous timestamp
-        QPointF prevPos = jt.value();       // previous position
-        for(++jt; jt != it.value()->end(); ++jt) {
+        long long prevTimestamp = positions.timestamps.at(j); // previous timestamp
+        QPointF prevPos = positions.position(j);              // previous position
+        for(++j; j < positions.size(); ++j) {
             // start from the second position
-            long long timestamp = jt.key(); // current timestamp
-            QPointF pos = jt.value();       // current position
+            long long timestamp = positions.timestamps.at(j); // current timestamp
+            QPointF pos = positions.position(j);              // current position
 
             // number of intermediate positions (with the sampling)
             int nbPos = qMax(1, qCeil((timestamp - prevTimestamp) / sampling));
@@ -250,7 +310,7 @@ GeometryIndex* Trace::makeGeometryIndex(double sampling,
                 if(!cellGeometries.contains(cellIdx)) {
                     Geometry* geom = new Cell(cellIdx.x()*geometryCellsSize, cellIdx.y()*geometryCellsSize, geometryCellsSize);
                     cellGeometries.insert(cellIdx);
-                    geometries.insert(geom);
+                    geometries.append(geom);
                 }
 
                 prevPos = pos;
@@ -273,7 +333,7 @@ GeometryIndex* Trace::makeGeometryIndex(double sampling,
             double y = fields.at(1).toDouble();
             double radius = fields.at(2).toDouble();
             Geometry* geom = new Circle(x,y,radius);
-            geometries.insert(geom);
+            geometries.append(geom);
         }
     }
 
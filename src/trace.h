@@ -10,6 +10,7 @@
 #include <QMap>
 
 #include "utils.h"
+#include "trace_store.h"
 
 // forward class declarations
 class Loader;
@@ -23,38 +24,50 @@ public:
 
     virtual bool openTrace(Loader* loader);
 
-    /* open different traces */
-    void openNodeTrace(QString filename);
-    void openDieselNetNodeFolder(QString dirname);
-    void openDieselNetNodeTrace(QString filename, QString node);
+    /* open different traces, the node traces are read in "positions" (without touching the trace store)
+     * so that several files can be read in parallel */
+    void openNodeTrace(QString filename, QString* node, NodeColumns* positions);
+    void openDieselNetNodeFolder(QString dirname, QString* node, NodeColumns* positions);
+    void openDieselNetNodeTrace(QString filename, NodeColumns* positions);
 
-    /* Adds successive points to the "_nodes" hash */
+    /* Adds successive points to the trace store */
     void addPoint(QString node, long long ts, double lat, double lon) {
-        if(!_nodes.contains(node)) {
-            // create the corresponding Map of successive positions
-            _nodes.insert(node, new QMap<long long, QPointF>());
-        }
         // update the node position
-        _nodes.value(node)->insert(ts, QPointF(lat, lon));
+        _store.append(_store.addNode(node), ts, lat, lon);
+        _nodesCacheValid = false;
 
         // update the startTime and endTime
         if(ts >= 0 && ts < _startTime) _startTime = ts;
         if(ts >= 0 && ts > _endTime) _endTime = ts;
     }
 
+    /* Adds the successive positions of a node read separately to the trace store (takes ownership of "positions") */
+    void addNodeTrace(const QString& node, NodeColumns* positions) {
+        if(positions->isEmpty()) {
+            delete positions;
+            return;
+        }
+        int id = _store.addNode(node);
+        _store.addNodeColumns(id, positions);
+        _nodesCacheValid = false;
+
+        // update the startTime and endTime
+        const NodeColumns& columns = _store.getNode(id);
+        long long first = columns.timestamps.first(), last = columns.timestamps.last();
+        if(first >= 0 && first < _startTime) _startTime = first;
+        if(last >= 0 && last > _endTime) _endTime = last;
+    }
+
     double averageSampling() {
         if(_sampling < 0.0) {
             // compute the sampling
             double sum = 0.0;
             long long count = 0;
-            for(auto it = _nodes.begin(); it != _nodes.end(); ++it) {
-                auto jt = it.value()->begin();
-                long long prevTimeStamp = jt.key();
-                for(jt++; jt != it.value()->end(); ++jt) {
-                    long long curTimeStamp = jt.key();
-                    sum += (curTimeStamp - prevTimeStamp);
+            for(int id = 0; id < _store.getNbNodes(); ++id) {
+                const QVector<long long>& timestamps = _store.getNode(id).timestamps;
+                for(int i = 1; i < timestamps.size(); ++i) {
+                    sum += (timestamps.at(i) - timestamps.at(i-1));
                     count++;
-                    prevTimeStamp = curTimeStamp;
                 }
             }
             _sampling = sum / ((double) count);
@@ -62,12 +75,18 @@ public:
         return _sampling;
     }
 
-    void getNodes(QHash<QString, QMap<long long, QPointF>*>* nodes) {
-        *nodes = _nodes;
+    /* Columnar positions of the nodes */
+    TraceStore* getTraceStore() {
+        return &_store;
     }
-    void getNodeTrace(QMap<long long, QPointF>* nodeTrace, QString node) const {
-        qDebug() << node << _nodes.value(node);
-        *nodeTrace = *(_nodes.value(node));
+
+    /* Compatibility accessors, the maps are built from the trace store (and owned by the trace) */
+    void getNodes(QHash<QString, QMap<long long, QPointF>*>* nodes);
+    void getNodeTrace(QMap<long long, QPointF>* nodeTrace, QString node) {
+        qDebug() << node << _store.getNodeId(node);
+        int id = _store.getNodeId(node);
+        if(id >= 0)
+            _store.toMap(id, nodeTrace);
     }
 
     long long getStartTime() {
@@ -77,7 +96,7 @@ public:
         return _endTime;
     }
     int getNbNodes() const {
-        return _nodes.size();
+        return _store.getNbNodes();
     }
     double averageSpeed();
     double averageSpeed(const QString& nodeId);
@@ -96,7 +115,10 @@ public:
 
 protected:
     const QString _filename;
-    QHash<QString, QMap<long long, QPointF>*> _nodes;
+    TraceStore _store;
+    QHash<QString, QMap<long long, QPointF>*> _nodesCache; // built by getNodes
+    bool _nodesCacheValid = false;
+    QMutex _nodesCacheMutex;
     Distribution _averageSpeeds;
     long long _startTime = (long long) 1e20;
     long long _endTime = -1;
@@ -0,0 +1,201 @@
+//
+// Streaming reader for the text traces (mapped in memory, parsed in place)
+//
+
+#include "trace_reader.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+// powers of ten that are exactly represented as doubles
+static const double EXACT_POWERS_OF_TEN[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static inline void trim(const char** begin, const char** end) {
+    while(*begin < *end && isBlank(**begin)) (*begin)++;
+    while(*end > *begin && isBlank(*(*end-1))) (*end)--;
+}
+
+bool TraceField::equals(const QString& str) const {
+    if(str.size() != size())
+        return false;
+    for(int i = 0; i < str.size(); ++i) {
+        if(str.at(i).unicode() != (ushort) (uchar) begin[i])
+            return false;
+    }
+    return true;
+}
+
+TraceReader::~TraceReader() {
+    if(_data)
+        _file.unmap((uchar*) _data);
+}
+
+bool TraceReader::open() {
+    if(!_file.open(QFile::ReadOnly))
+        return false;
+
+    _size = _file.size();
+    _pos = 0;
+    _lastProgress = 0;
+    if(_size == 0)
+        return true; // nothing to map
+
+    _data = (const char*) _file.map(0, _size);
+    return _data != nullptr;
+}
+
+bool TraceReader::readLine(const char** begin, const char** end) {
+    while(_pos < _size) {
+        const char* lineBegin = _data + _pos;
+        const char* nl = (const char*) memchr(lineBegin, '\n', (size_t) (_size - _pos));
+        const char* lineEnd = nl ? nl : _data + _size;
+        _pos = (lineEnd - _data) + (nl ? 1 : 0);
+
+        // the line stops at the first end of line character
+        const char* cr = (const char*) memchr(lineBegin, '\r', (size_t) (lineEnd - lineBegin));
+        if(cr)
+            lineEnd = cr;
+
+        if(lineEnd > lineBegin) {
+            *begin = lineBegin;
+            *end = lineEnd;
+            return true;
+        }
+    }
+    return false;
+}
+
+int TraceReader::splitFields(const char* begin, const char* end, char delim, TraceField* fields, int maxFields) {
+    int nbFields = 0;
+    const char* p = begin;
+    while(nbFields < maxFields) {
+        const char* next = (const char*) memchr(p, delim, (size_t) (end - p));
+        fields[nbFields].begin = p;
+        fields[nbFields].end = next ? next : end;
+        nbFields++;
+        if(!next)
+            break;
+        p = next + 1;
+    }
+    return nbFields;
+}
+
+double TraceReader::parseDouble(const TraceField& field) {
+    const char* begin = field.begin;
+    const char* end = field.end;
+    trim(&begin, &end);
+    if(begin == end)
+        return 0.0;
+
+    const char* p = begin;
+    bool negative = false;
+    if(*p == '-' || *p == '+') {
+        negative = *p == '-';
+        p++;
+    }
+
+    // decimal mantissa and exponent
+    unsigned long long mantissa = 0;
+    int nbDigits = 0;  // significant digits in the mantissa
+    int exponent = 0;
+    bool hasDigits = false;
+    for(; p < end && *p >= '0' && *p <= '9'; ++p) {
+        hasDigits = true;
+        if(nbDigits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if(mantissa > 0) nbDigits++;
+        } else {
+            exponent++;
+        }
+    }
+    if(p < end && *p == '.') {
+        for(p++; p < end && *p >= '0' && *p <= '9'; ++p) {
+            hasDigits = true;
+            if(nbDigits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if(mantissa > 0) nbDigits++;
+                exponent--;
+            }
+        }
+    }
+    if(hasDigits && p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negativeExp = false;
+        if(q < end && (*q == '-' || *q == '+')) {
+            negativeExp = *q == '-';
+            q++;
+        }
+        int exp = 0;
+        bool hasExpDigits = false;
+        for(; q < end && *q >= '0' && *q <= '9'; ++q) {
+            hasExpDigits = true;
+            if(exp < 100000) exp = exp * 10 + (*q - '0');
+        }
+        if(hasExpDigits) {
+            exponent += negativeExp ? -exp : exp;
+            p = q;
+        }
+    }
+
+    // exact when both the mantissa and the power of ten are exact doubles (Clinger's fast path)
+    if(hasDigits && p == end && mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+        double value = (double) mantissa;
+        value = exponent < 0 ? value / EXACT_POWERS_OF_TEN[-exponent] : value * EXACT_POWERS_OF_TEN[exponent];
+        return negative ? -value : value;
+    }
+
+    // otherwise fall back to strtod (correctly rounded) on a null-terminated copy
+    char buffer[128];
+    int size = (int) (end - begin);
+    if(size >= (int) sizeof(buffer))
+        return 0.0;
+    memcpy(buffer, begin, (size_t) size);
+    buffer[size] = '\0';
+    char* parsedEnd = nullptr;
+    double value = strtod(buffer, &parsedEnd);
+    if(parsedEnd != buffer + size)
+        return 0.0;
+    return value;
+}
+
+long long TraceReader::parseLongLong(const TraceField& field) {
+    const char* begin = field.begin;
+    const char* end = field.end;
+    trim(&begin, &end);
+    if(begin == end)
+        return 0;
+
+    const char* p = begin;
+    bool negative = false;
+    if(*p == '-' || *p == '+') {
+        negative = *p == '-';
+        p++;
+    }
+    if(p == end)
+        return 0;
+
+    unsigned long long value = 0;
+    for(; p < end; ++p) {
+        if(*p < '0' || *p > '9')
+            return 0;
+        value = value * 10 + (*p - '0');
+        if(value > (unsigned long long) std::numeric_limits<long long>::max())
+            return 0; // overflow
+    }
+    return negative ? -((long long) value) : (long long) value;
+}
+
+bool TraceReader::progressDue() {
+    if(_pos - _lastProgress < _progressStep)
+        return false;
+    _lastProgress = _pos;
+    return true;
+}
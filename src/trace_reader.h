@@ -0,0 +1,57 @@
+//
+// Streaming reader for the text traces (mapped in memory, parsed in place)
+//
+
+#ifndef LOCALL_TRACE_READER_H
+#define LOCALL_TRACE_READER_H
+
+#include <QFile>
+#include <QString>
+
+/* Field of a line, pointing in the mapped file (not null-terminated) */
+struct TraceField {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    int size() const { return (int) (end - begin); }
+    QString toString() const { return QString::fromLatin1(begin, size()); }
+    bool equals(const QString& str) const;
+};
+
+/* Reads a text trace line by line without copying it: the file is mapped in memory,
+ * the lines and fields point in the mapping and the numbers are parsed in place. */
+class TraceReader {
+public:
+    TraceReader(const QString& filename, qint64 progressStep = 8 * 1024 * 1024):
+            _file(filename), _progressStep(progressStep) { }
+    ~TraceReader();
+
+    bool open();
+    qint64 size() const { return _size; }
+
+    /* Gets the next non-empty line (without the end of line characters), returns false at the end of the file */
+    bool readLine(const char** begin, const char** end);
+
+    /* Splits the line in at most "maxFields" fields separated by "delim" (consecutive delimiters give empty fields),
+     * returns the number of fields */
+    static int splitFields(const char* begin, const char* end, char delim, TraceField* fields, int maxFields);
+
+    /* Parse the numbers of a field, returns 0 if the field is not a valid number */
+    static double parseDouble(const TraceField& field);
+    static long long parseLongLong(const TraceField& field);
+
+    /* Proportion of the file read so far */
+    qreal progress() const { return _size > 0 ? (qreal) _pos / (qreal) _size : 1.0; }
+    /* Returns true once every "progressStep" bytes read, to report the progress */
+    bool progressDue();
+
+private:
+    QFile _file;
+    const char* _data = nullptr;
+    qint64 _size = 0;
+    qint64 _pos = 0;
+    qint64 _progressStep;
+    qint64 _lastProgress = 0;
+};
+
+#endif //LOCALL_TRACE_READER_H
@@ -0,0 +1,151 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QSet>
+#include <QStringList>
+#include <QDebug>
+
+#include "trace_reader.h"
+
+
+/* To compile this file and execute the main below, add this file to the CMakeList and remove the main.cpp
+ * Usage: ./LocAll <trace file> [format] [iterations]
+ *  -> format is "test" ("ts;node;lon;lat"), "ONE" ("ts node lon lat" after a header line)
+ *     or "cabspotting" ("lat lon occupancy ts"), guessed from the file name by default
+ *  -> compares the throughput (MB/s) of the former QString::split parsing with the TraceReader,
+ *     and checks that both read the same points (without the projection) */
+
+struct ParseResult {
+    long long nbPoints = 0;
+    long long sumTimestamps = 0;
+    double sumCoordinates = 0.0;
+    QSet<QString> nodes;
+};
+
+/* Former parsing of Trace::openTrace (line by line with QString::split) */
+static bool parseWithSplit(const QString& filename, const QString& format, ParseResult* res) {
+    QFile file(filename);
+    if(!file.open(QFile::ReadOnly | QFile::Text))
+        return false;
+
+    if(format == "ONE" && !file.atEnd())
+        file.readLine();
+
+    while(!file.atEnd()) {
+        QStringList parts = QString(file.readLine()).split(QRegExp("[\r\n]"), QString::SkipEmptyParts);
+        if(parts.isEmpty())
+            continue;
+        QString line = parts.at(0);
+        QString node;
+        long long ts;
+        double lat, lon;
+        if(format == "cabspotting") {
+            QStringList fields = line.split(" ");
+            if(fields.size() < 4) continue;
+            lat = fields.at(0).toDouble();
+            lon = fields.at(1).toDouble();
+            ts = fields.at(3).toLongLong();
+        } else {
+            QStringList fields = line.split(format == "ONE" ? " " : ";");
+            if(fields.size() < 4) continue;
+            node = fields.at(1);
+            ts = format == "ONE" ? fields.at(0).toLongLong() : (long long) fields.at(0).toDouble();
+            lat = fields.at(3).toDouble();
+            lon = fields.at(2).toDouble();
+        }
+        if(ts <= 0)
+            continue;
+        res->nbPoints++;
+        res->sumTimestamps += ts;
+        res->sumCoordinates += lat + lon;
+        res->nodes.insert(node);
+    }
+    return true;
+}
+
+/* Parsing with the TraceReader (as in Trace::openTrace) */
+static bool parseWithReader(const QString& filename, const QString& format, ParseResult* res) {
+    TraceReader reader(filename);
+    if(!reader.open())
+        return false;
+
+    const char *lineBegin, *lineEnd;
+    if(format == "ONE")
+        reader.readLine(&lineBegin, &lineEnd);
+
+    QString node;
+    TraceField fields[4];
+    while(reader.readLine(&lineBegin, &lineEnd)) {
+        long long ts;
+        double lat, lon;
+        if(format == "cabspotting") {
+            if(TraceReader::splitFields(lineBegin, lineEnd, ' ', fields, 4) < 4) continue;
+            lat = TraceReader::parseDouble(fields[0]);
+            lon = TraceReader::parseDouble(fields[1]);
+            ts = TraceReader::parseLongLong(fields[3]);
+        } else {
+            if(TraceReader::splitFields(lineBegin, lineEnd, format == "ONE" ? ' ' : ';', fields, 4) < 4) continue;
+            if(!fields[1].equals(node))
+                node = fields[1].toString();
+            ts = format == "ONE" ? TraceReader::parseLongLong(fields[0]) : (long long) TraceReader::parseDouble(fields[0]);
+            lat = TraceReader::parseDouble(fields[3]);
+            lon = TraceReader::parseDouble(fields[2]);
+        }
+        if(ts <= 0)
+            continue;
+        res->nbPoints++;
+        res->sumTimestamps += ts;
+        res->sumCoordinates += lat + lon;
+        res->nodes.insert(node);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+    if(argc < 2) {
+        qDebug() << "Usage:" << argv[0] << "<trace file> [test|ONE|cabspotting] [iterations]";
+        return 1;
+    }
+
+    QString filename(argv[1]);
+    QString format = (argc > 2) ? QString(argv[2])
+                                : filename.contains("test") ? "test"
+                                : filename.contains("ONE") ? "ONE" : "cabspotting";
+    int iterations = (argc > 3) ? QString(argv[3]).toInt() : 3;
+    double sizeMB = QFileInfo(filename).size() / (1024.0 * 1024.0);
+
+    ParseResult splitRes, readerRes;
+    qint64 splitTime = 0, readerTime = 0;
+    for(int i = 0; i < iterations; ++i) {
+        QElapsedTimer timer;
+        splitRes = ParseResult();
+        timer.start();
+        if(!parseWithSplit(filename, format, &splitRes))
+            return 1;
+        splitTime += timer.elapsed();
+
+        readerRes = ParseResult();
+        timer.start();
+        if(!parseWithReader(filename, format, &readerRes))
+            return 1;
+        readerTime += timer.elapsed();
+    }
+
+    auto throughput = [&](qint64 ms) {
+        return ms > 0 ? sizeMB * iterations / (ms / 1000.0) : 0.0;
+    };
+    qDebug() << "file" << filename << "format" << format << sizeMB << "MB" << splitRes.nbPoints << "points";
+    qDebug() << "QString::split" << throughput(splitTime) << "MB/s";
+    qDebug() << "TraceReader   " << throughput(readerTime) << "MB/s";
+
+    bool same = splitRes.nbPoints == readerRes.nbPoints
+                && splitRes.sumTimestamps == readerRes.sumTimestamps
+                && splitRes.sumCoordinates == readerRes.sumCoordinates
+                && splitRes.nodes == readerRes.nodes;
+    qDebug() << (same ? "[OK]" : "[FAILED]") << "same points read";
+
+    return same ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+//
+// Columnar storage of the node positions of a trace
+//
+
+#include "trace_store.h"
+
+#include <algorithm>
+#include <numeric>
+
+void NodeColumns::sort() {
+    if(sorted)
+        return;
+
+    // order the positions by timestamp, keeping the insertion order for equal timestamps
+    QVector<int> order(timestamps.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return timestamps.at(a) < timestamps.at(b);
+    });
+
+    QVector<long long> sortedTimestamps;
+    QVector<double> sortedXs, sortedYs;
+    sortedTimestamps.reserve(order.size());
+    sortedXs.reserve(order.size());
+    sortedYs.reserve(order.size());
+    for(int i : order) {
+        if(!sortedTimestamps.isEmpty() && sortedTimestamps.last() == timestamps.at(i)) {
+            // the last position added at the same timestamp replaces the previous one
+            sortedXs.last() = xs.at(i);
+            sortedYs.last() = ys.at(i);
+            continue;
+        }
+        sortedTimestamps.append(timestamps.at(i));
+        sortedXs.append(xs.at(i));
+        sortedYs.append(ys.at(i));
+    }
+
+    timestamps = sortedTimestamps;
+    xs = sortedXs;
+    ys = sortedYs;
+    sorted = true;
+}
+
+int NodeColumns::lowerBound(long long ts) const {
+    return (int) (std::lower_bound(timestamps.constBegin(), timestamps.constEnd(), ts) - timestamps.constBegin());
+}
+
+int NodeColumns::upperBound(long long ts) const {
+    return (int) (std::upper_bound(timestamps.constBegin(), timestamps.constEnd(), ts) - timestamps.constBegin());
+}
+
+TraceStore::~TraceStore() {
+    qDeleteAll(_nodes);
+}
+
+int TraceStore::addNode(const QString& node) {
+    int id = _ids.value(node, -1);
+    if(id == -1) {
+        id = _nodes.size();
+        _ids.insert(node, id);
+        _names.append(node);
+        _nodes.append(new NodeColumns());
+    }
+    return id;
+}
+
+long long TraceStore::getNbPositions() const {
+    long long count = 0;
+    for(NodeColumns* columns : _nodes) {
+        count += columns->size();
+    }
+    return count;
+}
+
+void TraceStore::addNodeColumns(int id, NodeColumns* columns) {
+    NodeColumns* nodeColumns = _nodes.at(id);
+    if(nodeColumns->isEmpty()) {
+        _nodes[id] = columns;
+        delete nodeColumns;
+    } else {
+        for(int i = 0; i < columns->size(); ++i) {
+            nodeColumns->append(columns->timestamps.at(i), columns->xs.at(i), columns->ys.at(i));
+        }
+        delete columns;
+    }
+    if(!_nodes.at(id)->sorted)
+        _unsorted.storeRelease(1);
+}
+
+void TraceStore::toMap(int id, QMap<long long, QPointF>* positions) {
+    const NodeColumns& columns = getNode(id);
+    for(int i = 0; i < columns.size(); ++i) {
+        positions->insert(columns.timestamps.at(i), columns.position(i));
+    }
+}
+
+void TraceStore::sortNodes() {
+    QMutexLocker locker(&_sortMutex);
+    if(!_unsorted.loadAcquire())
+        return; // sorted by another thread
+
+    for(NodeColumns* columns : _nodes) {
+        columns->sort();
+    }
+    _unsorted.storeRelease(0);
+}
@@ -0,0 +1,96 @@
+//
+// Columnar storage of the node positions of a trace
+//
+
+#ifndef LOCALL_TRACE_STORE_H
+#define LOCALL_TRACE_STORE_H
+
+#include <QString>
+#include <QPointF>
+#include <QVector>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QAtomicInt>
+
+/* Successive positions of a node, as parallel columns ordered by timestamp */
+struct NodeColumns {
+    QVector<long long> timestamps;
+    QVector<double> xs;
+    QVector<double> ys;
+    bool sorted = true; // false when positions were appended out of order
+
+    int size() const { return timestamps.size(); }
+    bool isEmpty() const { return timestamps.isEmpty(); }
+    QPointF position(int i) const { return QPointF(xs.at(i), ys.at(i)); }
+
+    /* Adds a position, a position at the same timestamp as the last one replaces it */
+    void append(long long ts, double x, double y) {
+        if(!timestamps.isEmpty()) {
+            long long last = timestamps.last();
+            if(ts == last) {
+                xs.last() = x;
+                ys.last() = y;
+                return;
+            }
+            if(ts < last)
+                sorted = false;
+        }
+        timestamps.append(ts);
+        xs.append(x);
+        ys.append(y);
+    }
+
+    /* Orders the positions by timestamp, the last position added wins for duplicate timestamps */
+    void sort();
+
+    /* Index of the first position at or after "ts" (size() if there is none) */
+    int lowerBound(long long ts) const;
+    /* Index of the first position after "ts" (size() if there is none) */
+    int upperBound(long long ts) const;
+};
+
+/* Positions of all the nodes of a trace, the node ids are interned to integers */
+class TraceStore {
+public:
+    TraceStore() { }
+    ~TraceStore();
+
+    /* Returns the id of the node, adding it if needed */
+    int addNode(const QString& node);
+    int getNodeId(const QString& node) const { return _ids.value(node, -1); }
+    const QString& getNodeName(int id) const { return _names.at(id); }
+    int getNbNodes() const { return _nodes.size(); }
+    long long getNbPositions() const;
+
+    void append(int id, long long ts, double x, double y) {
+        NodeColumns* columns = _nodes.at(id);
+        columns->append(ts, x, y);
+        if(!columns->sorted)
+            _unsorted.storeRelease(1);
+    }
+
+    /* Adds the positions of a node read separately (takes ownership of "columns") */
+    void addNodeColumns(int id, NodeColumns* columns);
+
+    /* Positions of the node ordered by timestamp (the nodes are sorted on the first read after a change) */
+    const NodeColumns& getNode(int id) {
+        if(_unsorted.loadAcquire())
+            sortNodes();
+        return *(_nodes.at(id));
+    }
+
+    /* Copies the positions of the node in a map <timestamp, position> (former storage of the trace) */
+    void toMap(int id, QMap<long long, QPointF>* positions);
+
+private:
+    QHash<QString, int> _ids;       // <node name, node id>
+    QVector<QString> _names;        // <node id, node name>
+    QVector<NodeColumns*> _nodes;   // <node id, positions>
+    QAtomicInt _unsorted;           // some nodes need to be sorted
+    QMutex _sortMutex;
+
+    void sortNodes();
+};
+
+#endif //LOCALL_TRACE_STORE_H
@@ -0,0 +1,139 @@
+//
+// Native transverse Mercator projection used by the batch projection of ProjFactory
+//
+
+#include "transverse_mercator.h"
+
+#include <QStringList>
+#include <QSet>
+#include <cmath>
+
+#ifdef LOCALL_SIMD_PROJECTION
+#define LOCALL_SIMD_LOOP _Pragma("omp simd")
+#else
+#define LOCALL_SIMD_LOOP
+#endif
+
+static const double DEGREES = M_PI / 180.0;
+
+/* Transverse Mercator coordinates (xi, eta) on the sphere of radius 1 of the point (lam, phi),
+ * lam relative to the central meridian (Karney, "Transverse Mercator with an accuracy of a few
+ * nanometers", 2011) */
+static inline void krueger(const double* alpha, double e, double lam, double phi, double* xi, double* eta) {
+    // conformal latitude
+    double sphi = std::sin(phi);
+    double tau = sphi / std::sqrt(1.0 - sphi * sphi);
+    double sig = std::sinh(e * std::atanh(e * sphi));
+    double taup = tau * std::sqrt(1.0 + sig * sig) - sig * std::sqrt(1.0 + tau * tau);
+
+    // Gauss-Schreiber transverse Mercator
+    double slam = std::sin(lam), clam = std::sqrt(1.0 - slam * slam); // |lam| < 90 degrees
+    double r = std::sqrt(taup * taup + clam * clam);
+    double xip = std::atan2(taup, clam);
+    double etap = std::asinh(slam / r);
+
+    // sin and cos of w = 2 * (xip + i * etap)
+    double s = taup / r, c = clam / r;
+    double sin2xi = 2.0 * s * c, cos2xi = c * c - s * s;
+    double exp2eta = std::exp(2.0 * etap);
+    double cosh2eta = 0.5 * (exp2eta + 1.0 / exp2eta);
+    double sinh2eta = 0.5 * (exp2eta - 1.0 / exp2eta);
+    double sinwRe = sin2xi * cosh2eta, sinwIm = cos2xi * sinh2eta;
+    double coswRe = cos2xi * cosh2eta, coswIm = -sin2xi * sinh2eta;
+
+    // Clenshaw summation of sum(alpha[j] * sin((j+1) * w))
+    double aRe = 2.0 * coswRe, aIm = 2.0 * coswIm;
+    double b1Re = 0.0, b1Im = 0.0, b2Re = 0.0, b2Im = 0.0;
+    for(int j = 5; j >= 0; --j) {
+        double bRe = alpha[j] + aRe * b1Re - aIm * b1Im - b2Re;
+        double bIm = aRe * b1Im + aIm * b1Re - b2Im;
+        b2Re = b1Re; b2Im = b1Im;
+        b1Re = bRe;  b1Im = bIm;
+    }
+
+    *xi  = xip  + b1Re * sinwRe - b1Im * sinwIm;
+    *eta = etap + b1Re * sinwIm + b1Im * sinwRe;
+}
+
+TransverseMercator::TransverseMercator(double a, double es, double lon0, double lat0, double k0, double x0, double y0) {
+    double f = 1.0 - std::sqrt(1.0 - es);
+    double n = f / (2.0 - f);
+    double n2 = n * n, n3 = n2 * n, n4 = n3 * n, n5 = n4 * n, n6 = n5 * n;
+
+    _alpha[0] = n / 2 - 2 * n2 / 3 + 5 * n3 / 16 + 41 * n4 / 180 - 127 * n5 / 288 + 7891 * n6 / 37800;
+    _alpha[1] = 13 * n2 / 48 - 3 * n3 / 5 + 557 * n4 / 1440 + 281 * n5 / 630 - 1983433 * n6 / 1935360;
+    _alpha[2] = 61 * n3 / 240 - 103 * n4 / 140 + 15061 * n5 / 26880 + 167603 * n6 / 181440;
+    _alpha[3] = 49561 * n4 / 161280 - 179 * n5 / 168 + 6601661 * n6 / 7257600;
+    _alpha[4] = 34729 * n5 / 80640 - 3418889 * n6 / 1995840;
+    _alpha[5] = 212378941 * n6 / 319334400;
+
+    _e = std::sqrt(es);
+    _lon0 = lon0 * DEGREES;
+    _kA = k0 * a / (1.0 + n) * (1.0 + n2 / 4 + n4 / 64 + n6 / 256);
+    _x0 = x0;
+
+    // the northings are counted from the origin latitude
+    double xi0 = 0.0, eta0 = 0.0;
+    if(lat0 != 0.0)
+        krueger(_alpha, _e, 0.0, lat0 * DEGREES, &xi0, &eta0);
+    _y0 = y0 - _kA * xi0;
+}
+
+bool TransverseMercator::parseDefinition(const QString& def, double* lon0, double* lat0, double* k0, double* x0, double* y0) {
+    // parameters that do not change the projection of the coordinates
+    static const QSet<QString> ignored = QSet<QString>()
+            << "ellps" << "datum" << "a" << "b" << "rf" << "f" << "es" << "e"
+            << "no_defs" << "wktext" << "approx";
+
+    QString proj;
+    int zone = 0;
+    bool south = false;
+    *lon0 = 0.0; *lat0 = 0.0; *k0 = 1.0; *x0 = 0.0; *y0 = 0.0;
+    for(const QString& param : def.split(' ', QString::SkipEmptyParts)) {
+        QString key = param.section('=', 0, 0).remove(0, 1);
+        QString value = param.section('=', 1);
+        if(key == "proj")                       proj = value;
+        else if(key == "zone")                  zone = value.toInt();
+        else if(key == "south")                 south = true;
+        else if(key == "lon_0")                 *lon0 = value.toDouble();
+        else if(key == "lat_0")                 *lat0 = value.toDouble();
+        else if(key == "k" || key == "k_0")     *k0 = value.toDouble();
+        else if(key == "x_0")                   *x0 = value.toDouble();
+        else if(key == "y_0")                   *y0 = value.toDouble();
+        else if(key == "units" && value == "m") continue;
+        else if(key == "to_meter" && value.toDouble() == 1.0) continue;
+        else if(key == "towgs84") {
+            // only the identity datum shift
+            for(const QString& v : value.split(',')) {
+                if(v.toDouble() != 0.0)
+                    return false;
+            }
+        }
+        else if(!ignored.contains(key))
+            return false;
+    }
+
+    if(proj == "utm") {
+        if(zone < 1 || zone > 60)
+            return false; // the zone would be guessed from the data
+        *lon0 = (zone - 1) * 6 - 180 + 3;
+        *lat0 = 0.0;
+        *k0 = 0.9996;
+        *x0 = 500000.0;
+        *y0 = south ? 10000000.0 : 0.0;
+        return true;
+    }
+    return proj == "tmerc" || proj == "etmerc";
+}
+
+void TransverseMercator::forward(long count, double* xs, double* ys, int stride) const {
+    const double* alpha = _alpha;
+    double e = _e, lon0 = _lon0, kA = _kA, x0 = _x0, y0 = _y0;
+LOCALL_SIMD_LOOP
+    for(long i = 0; i < count; ++i) {
+        double xi, eta;
+        krueger(alpha, e, xs[i * stride] * DEGREES - lon0, ys[i * stride] * DEGREES, &xi, &eta);
+        xs[i * stride] = x0 + kA * eta;
+        ys[i * stride] = y0 + kA * xi;
+    }
+}
@@ -0,0 +1,35 @@
+//
+// Native transverse Mercator projection used by the batch projection of ProjFactory
+//
+
+#ifndef LOCALL_TRANSVERSE_MERCATOR_H
+#define LOCALL_TRANSVERSE_MERCATOR_H
+
+#include <QString>
+
+/* Forward transverse Mercator projection (UTM) of geographic coordinates, with the series of
+ * Krüger to the 6th order in the third flattening (the same as "+proj=etmerc" in PROJ).
+ * The batch loop has no branch and is vectorized when built with LOCALL_SIMD_PROJECTION. */
+class TransverseMercator {
+public:
+    /* a: semi-major axis, es: eccentricity squared, lon0/lat0 in degrees */
+    TransverseMercator(double a, double es, double lon0, double lat0, double k0, double x0, double y0);
+
+    /* Reads the parameters of a "+proj=utm", "+proj=tmerc" or "+proj=etmerc" definition,
+     * returns false for other projections or for parameters that are not supported */
+    static bool parseDefinition(const QString& def, double* lon0, double* lat0, double* k0, double* x0, double* y0);
+
+    /* Projects "count" points in place, (xs[i*stride], ys[i*stride]) hold the longitude and
+     * the latitude in degrees and receive the projected coordinates */
+    void forward(long count, double* xs, double* ys, int stride = 1) const;
+
+private:
+    double _e;          // eccentricity
+    double _lon0;       // central meridian (radians)
+    double _kA;         // scale factor * rectifying radius
+    double _x0;
+    double _y0;         // false northing minus the northing of the origin latitude
+    double _alpha[6];   // coefficients of the series
+};
+
+#endif //LOCALL_TRANSVERSE_MERCATOR_H
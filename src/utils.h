@@ -102,83 +102,135 @@ private:
     double _average = 0;
 };
 
+/* Distribution of integer values. The values are counted exactly (<value, count>) as long as there
+ * are at most "maxExactValues" distinct values (-1 to always count them exactly), then in a
+ * log-linear histogram of fixed size (as the HDR histograms): the values below
+ * 2^DISTRIBUTION_HISTOGRAM_BITS have their own bin, and the bins of the larger values have a width
+ * below 2^-DISTRIBUTION_HISTOGRAM_BITS of their values, so the percentiles have a relative error
+ * below 2^-DISTRIBUTION_HISTOGRAM_BITS. Two distributions merge exactly (bin by bin), and the const
+ * methods do not modify the distribution (they can be called concurrently). */
 class Distribution {
 public:
-    Distribution() {}
+    Distribution(int maxExactValues = DISTRIBUTION_MAX_EXACT_VALUES):
+        _maxExactValues(maxExactValues) {}
     void addValue(int v) {
-        _values[v]++;
+        if(isExact()) {
+            _values[v]++;
+            if(_maxExactValues >= 0 && _values.size() > _maxExactValues)
+                toHistogram();
+        } else {
+            addToHistogram(v, 1);
+        }
         _cummulativeSum += v;
         _average = (_average * _count + v)/(_count+1);
         _count++;
     }
 
-    double probability(double x) {
+    double probability(double x) const {
         if(x < 0) { return 0; }
-        auto it = _values.begin();
         int sum = 0;
-        while(it != _values.end() && it.value() <= x) {
-            sum += it.key() * it.value();
-            it++;
-        }
+        forEachValue([&](int value, int count) {
+            if(count > x)
+                return false;
+            sum += value * count;
+            return true;
+        });
         return sum / _cummulativeSum;
     }
 
-    bool isEmpty() { return _count == 0; }
-
-    double getAverage() { return _average; }
-    double getMedian() {
-        if(_median == 0) {
-            auto it = _values.begin();
-            int sum = 0;
-            int prevVal = -1;
-            while(it != _values.end()) {
-                int n = it.value();
-                double prevProportion = (double) sum / _count;
-                if(prevProportion <= 0.5) {
-                    double proportion = (double) (sum+1) / _count;
-                    if(proportion >= 0.5) {
-                        _median = (it.key() + prevVal) / 2.0;
-                    }
-                    double nextProportion = (double) (sum+n) / _count;
-                    if(nextProportion >= 0.5) {
-                        _median = it.key();
-                        break;
-                    }
-                }
-
-                sum += it.value();
-                prevVal = it.key();
-                it++;
+    /* Add the values of "other" to the distribution */
+    void merge(const Distribution& other) {
+        if(other._count == 0)
+            return;
+        if(isExact() && other.isExact()) {
+            for(auto it = other._values.begin(); it != other._values.end(); ++it) {
+                _values[it.key()] += it.value();
+            }
+            if(_maxExactValues >= 0 && _values.size() > _maxExactValues)
+                toHistogram();
+        } else {
+            if(isExact())
+                toHistogram();
+            if(other.isExact()) {
+                for(auto it = other._values.begin(); it != other._values.end(); ++it)
+                    addToHistogram(it.key(), it.value());
+            } else {
+                addBins(&_bins, other._bins);
+                addBins(&_negativeBins, other._negativeBins);
             }
         }
-        return _median;
+        _cummulativeSum += other._cummulativeSum;
+        _average = (_average * _count + other._average * other._count)/(_count + other._count);
+        _count += other._count;
+    }
+
+    bool isEmpty() const { return _count == 0; }
+    /* True if the values are counted exactly (not in the histogram) */
+    bool isExact() const { return _bins.isEmpty() && _negativeBins.isEmpty(); }
+
+    /* Raw state of the distribution (to save and restore it), the values of the histogram are
+     * the middle of their bin */
+    QMap<int,int> getValues() const {
+        if(isExact())
+            return _values;
+        QMap<int,int> values;
+        forEachValue([&](int value, int count) { values.insert(value, count); return true; });
+        return values;
+    }
+    int getCummulativeSum() const { return _cummulativeSum; }
+    double getCount() const { return _count; }
+    void restore(const QMap<int,int>& values, int cummulativeSum, double count, double average) {
+        _values = values;
+        _bins.clear();
+        _negativeBins.clear();
+        if(_maxExactValues >= 0 && _values.size() > _maxExactValues)
+            toHistogram();
+        _cummulativeSum = cummulativeSum;
+        _count = count;
+        _average = average;
+    }
+
+    double getAverage() const { return _average; }
+    double getMedian() const { return getPercentile(0.5); }
+    /* Smallest value such that a proportion "p" (in [0,1]) of the values are lower or equal (0 if
+     * the distribution is empty) */
+    double getPercentile(double p) const {
+        double res = 0.0;
+        int sum = 0;
+        forEachValue([&](int value, int count) {
+            res = value;
+            sum += count;
+            return (double) sum / _count < p;
+        });
+        return res;
     }
 
     void plot(QCustomPlot* customPlot) {
         customPlot->clearPlottables();
-        int vectorSize = _values.size();
+        QMap<int,int> values = getValues();
+        int vectorSize = values.size();
         if(vectorSize == 0)
             return;
 
-        if(_values.firstKey() > 0) {
+        if(values.firstKey() > 0) {
             vectorSize++;
-            if(_values.firstKey()-1 != 0)
+            if(values.firstKey()-1 != 0)
                 vectorSize++;
         }
 
         QVector<double> x(vectorSize), y(vectorSize);
         int i = 0;
-        if(_values.firstKey() > 0) {
+        if(values.firstKey() > 0) {
             x[i] = y[i] = 0.0;
             i++;
-            if(_values.firstKey()-1 != 0) {
-                x[i] = _values.firstKey()-1;
+            if(values.firstKey()-1 != 0) {
+                x[i] = values.firstKey()-1;
                 y[i] = 0.0;
                 i++;
             }
         }
         double cummulativeValue = 0;
-        for(auto it = _values.begin(); it != _values.end(); ++it) {
+        for(auto it = values.begin(); it != values.end(); ++it) {
             x[i] = it.key();
             cummulativeValue += (double) it.value() / _count;
             y[i] = cummulativeValue;
@@ -195,17 +247,75 @@ public:
         // set axes ranges, so we see all data:
         customPlot->xAxis->setAutoTicks(true);
         customPlot->xAxis->setAutoTickLabels(true);
-        customPlot->xAxis->setRange(qMin(0,_values.firstKey()), _values.lastKey());
+        customPlot->xAxis->setRange(qMin(0,values.firstKey()), values.lastKey());
         customPlot->yAxis->setRange(0, 1.0);
         customPlot->replot();
     }
 
 private:
-    QMap<int,int> _values; // ordered values
+    QMap<int,int> _values; // ordered values (exact count)
+    QVector<int> _bins;         // histogram of the values >= 0 (bin index -> count)
+    QVector<int> _negativeBins; // histogram of the opposite of the values < 0
+    int _maxExactValues;
     int _cummulativeSum = 0;
     double _count = 0;
     double _average = 0;
-    double _median = 0;
+
+    /* Bin of the value "m" >= 0: the values below 2^bits have their own bin, the bins above are
+     * 2^shift wide for the values in [2^(bits-1+shift), 2^(bits+shift)) */
+    static int binIndex(quint32 m) {
+        const int half = 1 << (DISTRIBUTION_HISTOGRAM_BITS - 1);
+        int shift = 0;
+        while((m >> shift) >= (quint32) (2 * half))
+            shift++;
+        return shift * half + (int) (m >> shift);
+    }
+    /* Value in the middle of the bin "idx" */
+    static quint32 binValue(int idx) {
+        const int half = 1 << (DISTRIBUTION_HISTOGRAM_BITS - 1);
+        int shift = idx < 2 * half ? 0 : idx / half - 1;
+        return ((quint32) (idx - shift * half) << shift) + ((1u << shift) >> 1);
+    }
+
+    void addToHistogram(int v, int count) {
+        QVector<int>& bins = v < 0 ? _negativeBins : _bins;
+        int idx = binIndex(v < 0 ? 0u - (quint32) v : (quint32) v);
+        if(idx >= bins.size())
+            bins.resize(idx + 1);
+        bins[idx] += count;
+    }
+    static void addBins(QVector<int>* bins, const QVector<int>& other) {
+        if(other.size() > bins->size())
+            bins->resize(other.size());
+        for(int i = 0; i < other.size(); ++i)
+            (*bins)[i] += other.at(i);
+    }
+    void toHistogram() {
+        for(auto it = _values.begin(); it != _values.end(); ++it)
+            addToHistogram(it.key(), it.value());
+        _values.clear();
+    }
+
+    /* Calls visitor(int value, int count) on the values by increasing value, as long as the visitor
+     * returns true */
+    template<typename Visitor>
+    void forEachValue(Visitor visitor) const {
+        if(isExact()) {
+            for(auto it = _values.begin(); it != _values.end(); ++it) {
+                if(!visitor(it.key(), it.value()))
+                    return;
+            }
+            return;
+        }
+        for(int i = _negativeBins.size() - 1; i >= 0; --i) {
+            if(_negativeBins.at(i) > 0 && !visitor((int) (0u - binValue(i)), _negativeBins.at(i)))
+                return;
+        }
+        for(int i = 0; i < _bins.size(); ++i) {
+            if(_bins.at(i) > 0 && !visitor((int) binValue(i), _bins.at(i)))
+                return;
+        }
+    }
 };
 
 
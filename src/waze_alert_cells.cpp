@@ -4,6 +4,7 @@
 
 #include "waze_alert_cells.h"
 #include "geometries.h"
+#include "getis_ord.h"
 
 bool WazeAlertCells::computeCells() {
     qDebug() << "Compute the cells";
@@ -31,37 +32,22 @@ bool WazeAlertCells::computeCells() {
 }
 
 
-double WazeAlertCells::computeGetisOrdG(QPoint index) {
-    // Getis Ord G spatial stats
-
-    Geometry* geom_i = _wazeCells.value(index)->cell;
-    qreal sum1 = 0.0, sum2 = 0.0, sum3 = 0.0, sum4 = 0.0, sum5 = 0.0;
-    int n = _wazeCells.size();
-    for(auto it = _wazeCells.begin(); it != _wazeCells.end(); ++it) {
-        int count_j = it.value()->alerts.size();
-        Geometry* geom_j = it.value()->cell;
-        int weight = (int) (1.0 / (0.01 + (qreal) qSqrt(qPow(geom_i->getCenter().x() - geom_j->getCenter().x(), 2) +
-                                                        qPow(geom_i->getCenter().y() - geom_j->getCenter().y(), 2))));
-        sum1 += weight * count_j;
-        sum2 += weight;
-        sum3 += qPow(weight,2);
-        sum4 += count_j;
-        sum5 += qPow(count_j,2);
+void WazeAlertCells::computeGetisOrdG(GetisOrdWeights weights, double parameter) {
+    // Getis Ord G spatial stats of all the cells in one pass
+    QList<WazeCellValue*> cells = _wazeCells.values();
+    QVector<QPointF> positions;
+    QVector<double> counts;
+    for(WazeCellValue* wcv : cells) {
+        positions.append(wcv->cell->getCenter());
+        counts.append(wcv->alerts.size());
     }
 
-    // TODO compute p-scores
-
-    qreal mean = sum4 / n;
-    qreal S = qSqrt(sum5 / n - qPow(mean, 2));
-
-    // return z-score
-    return (sum1 - mean * sum2) / (S * qSqrt((n * sum3 - qPow(sum2,2)) / (n-1)));
+    QVector<double> zScores, pValues;
+    GetisOrd(positions, counts, weights, parameter).compute(&zScores, &pValues);
+    for(int i = 0; i < cells.size(); ++i) {
+        WazeCellValue* wcv = cells.at(i);
+        wcv->zScore = zScores.at(i);
+        wcv->pValue = pValues.at(i);
+        wcv->color = GetisOrd::selectColor(wcv->zScore);
+    }
 }
-
-QColor WazeAlertCells::selectColorGetisOrdG(double zScore) {
-    if(zScore >= 3.291) return QColor("#720206");
-    else if(zScore >= 2.576) return QColor("#f33f1c");
-    else if(zScore >= 1.960) return QColor("#f37b22");
-    else if(zScore >= 1.645) return QColor("#fffe38");
-    else return QColor("#cccccc");
-}
\ No newline at end of file
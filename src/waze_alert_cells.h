@@ -22,6 +22,8 @@ struct WazeCellValue {
     QSet<QString> nodes; // nodes that visited the cell
     QMap<long long, WazeAlert*> alerts; // alerts contained in the cell
     QColor color;
+    double zScore = 0.0; // z-score of the local Getis-Ord G* of the number of alerts
+    double pValue = 1.0; // two-sided p-value of the z-score
 };
 
 
@@ -47,8 +49,9 @@ public:
         return _wazeCells.value(_geomToIndex.value(geom));
     }
 
-    double computeGetisOrdG(QPoint index);
-    QColor selectColorGetisOrdG(double zScore);
+    /* Computes the local Getis-Ord G* of the number of alerts of all the cells (z-score, p-value and
+     * color of each cell) */
+    void computeGetisOrdG(GetisOrdWeights weights = InverseDistanceWeights, double parameter = 0.0);
 
 private:
     WazeAlertData* _wazeAlertFile;
@@ -11,10 +11,10 @@ QGraphicsItemGroup *WazeAlertCellsLayer::draw() {
     _groupItem->setHandlesChildEvents(false);
 
     QHash<QPoint, WazeCellValue*>* wazeCells = _wazeAlertCells->getCells();
+    _wazeAlertCells->computeGetisOrdG(); // colors of the cells
 
     for(auto it = wazeCells->begin(); it != wazeCells->end(); ++it) {
         WazeCellValue* wcv = it.value();
-        wcv->color = _wazeAlertCells->selectColorGetisOrdG(_wazeAlertCells->computeGetisOrdG(it.key()));
         Geometry* geom = wcv->cell;
         GeometryGraphics* item;
         if(geom->getGeometryType() == CircleGeometryType) {
@@ -18,13 +18,21 @@ bool WazeAlertData::open(Loader* loader) {
     // header:
     // inject_date,street,city,roadType,pubMillis,locy,locx,subtype,reliability,uuid,type,reportRating,
     // magvar,country,startTime,startTimeMillis,endTime,endTimeMillis
+    // convert the points to fit with the coordinate system, all at once
+    QVector<double> xs, ys;
+    xs.reserve(wazeAlertsList.size());
+    ys.reserve(wazeAlertsList.size());
+    for(const auto& alert : wazeAlertsList) {
+        xs.append(alert.value("locx").toDouble());
+        ys.append(alert.value("locy").toDouble());
+    }
+    ProjFactory::getInstance().transformCoordinates(xs.size(), xs.data(), ys.data());
+
     int count = 0;
     for(auto alert : wazeAlertsList) {
         QString date = alert.value("inject_date");
         QString uuid = alert.value("uuid");
 
-        double lat = alert.value("locy").toDouble();
-        double lon = alert.value("locx").toDouble();
         int rating = alert.value("reportRating").toInt();
         int roadType = alert.value("roadType").toInt();
         QString type = alert.value("type");
@@ -39,9 +47,8 @@ bool WazeAlertData::open(Loader* loader) {
         }
         _alertTypes.value(alertType)->insert(alertSubType);
 
-        // convert the points to fit with the coordinate system
-        double x, y;
-        ProjFactory::getInstance().transformCoordinates(lat, lon, &x, &y);
+        double x = xs.at(count);
+        double y = ys.at(count);
 
         // convert the date
         QDateTime dateTime = QDateTime::fromString(date, dateFormat);
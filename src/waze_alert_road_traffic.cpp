@@ -43,13 +43,14 @@ bool WazeAlertRoadTraffic::populateAlerts(Loader* loader) {
         }
     }
 
-    // create a geometry index with the buffered road links
-    _geometryIndex = new GeometryIndex(_bufferedRoadLinks.keys().toSet(), 100);
+    // create a geometry index with the buffered road links (R-tree, a buffered link spans many grid cells)
+    _geometryIndex = new GeometryIndex(_bufferedRoadLinks.keys().toSet(), 100, RTreeIndexType);
     qDebug() << "number of geometry index cells" << _geometryIndex->getGrid().size();
 
     /* Match the Waze alerts with the closest road link */
     QHash<QString, QMap<long long, WazeAlert*>*>* alerts = _wazeAlerts->getAlerts();
 
+    GeometryIndex::GeometryBuffer closestGeometries;
     for(auto it = alerts->begin(); it != alerts->end(); ++it) {
         QString user = it.key();
         for(auto jt = it.value()->begin(); jt != it.value()->end(); ++jt) {
@@ -59,8 +60,8 @@ bool WazeAlertRoadTraffic::populateAlerts(Loader* loader) {
             double magvar = -1*alert->magvar;
 
             // try to match the alert with the closest road link
-            QSet<Geometry*>* closestGeometries = _geometryIndex->getGeometriesAt(alert->pos);
-            if(closestGeometries == nullptr) {
+            _geometryIndex->getGeometriesAt(alert->pos, &closestGeometries);
+            if(closestGeometries.isEmpty()) {
 //                qDebug() << "no geometry within 100 meters";
                 continue;
             }
@@ -70,7 +71,7 @@ bool WazeAlertRoadTraffic::populateAlerts(Loader* loader) {
             QPointF closestProjectedPt = QPointF();
             ProjectedWazeAlert* projPoint = new ProjectedWazeAlert(alertPos, QPointF());
             projPoint->wazeAlert = alert;
-            for(Geometry* geom : *closestGeometries) {
+            for(Geometry* geom : closestGeometries) {
                 QString roadLinkId = _bufferedRoadLinks.value(geom);
                 if(!_roadLinks.contains(roadLinkId)) {
                     qDebug() << "Road link id" << roadLinkId << "not contained in the road link set";